@@ -5,15 +5,171 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
 #include <queue>
+#include <array>
 #include <cstdint>
+#include <cstring>
 
 #define LIBCOMPRA_MAJOR 1
 #define LIBCOMPRA_MINOR 1
 #define LIBCOMPRA_NAMESPACE Compra
 
 namespace LIBCOMPRA_NAMESPACE {
+namespace BitIO {
+    using ByteVector = std::vector<uint8_t>;
+
+    struct BitWriter {
+        ByteVector bytes;
+        uint64_t buffer = 0;
+        size_t count = 0;
+        size_t bitLength = 0;
+
+        void write(uint64_t value, size_t bits) {
+            if (bits > 32) {
+                write(value >> 32, bits - 32);
+                bits = 32;
+            }
+
+            buffer = (buffer << bits) | (value & ((uint64_t(1) << bits) - 1));
+            count += bits;
+            bitLength += bits;
+
+            if (count >= 32) {
+                count -= 32;
+                uint32_t word = (uint32_t)(buffer >> count);
+                size_t size = bytes.size();
+                bytes.resize(size + 4);
+                bytes[size] = (uint8_t)(word >> 24);
+                bytes[size + 1] = (uint8_t)(word >> 16);
+                bytes[size + 2] = (uint8_t)(word >> 8);
+                bytes[size + 3] = (uint8_t)word;
+            }
+        }
+
+        ByteVector finish() {
+            for (; count >= 8; count -= 8) {
+                bytes.push_back((uint8_t)(buffer >> (count - 8)));
+            }
+            if (count > 0) {
+                bytes.push_back((uint8_t)(buffer << (8 - count)));
+                count = 0;
+            }
+            buffer = 0;
+            return std::move(bytes);
+        }
+    };
+
+    struct BitReader {
+        const uint8_t* data;
+        size_t size;
+        size_t position = 0;
+        uint64_t buffer = 0;
+        size_t count = 0;
+
+        BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+        void refill() {
+            if (position + 8 <= size) {
+                // Assembled byte by byte so the header stays free of compiler builtins and host
+                // byte order; compilers fold this into a single big-endian load.
+                uint64_t word = 0;
+                for (size_t i = 0; i < 8; ++i) {
+                    word = (word << 8) | data[position + i];
+                }
+                buffer |= word >> count;
+                position += (63 - count) >> 3;
+                count |= 56;
+            } else {
+                for (; count <= 56; count += 8) {
+                    buffer |= (uint64_t)(position < size ? data[position] : 0) << (56 - count);
+                    ++position;
+                }
+            }
+        }
+
+        uint64_t peek(size_t bits) const {
+            return bits ? buffer >> (64 - bits) : 0;
+        }
+
+        void consume(size_t bits) {
+            buffer <<= bits;
+            count -= bits;
+        }
+
+        uint64_t read(size_t bits) {
+            if (count < bits) {
+                refill();
+            }
+            uint64_t value = peek(bits);
+            consume(bits);
+            return value;
+        }
+
+        size_t consumedBits() const {
+            return position * 8 - count;
+        }
+    };
+}
+
+// Status of a span-based call; the std::string/vector overloads throw std::runtime_error instead.
+// OutOfMemory reports a failed allocation, which says nothing about the input itself.
+enum class Error {
+    None,
+    OutputTooSmall,
+    InvalidInput,
+    InputTooLarge,
+    OutOfMemory
+};
+
+// Bytes written on success. On OutputTooSmall, size is the capacity that would have sufficed
+// when the codec knows it up front, and 0 otherwise.
+struct Result {
+    size_t size;
+    Error error;
+
+    bool ok() const {
+        return error == Error::None;
+    }
+};
+
+struct ByteSpan {
+    const uint8_t* data;
+    size_t size;
+};
+
+struct MutableByteSpan {
+    uint8_t* data;
+    size_t size;
+};
+
+// How a match-finding codec picks its matches. Greedy takes the longest match at the current
+// byte. Lazy first checks the match one byte later and takes that one instead, behind a
+// literal, when it codes cheaper. Lazy2 may repeat the check once more.
+enum class Strategy {
+    Greedy,
+    Lazy,
+    Lazy2
+};
+
+constexpr int MIN_LEVEL = 1;
+constexpr int MAX_LEVEL = 9;
+constexpr int DEFAULT_LEVEL = 6;
+
+// Tuning shared by every codec. Each codec's preset(level) fills every field with values tuned
+// for that codec; callers adjust single fields from there. A codec clamps what it reads to the
+// limits of its format and ignores fields that mean nothing to it (noted at each preset).
+struct Params {
+    int level;            // MIN_LEVEL (fastest) to MAX_LEVEL (smallest output)
+    uint32_t windowLog;   // log2 of the history matches may reach back into
+    uint32_t hashLog;     // log2 of the match finder's hash table entries
+    uint32_t searchDepth; // match candidates examined per position
+    uint32_t minMatch;    // shortest match worth coding
+    uint32_t niceLength;  // a match this long ends the search early
+    Strategy strategy;
+};
+
 namespace LZ77 {
     struct Token {
         size_t offset;
@@ -21,12 +177,80 @@ namespace LZ77 {
         char next;
     };
 
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t i, size_t searchStart, size_t windowSize, size_t& bestOffset);
+    struct HashChain {
+        size_t windowSize;
+        size_t maxChainDepth;
+        size_t minMatch;
+        size_t hashLog;
+        size_t niceLength;
+        size_t chainMask;
+        std::vector<size_t> head;
+        std::vector<size_t> prev;
+
+        // The search stops at the first match of niceLength bytes or more.
+        LIBCOMPRA_API HashChain(size_t windowSize, size_t maxChainDepth = 64, size_t minMatch = 3, size_t hashLog = 15, size_t niceLength = SIZE_MAX);
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t windowSize = 32 * 1024);
+        LIBCOMPRA_API size_t hash(std::string_view input, size_t pos) const;
+
+        LIBCOMPRA_API void insert(std::string_view input, size_t pos);
+
+        LIBCOMPRA_API size_t findLongestMatch(std::string_view input, size_t pos, size_t maxLength, size_t& bestOffset) const;
+
+        // Rebases every stored position after the first delta bytes of input were discarded.
+        // delta must be a multiple of the chain size so ring slots stay aligned.
+        LIBCOMPRA_API void slide(size_t delta);
+    };
+
+    LIBCOMPRA_API size_t findLongestMatch(std::string_view input, size_t i, size_t searchStart, size_t windowSize, size_t& bestOffset);
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t windowSize = 32 * 1024, size_t maxChainDepth = 64);
 
     LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens);
 
+    // Longest match a streaming token may carry; it bounds both the lookahead and decoder memory.
+    constexpr size_t MAX_STREAM_MATCH = 4096;
+
+    // Compresses a stream chunk by chunk. Output is a sequence of Utils::encodeTokens blocks, one
+    // per call that produced tokens, closed by an empty block. Only the last windowSize bytes
+    // (rounded up to a power of two) plus the lookahead are kept between calls.
+    struct Compressor {
+        HashChain chain;
+        std::string buffer;
+        size_t position;
+        size_t inserted;
+        bool finished;
+
+        LIBCOMPRA_API explicit Compressor(size_t windowSize = 32 * 1024, size_t maxChainDepth = 64);
+
+        // Emits tokens for every byte whose match can no longer grow with more input.
+        LIBCOMPRA_API void update(const char* data, size_t size, std::string& output);
+
+        LIBCOMPRA_API void update(const std::string& data, std::string& output);
+
+        // Encodes all buffered input; the window is kept, so later matches may still reach back.
+        LIBCOMPRA_API void flush(std::string& output);
+
+        LIBCOMPRA_API void finish(std::string& output);
+    };
+
+    // Decodes a Compressor stream with memory bounded by the window, whatever the input split.
+    struct Decompressor {
+        size_t windowSize;
+        std::string history;
+        std::string pending;
+        size_t blockRemaining;
+        bool done;
+
+        LIBCOMPRA_API explicit Decompressor(size_t windowSize = 32 * 1024);
+
+        // Appends everything decodable so far to output; returns true once the end block was read.
+        LIBCOMPRA_API bool update(const char* data, size_t size, std::string& output);
+
+        LIBCOMPRA_API bool update(const std::string& data, std::string& output);
+
+        LIBCOMPRA_API bool finished() const;
+    };
+
     namespace Utils {
         LIBCOMPRA_API std::string serializeToken(const Token& token);
 
@@ -35,7 +259,27 @@ namespace LZ77 {
         LIBCOMPRA_API Token deserializeToken(const std::string& str);
 
         LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str);
+
+        // Binary form: a varint token count, then varint lengths and offsets with raw literal bytes.
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded);
     }
+
+    // Reads windowLog, hashLog, searchDepth, minMatch, niceLength and strategy.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace LZ78 {
@@ -44,11 +288,32 @@ namespace LZ78 {
         char next;
     };
 
+    // Dictionary entries as trie nodes. Node 0 is the empty string; the child of a node for a
+    // given byte is found through an open-addressed (parent, byte) table.
+    struct Trie {
+        size_t maxEntries;
+        size_t nextIndex;
+        uint32_t hashLog;
+        std::vector<uint32_t> keys;
+        std::vector<uint32_t> children;
+
+        LIBCOMPRA_API explicit Trie(size_t maxEntries = 65536);
+
+        // Index of the entry parent + byte, or 0 if it has not been added.
+        LIBCOMPRA_API size_t child(size_t parent, uint8_t byte) const;
+
+        // Adds the next entry; once maxEntries are in use the trie starts over from the empty string.
+        LIBCOMPRA_API void add(size_t parent, uint8_t byte);
+
+        LIBCOMPRA_API void reset();
+    };
+
     LIBCOMPRA_API size_t findPrefixIndex(const std::map<std::string, size_t>& dictionary, const std::string& buffer);
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input);
+    // Encoder and decoder reset their dictionaries in lockstep after maxDictionarySize entries.
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t maxDictionarySize = 65536);
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens);
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens, size_t maxDictionarySize = 65536);
 
     namespace Utils {
         LIBCOMPRA_API std::string serializeToken(const Token& token);
@@ -58,7 +323,26 @@ namespace LZ78 {
         LIBCOMPRA_API Token deserializeToken(const std::string& str);
 
         LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str);
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded);
     }
+
+    // Reads windowLog only, as the log2 of the dictionary size.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace LZMA {
@@ -68,11 +352,33 @@ namespace LZMA {
         char next;
     };
 
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t pos, size_t dictionarySize, size_t& matchPos);
+    struct Match {
+        size_t length;
+        size_t distance;
+    };
+
+    struct BinaryTree {
+        size_t dictionarySize;
+        size_t niceLength;
+        size_t cutValue;
+        size_t hashLog;
+        size_t cyclicSize;
+        std::vector<uint32_t> head3;
+        std::vector<uint32_t> head4;
+        std::vector<uint32_t> son;
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t dictionarySize = 4096);
+        LIBCOMPRA_API BinaryTree(size_t dictionarySize, size_t niceLength = 64, size_t cutValue = 48, size_t hashLog = 20);
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens, size_t dictionarySize = 4096);
+        LIBCOMPRA_API size_t getMatches(std::string_view input, size_t pos, std::vector<Match>& matches);
+
+        LIBCOMPRA_API void skip(std::string_view input, size_t pos);
+    };
+
+    LIBCOMPRA_API size_t findLongestMatch(std::string_view input, size_t pos, size_t dictionarySize, size_t& matchPos);
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t dictionarySize = 8 * 1024 * 1024, size_t niceLength = 64);
+
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens, size_t dictionarySize = 8 * 1024 * 1024);
 
     namespace Utils {
         LIBCOMPRA_API std::string serializeToken(const Token& token);
@@ -82,7 +388,27 @@ namespace LZMA {
         LIBCOMPRA_API Token deserializeToken(const std::string& str);
 
         LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str);
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded);
     }
+
+    // Reads windowLog (dictionary size), hashLog, searchDepth (binary tree cut value), minMatch
+    // and niceLength. The parse is always greedy.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace Huffman {
@@ -91,10 +417,11 @@ namespace Huffman {
     using Byte = unsigned char;
     using ByteVector = std::vector<Byte>;
     using FreqMap = std::map<Char, Int>;
+    using CodeLengths = std::array<uint8_t, 256>;
 
     struct Compressed {
         ByteVector byteVec;
-        FreqMap freqMap;
+        CodeLengths codeLengths;
         size_t bitLength;
     };
 
@@ -110,6 +437,24 @@ namespace Huffman {
         LIBCOMPRA_API bool operator()(HuffmanNode* left, HuffmanNode* right);
     };
 
+    struct Code {
+        uint64_t value;
+        uint32_t length;
+    };
+
+    using CodeTable = std::array<Code, 256>;
+
+    struct DecodeEntry {
+        uint32_t value;
+        uint8_t length;
+        uint8_t subBits;
+    };
+
+    struct DecodeTable {
+        size_t rootBits;
+        std::vector<DecodeEntry> entries;
+    };
+
     namespace Methods {
         LIBCOMPRA_API HuffmanNode* BuildHuffmanTree(const Huffman::FreqMap& freqMap);
 
@@ -117,6 +462,22 @@ namespace Huffman {
 
         LIBCOMPRA_API void FreeTree(HuffmanNode* node);
 
+        LIBCOMPRA_API CodeTable BuildCodeTable(const std::map<char, std::string>& huffmanCode);
+
+        LIBCOMPRA_API std::vector<uint8_t> BuildCodeLengths(const std::vector<uint64_t>& frequencies, size_t maxCodeLength);
+
+        LIBCOMPRA_API CodeLengths BuildCodeLengths(const FreqMap& freqMap, size_t maxCodeLength = 11);
+
+        LIBCOMPRA_API std::vector<Code> BuildCanonicalCodes(const std::vector<uint8_t>& lengths);
+
+        LIBCOMPRA_API CodeTable BuildCanonicalCodes(const CodeLengths& lengths);
+
+        LIBCOMPRA_API DecodeTable BuildDecodeTable(const CodeTable& codes, size_t rootBits = 11);
+
+        LIBCOMPRA_API ByteVector EncodeSymbols(std::string_view text, const CodeTable& codes, size_t& bitLength);
+
+        LIBCOMPRA_API std::string DecodeSymbols(const ByteVector& compressedData, size_t bitLength, const DecodeTable& table);
+
         LIBCOMPRA_API Huffman::ByteVector PackBitsToBytes(const std::string& bitString);
 
         LIBCOMPRA_API std::string UnpackBytesToBits(const Huffman::ByteVector& compressedData);
@@ -126,7 +487,9 @@ namespace Huffman {
         LIBCOMPRA_API std::string UnpackBytesToBits(const Huffman::ByteVector& compressedData, size_t bitLength);
     }
 
-    LIBCOMPRA_API Compressed compress(const std::string& text);
+    LIBCOMPRA_API Compressed compress(std::string_view text, size_t maxCodeLength = 11);
+
+    LIBCOMPRA_API std::string decompress(const ByteVector& compressed, const CodeLengths& codeLengths, size_t bitLength);
 
     LIBCOMPRA_API std::string decompress(const ByteVector& compressed, const FreqMap& freqMap, size_t bitLength);
 
@@ -134,9 +497,9 @@ namespace Huffman {
 
     /* COMPATIBILITY */
 
-    LIBCOMPRA_API Huffman::ByteVector compress(const std::string& text, FreqMap& freqMap, size_t& bitLength);
+    LIBCOMPRA_API Huffman::ByteVector compress(std::string_view text, FreqMap& freqMap, size_t& bitLength);
 
-    LIBCOMPRA_API Huffman::ByteVector Compress(const std::string& text, FreqMap& freqMap, size_t& bitLength);
+    LIBCOMPRA_API Huffman::ByteVector Compress(std::string_view text, FreqMap& freqMap, size_t& bitLength);
 
     LIBCOMPRA_API std::string Decompress(const ByteVector& compressed, const FreqMap& freqMap, size_t bitLength);
 
@@ -145,23 +508,113 @@ namespace Huffman {
 
         LIBCOMPRA_API std::string StringizeByteVec(const Huffman::ByteVector& byteVec);
     }
+
+    // Huffman has no tunable parameters; the Params overloads let callers treat every codec alike.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace Deflate {
-    LIBCOMPRA_API Huffman::Compressed compress(const std::string& input, size_t windowSize = 32 * 1024);
+    enum class Wrapper {
+        Raw,
+        Zlib,
+        Gzip
+    };
+
+    // Decodes a DEFLATE stream incrementally. Input may be split anywhere: an incomplete
+    // header or symbol is kept and retried once more input arrives.
+    struct Inflater {
+        Wrapper wrapper;
+        int state;
+        std::string input;
+        size_t bitPosition;
+        std::string window;
+        size_t windowEnd;
+        size_t flushed;
+        bool finalBlock;
+        size_t storedRemaining;
+        std::vector<uint32_t> literalTable;
+        std::vector<uint32_t> distanceTable;
+        uint32_t checksum;
+        uint64_t totalOut;
+
+        LIBCOMPRA_API explicit Inflater(Wrapper wrapper = Wrapper::Raw);
+
+        // Appends everything decodable so far to output; returns true once the stream has ended.
+        LIBCOMPRA_API bool update(const char* data, size_t size, std::string& output);
+
+        LIBCOMPRA_API bool update(const std::string& data, std::string& output);
+
+        // Primes the history with the last 32 KiB of dictionary, like zlib's
+        // inflateSetDictionary. Call before the first update.
+        LIBCOMPRA_API void setDictionary(std::string_view dictionary);
+
+        LIBCOMPRA_API bool finished() const;
+
+        // Compressed bytes received after the end of the stream.
+        LIBCOMPRA_API size_t trailingBytes() const;
+    };
+
+    namespace Methods {
+        LIBCOMPRA_API uint32_t Crc32(const char* data, size_t size, uint32_t crc = 0);
+
+        LIBCOMPRA_API uint32_t Adler32(const char* data, size_t size, uint32_t adler = 1);
+    }
+
+    LIBCOMPRA_API std::string compress(std::string_view input, Wrapper wrapper = Wrapper::Raw, int level = 6);
 
-    LIBCOMPRA_API std::string decompress(const Huffman::ByteVector& byteVec, const Huffman::FreqMap& freqMap, const size_t bitLength);
+    LIBCOMPRA_API std::string decompress(std::string_view input, Wrapper wrapper = Wrapper::Raw);
 
-    LIBCOMPRA_API std::string decompress(const Huffman::Compressed& compressed);
+    // Reads windowLog (at most 15), hashLog, searchDepth, minMatch, niceLength and strategy;
+    // Lazy2 parses like Lazy and a searchDepth of 0 writes stored blocks.
+    // compress(input, wrapper, level) uses these presets for levels 1-9.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params, Wrapper wrapper = Wrapper::Raw);
+
+    // Raw stream whose matches may reach into the last 32 KiB of dictionary; decoding needs the
+    // same dictionary. This is how pigz links independently compressed blocks.
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params, std::string_view dictionary);
+
+    LIBCOMPRA_API std::string decompress(std::string_view input, std::string_view dictionary);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, Wrapper wrapper = Wrapper::Raw, int level = 6);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params, Wrapper wrapper = Wrapper::Raw);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output, Wrapper wrapper = Wrapper::Raw);
 }
 
 
 namespace LZ4 {
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t i, size_t& match_offset);
+    LIBCOMPRA_API std::string compress(std::string_view input);
 
-    LIBCOMPRA_API std::string compress(const std::string& input);
+    LIBCOMPRA_API std::string compressHC(std::string_view input, int level = 9);
 
-    LIBCOMPRA_API std::string decompress(const std::string& input);
+    LIBCOMPRA_API std::string decompress(std::string_view input);
+
+    // Reads hashLog, searchDepth, niceLength and strategy. A search depth of 1 selects the
+    // single-probe fast compressor; the format fixes the 64 KiB window and 4-byte minimum match.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace LZ5 {
@@ -171,9 +624,12 @@ namespace LZ5 {
         char next;
     };
 
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t pos, size_t maxOffset, size_t& matchOffset);
+    LIBCOMPRA_API size_t findLongestMatch(std::string_view input, size_t pos, size_t maxOffset, size_t& matchOffset);
+
+    using Strategy = LIBCOMPRA_NAMESPACE::Strategy;
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t maxOffset = 32 * 1024);
+    // Lazy2 also searches deeper hash chains than Lazy, and Lazy deeper than Greedy.
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t maxOffset = 32 * 1024, Strategy strategy = Strategy::Lazy);
 
     LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens);
 
@@ -185,23 +641,91 @@ namespace LZ5 {
         LIBCOMPRA_API Token deserializeToken(const std::string& str);
 
         LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str);
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded);
     }
+
+    // Reads windowLog, hashLog, searchDepth, minMatch, niceLength and strategy.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace LZW {
-    LIBCOMPRA_API void addToDictionary(std::map<std::string, int>& dictionary, const std::string& key, int& code);
+    // What both sides do once every code of maxCodeWidth bits has been assigned.
+    enum class FullPolicy {
+        Freeze,
+        Reset
+    };
 
-    LIBCOMPRA_API void compress(std::vector<int>& result, std::map<std::string, int>& dictionary, const std::string& input, int& code);
+    // Codes keyed by (prefix code, next byte) in an open-addressed table, so extending the
+    // current string is a single probe sequence and never builds a std::string.
+    struct Dictionary {
+        uint32_t maxCodeWidth;
+        FullPolicy policy;
+        uint32_t firstCode;
+        uint32_t nextCode;
+        uint32_t hashLog;
+        std::vector<uint32_t> keys;
+        std::vector<uint32_t> codes;
 
-    LIBCOMPRA_API std::vector<int> compress(const std::string& input);
+        LIBCOMPRA_API explicit Dictionary(uint32_t maxCodeWidth = 16, FullPolicy policy = FullPolicy::Reset, uint32_t firstCode = 256);
 
-    LIBCOMPRA_API void decompress(std::string& result, std::map<int, std::string>& dictionary, const std::vector<int>& input, int& code);
+        // Code of the string prefix + byte, or -1 if it has not been added.
+        LIBCOMPRA_API int find(uint32_t prefix, uint8_t byte) const;
+
+        // Assigns the next code; a full dictionary is then reset or left frozen per policy.
+        LIBCOMPRA_API void add(uint32_t prefix, uint8_t byte);
+
+        LIBCOMPRA_API void reset();
+    };
 
-    LIBCOMPRA_API std::string decompress(const std::vector<int>& input);
+    LIBCOMPRA_API std::vector<int> compress(std::string_view input, uint32_t maxCodeWidth = 16, FullPolicy policy = FullPolicy::Reset);
 
-    LIBCOMPRA_API void compressOptimized(std::vector<int>& result, std::map<std::string, int>& dictionary, const std::string& input, int& code);
+    LIBCOMPRA_API std::string decompress(const std::vector<int>& input, uint32_t maxCodeWidth = 16, FullPolicy policy = FullPolicy::Reset);
 
-    LIBCOMPRA_API std::vector<int> compressOptimized(const std::string& input);
+    // compress(1)-style stream: a width byte, the varint bit count, then MSB-first codes that grow
+    // from 9 to maxCodeWidth bits. Code 256 is CLEAR, sent when the dictionary fills.
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, uint32_t maxCodeWidth = 16);
+
+    LIBCOMPRA_API std::string decompressPacked(std::string_view input);
+
+    // Reads windowLog only, as the widest code (9 to 20 bits).
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
+
+    /* COMPATIBILITY */
+
+    LIBCOMPRA_API void addToDictionary(std::map<std::string, int>& dictionary, const std::string& key, int& code);
+
+    LIBCOMPRA_API void compress(std::vector<int>& result, std::map<std::string, int>& dictionary, std::string_view input, int& code);
+
+    LIBCOMPRA_API void decompress(std::string& result, std::map<int, std::string>& dictionary, const std::vector<int>& input, int& code);
+
+    LIBCOMPRA_API void compressOptimized(std::vector<int>& result, std::map<std::string, int>& dictionary, std::string_view input, int& code);
+
+    LIBCOMPRA_API std::vector<int> compressOptimized(std::string_view input);
 
     LIBCOMPRA_API void decompressOptimized(std::string& result, std::map<int, std::string>& dictionary, const std::vector<int>& input, int& code);
 
@@ -215,10 +739,18 @@ namespace LZO {
         char next;
     };
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t windowSize = 8 * 1024);
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t windowSize = 8 * 1024);
 
     LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens);
 
+    // LZO1X-1 block: literal runs and matches in LZO1X's byte opcodes, closed by the 0x11 0x00 0x00
+    // end marker. Matches come from a single-probe hash dictionary over a 48 KiB window, and the
+    // search steps further ahead the longer it goes without one.
+    LIBCOMPRA_API std::string compress1X(std::string_view input);
+
+    // Decodes any LZO1X block, including match forms compress1X never emits; no dictionary is built.
+    LIBCOMPRA_API std::string decompress1X(std::string_view input);
+
     namespace Utils {
         LIBCOMPRA_API std::string serializeToken(const Token& token);
 
@@ -227,7 +759,26 @@ namespace LZO {
         LIBCOMPRA_API Token deserializeToken(const std::string& str);
 
         LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str);
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded);
     }
+
+    // Reads hashLog only, the size of the single-probe dictionary; LZO1X fixes everything else.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::string compress1X(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace LZSS {
@@ -238,14 +789,23 @@ namespace LZSS {
         size_t length;
     };
 
-    LIBCOMPRA_API size_t findBestMatch(const std::string& input, size_t windowStart, size_t currentPos, size_t windowSize, size_t& bestOffset);
+    LIBCOMPRA_API size_t findBestMatch(std::string_view input, size_t windowStart, size_t currentPos, size_t windowSize, size_t& bestOffset);
     
     LIBCOMPRA_API void addToken(std::vector<Token>& tokens, bool isLiteral, char literal, size_t offset, size_t length);
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t windowSize = 4 * 1024, size_t lookaheadSize = 18);
+    // Matches are at most lookaheadSize bytes long and reach back at most windowSize bytes.
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t windowSize = 4 * 1024, size_t lookaheadSize = 18);
 
     LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens);
 
+    // Classic LZSS bytes: two header bytes giving the offset and length bit widths, then groups
+    // of up to eight items behind a flag byte (bit i set: item i is a match). Literals are raw
+    // bytes; a match packs offset - 1 and length - 3 big-endian into as few bytes as the widths
+    // allow, two for the default 4 KiB window and 18-byte lookahead.
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, size_t windowSize = 4 * 1024, size_t lookaheadSize = 18);
+
+    LIBCOMPRA_API std::string decompressPacked(std::string_view input);
+
     namespace Utils {
         LIBCOMPRA_API std::string serializeToken(const Token& token);
 
@@ -254,7 +814,29 @@ namespace LZSS {
         LIBCOMPRA_API Token deserializeToken(const std::string& str);
 
         LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str);
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size);
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded);
     }
+
+    // Reads windowLog, hashLog, searchDepth and niceLength, which is also the longest match
+    // the packed format can carry (the lookahead). The parse is greedy with 3-byte minimum matches.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace FSE {
@@ -263,24 +845,57 @@ namespace FSE {
         size_t frequency;
     };
 
-    struct EncodedSymbol {
-        char character;
-        std::string code;
-    };
-
-    using EncodingTable = std::map<char, EncodedSymbol>;
     using FrequencyTable = std::map<char, size_t>;
     using Byte = uint8_t;
     using ByteVector = std::vector<Byte>;
+    using NormalizedCounts = std::array<uint16_t, 256>;
+
+    // Everything the decoder needs besides the bitstream: normalized counts sum to 1 << tableLog.
+    struct Table {
+        uint32_t tableLog;
+        uint32_t stateCount;
+        size_t symbolCount;
+        NormalizedCounts normalizedCounts;
+    };
 
     struct Compressed {
         ByteVector byteVec;
-        EncodingTable encodingTable;
+        Table table;
         size_t bitLength;
     };
 
+    struct SymbolTransform {
+        int32_t deltaFindState;
+        uint32_t deltaNbBits;
+    };
+
+    struct EncodeTable {
+        uint32_t tableLog;
+        std::vector<uint16_t> stateTable;
+        std::array<SymbolTransform, 256> symbolTT;
+    };
+
+    struct DecodeEntry {
+        uint16_t newState;
+        uint8_t symbol;
+        uint8_t nbBits;
+    };
+
+    struct DecodeTable {
+        uint32_t tableLog;
+        std::vector<DecodeEntry> entries;
+    };
+
     namespace Methods {
-        LIBCOMPRA_API EncodingTable buildEncodingTable(const std::string& input);
+        LIBCOMPRA_API NormalizedCounts NormalizeCounts(const std::array<uint64_t, 256>& counts, uint32_t tableLog);
+
+        LIBCOMPRA_API EncodeTable BuildEncodeTable(const NormalizedCounts& normalizedCounts, uint32_t tableLog);
+
+        LIBCOMPRA_API DecodeTable BuildDecodeTable(const NormalizedCounts& normalizedCounts, uint32_t tableLog);
+
+        LIBCOMPRA_API ByteVector EncodeSymbols(std::string_view input, const EncodeTable& table, size_t stateCount, size_t& bitLength);
+
+        LIBCOMPRA_API std::string DecodeSymbols(const ByteVector& encoded, size_t bitLength, size_t symbolCount, const DecodeTable& table, size_t stateCount);
 
         LIBCOMPRA_API ByteVector PackBitsToBytes(const std::string& bitString);
 
@@ -291,25 +906,189 @@ namespace FSE {
         LIBCOMPRA_API std::string UnpackBytesToBits(const ByteVector& byteVec, size_t bitLength);
     }
 
-    LIBCOMPRA_API Compressed compress(const std::string& input);
+    LIBCOMPRA_API Compressed compress(std::string_view input, uint32_t tableLog = 11, uint32_t stateCount = 2);
 
     LIBCOMPRA_API std::string decompress(const Compressed& compressed);
 
-    LIBCOMPRA_API std::string decompress(const ByteVector& encoded, const std::map<char, EncodedSymbol>& encodingTable, size_t bitLength);
+    LIBCOMPRA_API std::string decompress(const ByteVector& encoded, const Table& table, size_t bitLength);
 
     namespace Stringize {
-        LIBCOMPRA_API std::string StringizeEncodingTable(const FSE::EncodingTable& freqMap);
+        LIBCOMPRA_API std::string StringizeTable(const FSE::Table& table);
 
         LIBCOMPRA_API std::string StringizeByteVec(const FSE::ByteVector& byteVec);
     }
+
+    // FSE has no tunable parameters; the Params overloads let callers treat every codec alike.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
 }
 
 namespace Zstandard {
-    LIBCOMPRA_API FSE::Compressed compress(const std::string& input, size_t windowSize = 32 * 1024);
+    LIBCOMPRA_API std::string compress(std::string_view input, size_t windowSize = 32 * 1024);
+
+    LIBCOMPRA_API std::string decompress(std::string_view input);
+
+    // Reads windowLog, hashLog, searchDepth, minMatch, niceLength and strategy.
+    LIBCOMPRA_API Params preset(int level);
+
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params);
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output);
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params);
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output);
+}
+
+// Run-time access to every codec through its span API, so callers can pick one per stream.
+namespace Codecs {
+    // Stable identifiers, safe to store next to compressed data. Values from 128 up are left
+    // for codecs registered with add().
+    enum class Id : uint8_t {
+        LZ77 = 1,
+        LZ78,
+        LZMA,
+        Huffman,
+        Deflate,
+        LZ4,
+        LZ5,
+        LZW,
+        LZO,
+        LZSS,
+        FSE,
+        Zstandard
+    };
+
+    // decompress needs an output span of at least the original size, which the caller keeps.
+    struct Codec {
+        Id id;
+        const char* name;
+        Params (*preset)(int level);
+        size_t (*compressBound)(size_t inputSize);
+        Result (*compress)(ByteSpan input, MutableByteSpan output, const Params& params);
+        Result (*decompress)(ByteSpan input, MutableByteSpan output);
+
+        // Optional, nullptr when unsupported: streams whose matches may reach into a dictionary
+        // that the decoder is given again.
+        Result (*compressWithDictionary)(ByteSpan dictionary, ByteSpan input, MutableByteSpan output, const Params& params) = nullptr;
+        Result (*decompressWithDictionary)(ByteSpan dictionary, ByteSpan input, MutableByteSpan output) = nullptr;
+    };
+
+    // The built-in codecs (Deflate as a raw stream) followed by any added ones.
+    LIBCOMPRA_API std::vector<Codec> all();
+
+    // Both lookups throw std::runtime_error for an unknown codec.
+    LIBCOMPRA_API Codec find(Id id);
+
+    LIBCOMPRA_API Codec find(std::string_view name);
+
+    // Registers a custom codec; throws std::runtime_error when its id is below 128 or its id or
+    // name is taken.
+    // Not synchronized: register before other threads start looking codecs up.
+    LIBCOMPRA_API void add(const Codec& codec);
+
+    // Unregisters a codec registered with add(); throws std::runtime_error for a built-in or
+    // unknown id. Not synchronized, like add().
+    LIBCOMPRA_API void remove(Id id);
+
+    enum class Objective {
+        Ratio, // smallest output
+        Speed  // fastest compression
+    };
+
+    // A candidate qualifies when it reaches both minimums; 0 disables a minimum. Speeds are
+    // in MB/s of uncompressed input and ratios are input size over output size.
+    struct Target {
+        Objective objective = Objective::Ratio;
+        double minCompressSpeed = 0;
+        double minRatio = 0;
+    };
+
+    struct Candidate {
+        Id codec;
+        Params params;
+    };
+
+    // Measurements on the sample for the chosen candidate.
+    struct Selection {
+        Id codec;
+        Params params;
+        double ratio;
+        double compressSpeed;
+        double decompressSpeed;
+        bool meetsTarget;
+    };
+
+    // Each registered codec at MIN_LEVEL, DEFAULT_LEVEL and MAX_LEVEL.
+    LIBCOMPRA_API std::vector<Candidate> defaultCandidates();
+
+    // Compresses and decompresses a sample of up to sampleSize bytes, taken as evenly spread
+    // slices of input, with every candidate. Returns the best qualifying candidate by
+    // objective; when none qualifies, returns the one that comes closest to the minimums.
+    // Throws std::runtime_error when candidates is empty.
+    LIBCOMPRA_API Selection autoSelect(ByteSpan input, const Target& target, const std::vector<Candidate>& candidates = defaultCandidates(), size_t sampleSize = 64 * 1024);
+}
+
+// Block-parallel compression. The input is cut into fixed-size blocks that are compressed
+// concurrently on a work-stealing pool and framed behind a table of per-block sizes.
+namespace Parallel {
+    struct Options {
+        Codecs::Id codec;
+        Params params;
+        size_t blockSize;      // uncompressed bytes per block, at most 1 GiB
+        size_t dictionarySize; // previous-block tail each block may match into; 0 keeps blocks independent
+        unsigned threads;      // 0 uses every hardware thread
+    };
+
+    // The codec's preset(level) with 1 MiB independent blocks on every hardware thread.
+    LIBCOMPRA_API Options defaults(Codecs::Id codec = Codecs::Id::LZ4, int level = DEFAULT_LEVEL);
+
+    // A nonzero dictionarySize needs a codec with dictionary support (Deflate, which uses at
+    // most 32 KiB of it); throws std::runtime_error otherwise.
+    LIBCOMPRA_API std::string compress(std::string_view input, const Options& options = defaults());
+
+    // Independent blocks decode in parallel; blocks linked by a dictionary decode in order.
+    // The block table is validated before the output is allocated. A custom codec whose blocks
+    // expand past 1032:1 must report its output size for an empty output span (see Result),
+    // or its streams are rejected as implausible.
+    LIBCOMPRA_API std::string decompress(std::string_view input, unsigned threads = 0);
+}
+
+// Random-access container: fixed-size frames compressed independently, followed by an index of
+// where each frame ends in the compressed and the uncompressed data. A range read decodes only
+// the frames it overlaps, so over a memory-mapped blob it touches little beyond them.
+namespace Seekable {
+    struct Options {
+        Codecs::Id codec;
+        Params params;
+        size_t frameSize; // uncompressed bytes per frame; smaller frames make range reads cheaper
+        unsigned threads; // 0 uses every hardware thread
+    };
+
+    // The codec's preset(level) with 64 KiB frames on every hardware thread.
+    LIBCOMPRA_API Options defaults(Codecs::Id codec = Codecs::Id::LZ4, int level = DEFAULT_LEVEL);
+
+    LIBCOMPRA_API std::string compress(std::string_view input, const Options& options = defaults());
+
+    // Uncompressed size, read from the index alone.
+    LIBCOMPRA_API uint64_t contentSize(std::string_view input);
 
-    LIBCOMPRA_API std::string decompress(const FSE::ByteVector& byteVec, const FSE::EncodingTable& encodingTable, const size_t bitLength);
+    // Bytes [offset, offset + length) of the content, cut short at its end. Frames the range
+    // overlaps are decoded on up to threads workers; no others are read. Their index entries
+    // are checked, as Parallel::decompress checks its blocks, before the output is allocated.
+    // Throws std::runtime_error for an offset past the end or damaged input.
+    LIBCOMPRA_API std::string decompressRange(std::string_view input, uint64_t offset, size_t length, unsigned threads = 0);
 
-    LIBCOMPRA_API std::string decompress(const FSE::Compressed& compressed);
+    LIBCOMPRA_API std::string decompress(std::string_view input, unsigned threads = 0);
 }
 } // Compra
 
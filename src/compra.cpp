@@ -3,250 +3,4421 @@
 #include <compra/compra.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
 #include <sstream>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace LIBCOMPRA_NAMESPACE {
-namespace LZ77 {
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t i, size_t searchStart, size_t windowSize, size_t& bestOffset) {
-        size_t bestLength = 0;
+namespace {
+    constexpr size_t NIL = std::numeric_limits<size_t>::max();
 
-        for (size_t j = searchStart; j < i; ++j) {
-            size_t length = 0;
-            while (i + length < input.size() && input[j + length] == input[i + length]) {
-                ++length;
-                if (length > bestLength) {
-                    bestOffset = i - j;
-                    bestLength = length;
-                }
+    inline uint32_t read32(const char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t read64(const char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    constexpr bool LITTLE_ENDIAN_HOST = false;
+#else
+    constexpr bool LITTLE_ENDIAN_HOST = true;
+#endif
+
+    // Byte swaps and bit scans through GCC/Clang builtins or MSVC intrinsics, with plain C++ for
+    // anything else. The scans require a nonzero value.
+    inline uint64_t bswap64(uint64_t value) {
+#if defined(__GNUC__)
+        return __builtin_bswap64(value);
+#elif defined(_MSC_VER)
+        return _byteswap_uint64(value);
+#else
+        value = (value >> 32) | (value << 32);
+        value = ((value & 0xFFFF0000FFFF0000ull) >> 16) | ((value & 0x0000FFFF0000FFFFull) << 16);
+        return ((value & 0xFF00FF00FF00FF00ull) >> 8) | ((value & 0x00FF00FF00FF00FFull) << 8);
+#endif
+    }
+
+    inline uint32_t highBit32(uint32_t value) {
+#if defined(__GNUC__)
+        return 31 - __builtin_clz(value);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse(&index, value);
+        return (uint32_t)index;
+#else
+        uint32_t bit = 0;
+        while (value >>= 1) ++bit;
+        return bit;
+#endif
+    }
+
+    inline uint32_t highBit64(uint64_t value) {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return (uint32_t)index;
+#else
+        return value >> 32 ? 32 + highBit32((uint32_t)(value >> 32)) : highBit32((uint32_t)value);
+#endif
+    }
+
+    inline uint32_t lowBit64(uint64_t value) {
+#if defined(__GNUC__)
+        return __builtin_ctzll(value);
+#elif defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return (uint32_t)index;
+#else
+        return highBit64(value & (0 - value));
+#endif
+    }
+
+    inline uint64_t readLE64(const void* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return LITTLE_ENDIAN_HOST ? value : bswap64(value);
+    }
+
+    inline uint64_t readBE64(const void* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return LITTLE_ENDIAN_HOST ? bswap64(value) : value;
+    }
+
+    constexpr size_t WILDCOPY_SLACK = 32;
+
+    // Copies an overlapping match; may write up to WILDCOPY_SLACK bytes past op + length.
+    inline void copyMatch(char* op, size_t offset, size_t length) {
+        char* end = op + length;
+        const char* match = op - offset;
+
+        if (offset >= 16) {
+            do {
+                std::memcpy(op, match, 16);
+                op += 16;
+                match += 16;
+            } while (op < end);
+            return;
+        }
+
+        if (offset < 8) {
+            for (size_t i = 0; i < 8; ++i) {
+                op[i] = match[i];
             }
+            op += 8;
+            match = op - offset * ((8 + offset - 1) / offset);
         }
-        return bestLength;
-    }
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t windowSize) {
-        std::vector<Token> tokens;
-        size_t i = 0;
+        while (op < end) {
+            std::memcpy(op, match, 8);
+            op += 8;
+            match += 8;
+        }
+    }
 
-        while (i < input.size()) {
-            size_t bestOffset = 0;
-            size_t bestLength = findLongestMatch(input, i, (i < windowSize) ? 0 : i - windowSize, windowSize, bestOffset);
+    inline size_t countMatch(const char* a, const char* b, size_t limit) {
+        size_t length = 0;
+        while (length + 8 <= limit) {
+            uint64_t diff = read64(a + length) ^ read64(b + length);
+            if (diff) {
+                // The first differing byte sits at the low end of the word on little-endian hosts.
+                return length + ((LITTLE_ENDIAN_HOST ? lowBit64(diff) : 63 - highBit64(diff)) >> 3);
+            }
+            length += 8;
+        }
+        while (length < limit && a[length] == b[length]) {
+            ++length;
+        }
+        return length;
+    }
 
-            char nextChar = (i + bestLength < input.size()) ? input[i + bestLength] : '\0';
-            tokens.push_back({bestOffset, bestLength, nextChar});
-            i += bestLength + 1;
+    inline void writeVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += (char)(value | 0x80);
+            value >>= 7;
         }
+        out += (char)value;
+    }
 
-        return tokens;
+    // Returns false on truncated or overlong input, leaving the error message to the caller.
+    inline bool readVarint(const unsigned char*& ip, const unsigned char* iend, uint64_t& value) {
+        value = 0;
+        for (size_t shift = 0; shift < 64; shift += 7) {
+            if (ip >= iend) return false;
+            unsigned char byte = *ip++;
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
     }
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
-        std::string output;
+    // Bounds-checked cursor over serialized input; every failure throws with the codec's message.
+    struct ByteReader {
+        const unsigned char* ip;
+        const unsigned char* iend;
+        const char* error;
 
-        for (const auto& token : tokens) {
-            size_t start = output.size() - token.offset;
-            for (size_t i = 0; i < token.length; ++i)
-                output += output[start + i];
+        ByteReader(const unsigned char* data, size_t size, const char* error) : ip(data), iend(data + size), error(error) {}
 
-            if (token.next != '\0')
-                output += token.next;
+        uint64_t varint() {
+            uint64_t value;
+            if (!readVarint(ip, iend, value)) {
+                throw std::runtime_error(error);
+            }
+            return value;
         }
 
-        return output;
+        uint8_t byte() {
+            if (ip >= iend) throw std::runtime_error(error);
+            return *ip++;
+        }
+
+        const unsigned char* take(size_t size) {
+            if (size > (size_t)(iend - ip)) throw std::runtime_error(error);
+            const unsigned char* start = ip;
+            ip += size;
+            return start;
+        }
+
+        size_t remaining() const {
+            return (size_t)(iend - ip);
+        }
+    };
+
+    inline size_t varintLength(uint64_t value) {
+        size_t length = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            ++length;
+        }
+        return length;
     }
 
-    namespace Utils {
-        LIBCOMPRA_API std::string serializeToken(const Token& token) {
-            return std::to_string(token.offset) + "," + std::to_string(token.length) + "," + token.next;
+    inline std::string_view asView(ByteSpan span) {
+        return std::string_view((const char*)span.data, span.size);
+    }
+
+    // Bounds-checked cursor over the caller's buffer for the span encoders. A write that does not
+    // fit returns false and writes nothing, so an encoder can give up at the first one.
+    struct ByteWriter {
+        uint8_t* start;
+        uint8_t* op;
+        uint8_t* oend;
+
+        explicit ByteWriter(MutableByteSpan output) : start(output.data), op(output.data), oend(output.data + output.size) {}
+
+        size_t room() const {
+            return (size_t)(oend - op);
         }
 
-        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
-            std::string result;
-            for (const auto& token : tokens) {
-                result += serializeToken(token) + ";";
+        size_t written() const {
+            return (size_t)(op - start);
+        }
+
+        bool byte(uint8_t value) {
+            if (op == oend) return false;
+            *op++ = value;
+            return true;
+        }
+
+        bool varint(uint64_t value) {
+            if (room() < varintLength(value)) return false;
+            while (value >= 0x80) {
+                *op++ = (uint8_t)(value | 0x80);
+                value >>= 7;
             }
-            if (!result.empty()) {
-                result.pop_back();
+            *op++ = (uint8_t)value;
+            return true;
+        }
+
+        bool bytes(const void* data, size_t size) {
+            if (room() < size) return false;
+            if (size > 0) {
+                std::memcpy(op, data, size);
+                op += size;
             }
-            return result;
+            return true;
         }
 
-        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
-            size_t firstComma = str.find(',');
-            size_t secondComma = str.find(',', firstComma + 1);
-            size_t offset = std::stoull(str.substr(0, firstComma));
-            size_t length = std::stoull(str.substr(firstComma + 1, secondComma - firstComma - 1));
-            char next = str[secondComma + 1];
-            return {offset, length, next};
+        Result finish(bool fitted) const {
+            return fitted ? Result{written(), Error::None} : Result{0, Error::OutputTooSmall};
         }
+    };
 
-        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
-            std::vector<Token> tokens;
-            size_t start = 0;
-            size_t end;
-            while ((end = str.find(';', start)) != std::string::npos) {
-                tokens.push_back(deserializeToken(str.substr(start, end - start)));
-                start = end + 1;
+    // ByteWriter's interface over a growing std::string, for encoders shared with the string API.
+    struct StringWriter {
+        std::string& out;
+
+        bool byte(uint8_t value) {
+            out += (char)value;
+            return true;
+        }
+
+        bool varint(uint64_t value) {
+            writeVarint(out, value);
+            return true;
+        }
+
+        bool bytes(const void* data, size_t size) {
+            out.append((const char*)data, size);
+            return true;
+        }
+    };
+
+    // Several formats lead with a varint (a token count or a bit length) that the encoder only
+    // knows once it is done. The body writes after a single byte left for it and returns the
+    // value, or NIL once a write did not fit; a longer varint then slides the body up, so the
+    // call fails only when the finished stream really is larger than the buffer.
+    template <typename Body>
+    bool writeVarintPrefixed(ByteWriter& out, Body&& body) {
+        if (out.room() == 0) return false;
+
+        uint8_t* prefix = out.op++;
+        uint64_t value = body();
+        if (value == NIL) return false;
+
+        size_t size = (size_t)(out.op - prefix) - 1;
+        size_t extra = varintLength(value) - 1;
+        if (out.room() < extra) return false;
+        if (extra > 0) {
+            std::memmove(prefix + 1 + extra, prefix + 1, size);
+        }
+        out.op = prefix;
+        out.varint(value);
+        out.op += size;
+        return true;
+    }
+
+    // BitIO::BitWriter's MSB-first packing written through a ByteWriter, byte for byte the same
+    // stream. Once a word does not fit, overflow is set and every later write is dropped.
+    struct SpanBitWriter {
+        ByteWriter& out;
+        uint64_t buffer = 0;
+        size_t count = 0;
+        size_t bitLength = 0;
+        bool overflow = false;
+
+        explicit SpanBitWriter(ByteWriter& out) : out(out) {}
+
+        void write(uint64_t value, size_t bits) {
+            if (bits > 32) {
+                write(value >> 32, bits - 32);
+                bits = 32;
             }
-            if (start < str.size()) {
-                tokens.push_back(deserializeToken(str.substr(start)));
+
+            buffer = (buffer << bits) | (value & ((uint64_t(1) << bits) - 1));
+            count += bits;
+            bitLength += bits;
+
+            if (count >= 32) {
+                count -= 32;
+                uint32_t word = (uint32_t)(buffer >> count);
+                uint8_t bytes[4] = {(uint8_t)(word >> 24), (uint8_t)(word >> 16), (uint8_t)(word >> 8), (uint8_t)word};
+                overflow = overflow || !out.bytes(bytes, 4);
             }
-            return tokens;
         }
-    }
-}
 
-namespace LZ78 {
-    LIBCOMPRA_API size_t findPrefixIndex(const std::map<std::string, size_t>& dictionary, const std::string& buffer) {
-        if (buffer.size() > 1) {
-            auto prefix = dictionary.find(buffer.substr(0, buffer.size() - 1));
-            if (prefix != dictionary.end()) {
-                return prefix->second;
+        bool finish() {
+            for (; count >= 8; count -= 8) {
+                overflow = overflow || !out.byte((uint8_t)(buffer >> (count - 8)));
+            }
+            if (count > 0) {
+                overflow = overflow || !out.byte((uint8_t)(buffer << (8 - count)));
+                count = 0;
             }
+            return !overflow;
         }
-        return 0;
-    }
+    };
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input) {
-        std::map<std::string, size_t> dictionary;
-        std::vector<Token> tokens;
-        std::string buffer;
-        size_t dictSize = 1;
+    // Output sinks for decoders shared by the span and string APIs. FixedOutput is the caller's
+    // buffer; GrowingOutput doubles a std::string and always keeps WILDCOPY_SLACK spare.
+    struct FixedOutput {
+        uint8_t* data;
+        size_t capacity;
 
-        for (char c : input) {
-            buffer += c;
-            if (dictionary.find(buffer) == dictionary.end()) {
-                size_t prefixIndex = findPrefixIndex(dictionary, buffer);
-                tokens.push_back({prefixIndex, c});
-                dictionary[buffer] = dictSize++;
-                buffer.clear();
+        bool reserve(size_t op, size_t length) { return length <= capacity - op; }
+        bool roomy(size_t op, size_t length) const { return capacity - op >= length + WILDCOPY_SLACK; }
+    };
+
+    struct GrowingOutput {
+        std::string& buffer;
+        uint8_t* data;
+
+        explicit GrowingOutput(std::string& buffer) : buffer(buffer), data((uint8_t*)&buffer[0]) {}
+
+        bool reserve(size_t op, size_t length) {
+            if (op + length + WILDCOPY_SLACK > buffer.size()) {
+                buffer.resize(std::max(buffer.size() * 2, op + length + WILDCOPY_SLACK));
+                data = (uint8_t*)&buffer[0];
+            }
+            return true;
+        }
+        bool roomy(size_t, size_t) const { return true; }
+    };
+
+    // Copies a match of length bytes from distance back, wild while the sink has room to spare.
+    template <typename Output>
+    inline void writeMatch(Output& output, size_t op, size_t distance, size_t length) {
+        if (length > 0 && output.roomy(op, length)) {
+            copyMatch((char*)output.data + op, distance, length);
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                output.data[op + i] = output.data[op + i - distance];
             }
         }
+    }
 
-        if (!buffer.empty()) {
-            size_t prefixIndex = findPrefixIndex(dictionary, buffer);
-            tokens.push_back(Token{prefixIndex, buffer.back()});
+    // Copies a result staged in a std::string into the caller's buffer.
+    Result writeOutput(std::string_view bytes, MutableByteSpan output) {
+        if (bytes.size() > output.size) {
+            return {bytes.size(), Error::OutputTooSmall};
         }
+        if (!bytes.empty()) {
+            std::memcpy(output.data, bytes.data(), bytes.size());
+        }
+        return {bytes.size(), Error::None};
+    }
 
-        return tokens;
+    // The span entry points never throw: failures of the underlying codec become an error code,
+    // except that running out of memory is reported as such rather than blamed on the input.
+    template <typename Function>
+    Result guarded(Error error, Function&& function) {
+        try {
+            return function();
+        } catch (const std::bad_alloc&) {
+            return {0, Error::OutOfMemory};
+        } catch (const std::exception&) {
+            return {0, error};
+        }
     }
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
-        std::vector<std::string> dictionary(1, "");
-        std::string output;
+    // Decoded size of offset/length/next tokens, or NIL if a match reaches before the output start.
+    // Validating here once per token lets the copy loops below run without per-byte checks.
+    template <typename TokenType>
+    size_t tokensSize(const std::vector<TokenType>& tokens, size_t TokenType::*distance) {
+        size_t total = 0;
+        for (const auto& token : tokens) {
+            if (token.length >= NIL - total - 1) return NIL;
+            if (token.length > 0 && (token.*distance == 0 || token.*distance > total)) return NIL;
+            total += token.length + 1;
+        }
+        return total;
+    }
 
+    // Expands validated tokens into dst. Matches use copyMatch while WILDCOPY_SLACK bytes of room
+    // remain past them and fall back to an exact byte copy in the tail of the buffer.
+    template <typename TokenType>
+    void expandTokens(const std::vector<TokenType>& tokens, size_t TokenType::*distance, char* dst, size_t capacity) {
+        char* op = dst;
+        char* end = dst + capacity;
         for (const auto& token : tokens) {
-            std::string entry = (token.index < dictionary.size()) ? dictionary[token.index] : "";
-            entry += token.next;
-            dictionary.push_back(entry);
-            output += entry;
+            size_t length = token.length;
+            if (length > 0 && (size_t)(end - op) >= length + WILDCOPY_SLACK) {
+                copyMatch(op, token.*distance, length);
+            } else {
+                const char* match = op - token.*distance;
+                for (size_t i = 0; i < length; ++i) {
+                    op[i] = match[i];
+                }
+            }
+            op += length;
+            *op++ = token.next;
+        }
+    }
+
+    template <typename TokenType>
+    std::string expandTokens(const std::vector<TokenType>& tokens, size_t TokenType::*distance, const char* error) {
+        size_t total = tokensSize(tokens, distance);
+        if (total == NIL) {
+            throw std::runtime_error(error);
         }
 
+        std::string output(total + WILDCOPY_SLACK, '\0');
+        expandTokens(tokens, distance, &output[0], output.size());
+        output.resize(total);
         return output;
     }
 
-    namespace Utils {
-        LIBCOMPRA_API std::string serializeToken(const Token& token) {
-            return std::to_string(token.index) + "," + std::to_string(token.next);
+    // Replays offset/length/next tokens into the caller's buffer, sizing the output before writing.
+    template <typename TokenType>
+    Result replayTokens(const std::vector<TokenType>& tokens, size_t TokenType::*distance, MutableByteSpan output) {
+        size_t total = tokensSize(tokens, distance);
+        if (total == NIL) {
+            return {0, Error::InvalidInput};
+        }
+        if (total > output.size) {
+            return {total, Error::OutputTooSmall};
         }
 
-        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
-            std::string result;
-            for (const auto& token : tokens) {
-                result += serializeToken(token) + ";";
-            }
-            if (!result.empty()) {
-                result.pop_back();
-            }
-            return result;
+        expandTokens(tokens, distance, (char*)output.data, output.size);
+        return {total, Error::None};
+    }
+
+    // Token-stream wire format shared by the offset/length/next codecs: a varint count, then
+    // distance and length varints and the literal byte for each token.
+    template <typename Writer, typename TokenType>
+    inline bool writeToken(Writer& out, const TokenType& token, size_t TokenType::*distance) {
+        return out.varint(token.*distance) && out.varint(token.length) && out.byte((uint8_t)token.next);
+    }
+
+    template <typename TokenType>
+    std::string encodeTokenStream(const std::vector<TokenType>& tokens, size_t TokenType::*distance) {
+        std::string result;
+        result.reserve(tokens.size() * 4 + 4);
+        StringWriter out{result};
+        out.varint(tokens.size());
+        for (const auto& token : tokens) {
+            writeToken(out, token, distance);
         }
+        return result;
+    }
 
-        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
-            size_t firstComma = str.find(',');
-            size_t secondComma = str.find(',', firstComma + 1);
-            size_t index = std::stoull(str.substr(0, firstComma));
-            char next = str[secondComma + 1];
-            return {index, next};
+    // The same stream written by a parser straight into the caller's buffer: parse(emit) calls
+    // emit(token) for each token and stops with false as soon as emit does.
+    template <typename TokenType, typename Parse>
+    Result writeTokenStream(MutableByteSpan output, size_t TokenType::*distance, Parse&& parse) {
+        ByteWriter out(output);
+        bool fitted = writeVarintPrefixed(out, [&]() -> uint64_t {
+            size_t count = 0;
+            bool parsed = parse([&](const TokenType& token) {
+                ++count;
+                return writeToken(out, token, distance);
+            });
+            return parsed ? count : NIL;
+        });
+        return out.finish(fitted);
+    }
+
+    template <typename TokenType>
+    std::vector<TokenType> decodeTokenStream(const uint8_t* data, size_t size, size_t TokenType::*distance, const char* error) {
+        ByteReader reader(data, size, error);
+        size_t count = reader.varint();
+        if (count > reader.remaining() / 3) {
+            throw std::runtime_error(error);
         }
 
-        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
-            std::vector<Token> tokens;
-            size_t start = 0;
-            size_t end;
-            while ((end = str.find(';', start)) != std::string::npos) {
-                tokens.push_back(deserializeToken(str.substr(start, end - start)));
-                start = end + 1;
-            }
-            if (start < str.size()) {
-                tokens.push_back(deserializeToken(str.substr(start)));
-            }
-            return tokens;
+        std::vector<TokenType> tokens(count);
+        for (auto& token : tokens) {
+            token.*distance = reader.varint();
+            token.length = reader.varint();
+            token.next = (char)reader.byte();
+        }
+        if (reader.remaining() != 0) {
+            throw std::runtime_error(error);
         }
+        return tokens;
     }
-}
 
-namespace LZMA {
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t pos, size_t dictionarySize, size_t& matchPos) {
-        size_t maxLength = 0;
-        matchPos = 0;
-        
-        for (size_t i = (pos > dictionarySize ? pos - dictionarySize : 0); i < pos; ++i) {
-            size_t length = 0;
-            while (length < dictionarySize && pos + length < input.size() && input[i + length] == input[pos + length]) {
-                ++length;
-            }
-            if (length > maxLength) {
-                maxLength = length;
-                matchPos = i;
-            }
-        }
-        return maxLength;
+    // One row of a codec's level table: everything in Params but the level itself.
+    struct Preset {
+        uint32_t windowLog;
+        uint32_t hashLog;
+        uint32_t searchDepth;
+        uint32_t minMatch;
+        uint32_t niceLength;
+        Strategy strategy;
+    };
+
+    Params presetParams(const Preset (&presets)[MAX_LEVEL], int level) {
+        level = std::clamp(level, MIN_LEVEL, MAX_LEVEL);
+        const Preset& preset = presets[level - MIN_LEVEL];
+        return {level, preset.windowLog, preset.hashLog, preset.searchDepth, preset.minMatch, preset.niceLength, preset.strategy};
     }
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t dictionarySize) {
-        std::vector<Token> tokens;
+    inline size_t clampedLog(uint32_t log, uint32_t minLog, uint32_t maxLog) {
+        return size_t(1) << std::clamp(log, minLog, maxLog);
+    }
+
+    // Bytes encodeTokens spends on a match token and on the literal-only tokens deferred before it.
+    inline size_t tokenCost(size_t offset, size_t length, size_t literals) {
+        return varintLength(offset) + varintLength(length) + 1 + literals * 3;
+    }
+
+    // Offset/length/next parse over a hash chain; matches stop one byte short of the input so
+    // every token still carries its literal. The lazy strategies defer while the match one byte
+    // later codes its bytes more cheaply, the literal token it forces included. The parse stops,
+    // returning false, as soon as emit(token) does.
+    template <typename TokenType, typename Emit>
+    bool parseTokens(std::string_view input, LZ77::HashChain& chain, Strategy strategy, size_t minLength, Emit&& emit) {
         size_t inputSize = input.size();
-        size_t pos = 0;
+        size_t maxDeferred = strategy == Strategy::Greedy ? 0 : strategy == Strategy::Lazy ? 1 : 2;
+        size_t inserted = 0;
+
+        auto matchAt = [&](size_t pos, size_t& offset) {
+            for (; inserted < pos; ++inserted) {
+                chain.insert(input, inserted);
+            }
+            size_t length = chain.findLongestMatch(input, pos, inputSize - pos - 1, offset);
+            return length < minLength ? 0 : length;
+        };
 
+        size_t pos = 0;
         while (pos < inputSize) {
-            size_t matchLength = 0;
-            size_t matchPos = 0;
+            size_t matchOffset = 0;
+            size_t matchLength = matchAt(pos, matchOffset);
+
+            for (size_t deferred = 0; matchLength > 0 && deferred < maxDeferred && pos + 1 < inputSize; ++deferred) {
+                size_t nextOffset = 0;
+                size_t nextLength = matchAt(pos + 1, nextOffset);
+                if (tokenCost(nextOffset, nextLength, 1) * (matchLength + 1) >= tokenCost(matchOffset, matchLength, 0) * (nextLength + 2)) break;
 
-            matchLength = findLongestMatch(input, pos, dictionarySize, matchPos);
+                if (!emit(TokenType{0, 0, input[pos++]})) return false;
+                matchLength = nextLength;
+                matchOffset = nextOffset;
+            }
 
             if (matchLength > 0) {
-                tokens.push_back({pos - matchPos, matchLength, input[pos + matchLength]});
+                if (!emit(TokenType{matchOffset, matchLength, input[pos + matchLength]})) return false;
                 pos += matchLength + 1;
             } else {
-                tokens.push_back({0, 0, input[pos]});
+                if (!emit(TokenType{0, 0, input[pos]})) return false;
                 ++pos;
             }
         }
 
-        return tokens;
+        return true;
+    }
+
+    template <typename TokenType>
+    std::vector<TokenType> parseTokens(std::string_view input, LZ77::HashChain& chain, Strategy strategy, size_t minLength) {
+        std::vector<TokenType> tokens;
+        parseTokens<TokenType>(input, chain, strategy, minLength, [&](const TokenType& token) {
+            tokens.push_back(token);
+            return true;
+        });
+        return tokens;
+    }
+}
+
+namespace LZ77 {
+    LIBCOMPRA_API HashChain::HashChain(size_t windowSize, size_t maxChainDepth, size_t minMatch, size_t hashLog, size_t niceLength)
+        : windowSize(windowSize), maxChainDepth(maxChainDepth), minMatch(std::clamp<size_t>(minMatch, 3, 4)), hashLog(std::clamp<size_t>(hashLog, 8, 24)), niceLength(niceLength) {
+        size_t chainSize = 1;
+        while (chainSize < windowSize) {
+            chainSize <<= 1;
+        }
+        chainMask = chainSize - 1;
+        head.assign(size_t(1) << this->hashLog, NIL);
+        prev.assign(chainSize, NIL);
+    }
+
+    LIBCOMPRA_API size_t HashChain::hash(std::string_view input, size_t pos) const {
+        uint32_t value = (minMatch >= 4)
+            ? read32(input.data() + pos)
+            : (uint32_t)(unsigned char)input[pos] | ((uint32_t)(unsigned char)input[pos + 1] << 8) | ((uint32_t)(unsigned char)input[pos + 2] << 16);
+        return (value * 2654435761u) >> (32 - hashLog);
+    }
+
+    LIBCOMPRA_API void HashChain::insert(std::string_view input, size_t pos) {
+        if (pos + minMatch > input.size()) return;
+
+        size_t h = hash(input, pos);
+        prev[pos & chainMask] = head[h];
+        head[h] = pos;
+    }
+
+    LIBCOMPRA_API size_t HashChain::findLongestMatch(std::string_view input, size_t pos, size_t maxLength, size_t& bestOffset) const {
+        size_t limit = std::min(maxLength, input.size() - pos);
+        if (limit < minMatch) return 0;
+
+        const char* current = input.data() + pos;
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+        size_t candidate = head[hash(input, pos)];
+
+        for (size_t depth = maxChainDepth; candidate != NIL && depth > 0; --depth) {
+            size_t distance = pos - candidate;
+            if (candidate >= pos || distance > windowSize) break;
+
+            const char* match = input.data() + candidate;
+            if (match[bestLength] == current[bestLength]) {
+                size_t length = countMatch(match, current, limit);
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = distance;
+                    if (length == limit || length >= niceLength) break;
+                }
+            }
+            candidate = prev[candidate & chainMask];
+        }
+
+        if (bestLength < minMatch) return 0;
+
+        bestOffset = bestDistance;
+        return bestLength;
+    }
+
+    LIBCOMPRA_API void HashChain::slide(size_t delta) {
+        auto rebase = [delta](size_t& pos) {
+            pos = (pos == NIL || pos < delta) ? NIL : pos - delta;
+        };
+        std::for_each(head.begin(), head.end(), rebase);
+        std::for_each(prev.begin(), prev.end(), rebase);
+    }
+
+    LIBCOMPRA_API size_t findLongestMatch(std::string_view input, size_t i, size_t searchStart, size_t windowSize, size_t& bestOffset) {
+        size_t bestLength = 0;
+
+        for (size_t j = searchStart; j < i; ++j) {
+            size_t length = 0;
+            while (i + length < input.size() && input[j + length] == input[i + length]) {
+                ++length;
+                if (length > bestLength) {
+                    bestOffset = i - j;
+                    bestLength = length;
+                }
+            }
+        }
+        return bestLength;
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t windowSize, size_t maxChainDepth) {
+        HashChain chain(windowSize, maxChainDepth);
+        return parseTokens<Token>(input, chain, Strategy::Greedy, 0);
+    }
+
+    namespace {
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {14, 14, 4, 4, 32, Strategy::Greedy},
+            {15, 15, 8, 4, 64, Strategy::Greedy},
+            {15, 15, 16, 3, 128, Strategy::Greedy},
+            {15, 15, 16, 3, 128, Strategy::Lazy},
+            {15, 15, 32, 3, 256, Strategy::Lazy},
+            {15, 15, 64, 3, 512, Strategy::Lazy},
+            {16, 16, 128, 3, 1024, Strategy::Lazy2},
+            {17, 17, 256, 3, 4096, Strategy::Lazy2},
+            {18, 17, 1024, 3, 65536, Strategy::Lazy2}};
+
+        HashChain paramsChain(const Params& params) {
+            return HashChain(clampedLog(params.windowLog, 8, 24), std::max<uint32_t>(params.searchDepth, 1), params.minMatch, params.hashLog, std::max<uint32_t>(params.niceLength, 1));
+        }
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params) {
+        HashChain chain = paramsChain(params);
+        return parseTokens<Token>(input, chain, params.strategy, params.minMatch);
+    }
+
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
+        return expandTokens(tokens, &Token::offset, "Invalid LZ77 token stream");
+    }
+
+    namespace {
+        // Tokenizes buffer[position, end); matches stop one byte short of the buffered input so
+        // every token still carries its literal.
+        void encodeStream(Compressor& stream, size_t end, std::string& output) {
+            std::string_view buffer(stream.buffer);
+            std::vector<Token> tokens;
+
+            while (stream.position < end) {
+                for (; stream.inserted < stream.position && stream.inserted + stream.chain.minMatch <= buffer.size(); ++stream.inserted) {
+                    stream.chain.insert(buffer, stream.inserted);
+                }
+
+                size_t offset = 0;
+                size_t limit = std::min(MAX_STREAM_MATCH, buffer.size() - stream.position - 1);
+                size_t length = stream.chain.findLongestMatch(buffer, stream.position, limit, offset);
+
+                tokens.push_back({offset, length, buffer[stream.position + length]});
+                stream.position += length + 1;
+            }
+
+            if (!tokens.empty()) {
+                output += Utils::encodeTokens(tokens);
+            }
+
+            // Drop whole chain-sized spans once two lie behind the cursor, keeping at least a window of history.
+            size_t chainSize = stream.chain.chainMask + 1;
+            size_t settled = std::min(stream.position, stream.inserted);
+            if (settled >= 2 * chainSize) {
+                size_t delta = (settled / chainSize - 1) * chainSize;
+                stream.chain.slide(delta);
+                stream.buffer.erase(0, delta);
+                stream.position -= delta;
+                stream.inserted -= delta;
+            }
+        }
+    }
+
+    LIBCOMPRA_API Compressor::Compressor(size_t windowSize, size_t maxChainDepth)
+        : chain(std::max<size_t>(windowSize, 1), maxChainDepth), position(0), inserted(0), finished(false) {}
+
+    LIBCOMPRA_API void Compressor::update(const char* data, size_t size, std::string& output) {
+        if (finished) {
+            throw std::runtime_error("LZ77 stream already finished");
+        }
+
+        buffer.append(data, size);
+        if (buffer.size() > MAX_STREAM_MATCH + 1) {
+            encodeStream(*this, buffer.size() - MAX_STREAM_MATCH - 1, output);
+        }
+    }
+
+    LIBCOMPRA_API void Compressor::update(const std::string& data, std::string& output) {
+        update(data.data(), data.size(), output);
+    }
+
+    LIBCOMPRA_API void Compressor::flush(std::string& output) {
+        if (finished) {
+            throw std::runtime_error("LZ77 stream already finished");
+        }
+
+        encodeStream(*this, buffer.size(), output);
+    }
+
+    LIBCOMPRA_API void Compressor::finish(std::string& output) {
+        flush(output);
+        writeVarint(output, 0);
+        finished = true;
+    }
+
+    LIBCOMPRA_API Decompressor::Decompressor(size_t windowSize)
+        : windowSize(std::max<size_t>(windowSize, 1)), blockRemaining(0), done(false) {}
+
+    LIBCOMPRA_API bool Decompressor::update(const char* data, size_t size, std::string& output) {
+        pending.append(data, size);
+
+        const unsigned char* ip = (const unsigned char*)pending.data();
+        const unsigned char* iend = ip + pending.size();
+        size_t produced = history.size();
+
+        while (!done && ip < iend) {
+            const unsigned char* start = ip;
+
+            if (blockRemaining == 0) {
+                uint64_t count;
+                if (!readVarint(ip, iend, count)) {
+                    ip = start;
+                    break;
+                }
+                blockRemaining = count;
+                done = count == 0;
+                continue;
+            }
+
+            // A token split across updates is left in pending and decoded once it is complete.
+            uint64_t offset;
+            uint64_t length;
+            if (!readVarint(ip, iend, offset) || !readVarint(ip, iend, length) || ip >= iend) {
+                ip = start;
+                break;
+            }
+            if (length > MAX_STREAM_MATCH || (length > 0 && (offset == 0 || offset > windowSize || offset > history.size()))) {
+                throw std::runtime_error("Invalid LZ77 token stream");
+            }
+
+            size_t end = history.size() + length;
+            if (length > 0) {
+                history.resize(end + WILDCOPY_SLACK);
+                copyMatch(&history[end - length], offset, length);
+            }
+            history.resize(end);
+            history += (char)*ip++;
+            --blockRemaining;
+
+            // Hand decoded bytes over as the history grows, so a large chunk is not held twice.
+            if (history.size() > 2 * windowSize) {
+                output.append(history, produced, std::string::npos);
+                history.erase(0, history.size() - windowSize);
+                produced = history.size();
+            }
+        }
+
+        if (done && ip != iend) {
+            throw std::runtime_error("Trailing data after LZ77 stream");
+        }
+        pending.erase(0, ip - (const unsigned char*)pending.data());
+
+        output.append(history, produced, std::string::npos);
+        return done;
+    }
+
+    LIBCOMPRA_API bool Decompressor::update(const std::string& data, std::string& output) {
+        return update(data.data(), data.size(), output);
+    }
+
+    LIBCOMPRA_API bool Decompressor::finished() const {
+        return done;
+    }
+
+    namespace Utils {
+        LIBCOMPRA_API std::string serializeToken(const Token& token) {
+            return std::to_string(token.offset) + "," + std::to_string(token.length) + "," + token.next;
+        }
+
+        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
+            std::string result;
+            for (const auto& token : tokens) {
+                result += serializeToken(token) + ";";
+            }
+            if (!result.empty()) {
+                result.pop_back();
+            }
+            return result;
+        }
+
+        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
+            size_t firstComma = str.find(',');
+            size_t secondComma = str.find(',', firstComma + 1);
+            size_t offset = std::stoull(str.substr(0, firstComma));
+            size_t length = std::stoull(str.substr(firstComma + 1, secondComma - firstComma - 1));
+            char next = str[secondComma + 1];
+            return {offset, length, next};
+        }
+
+        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
+            std::vector<Token> tokens;
+            size_t start = 0;
+            size_t end;
+            while ((end = str.find(';', start)) != std::string::npos) {
+                tokens.push_back(deserializeToken(str.substr(start, end - start)));
+                start = end + 1;
+            }
+            if (start < str.size()) {
+                tokens.push_back(deserializeToken(str.substr(start)));
+            }
+            return tokens;
+        }
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens) {
+            return encodeTokenStream(tokens, &Token::offset);
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size) {
+            return decodeTokenStream(data, size, &Token::offset, "Invalid LZ77 token stream");
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded) {
+            return decodeTokens((const uint8_t*)encoded.data(), encoded.size());
+        }
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        // A literal token costs three bytes; a match token never costs more than the bytes it covers.
+        return inputSize * 3 + 10;
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&] {
+            // The window and chain depth compress(std::string_view) defaults to.
+            HashChain chain(32 * 1024, 64);
+            return writeTokenStream(output, &Token::offset, [&](auto&& emit) {
+                return parseTokens<Token>(asView(input), chain, Strategy::Greedy, 0, emit);
+            });
+        });
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        return guarded(Error::InputTooLarge, [&] {
+            HashChain chain = paramsChain(params);
+            return writeTokenStream(output, &Token::offset, [&](auto&& emit) {
+                return parseTokens<Token>(asView(input), chain, params.strategy, params.minMatch, emit);
+            });
+        });
+    }
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&] {
+            return replayTokens(Utils::decodeTokens(input.data, input.size), &Token::offset, output);
+        });
+    }
+}
+
+namespace LZ78 {
+    LIBCOMPRA_API size_t findPrefixIndex(const std::map<std::string, size_t>& dictionary, const std::string& buffer) {
+        if (buffer.size() > 1) {
+            auto prefix = dictionary.find(buffer.substr(0, buffer.size() - 1));
+            if (prefix != dictionary.end()) {
+                return prefix->second;
+            }
+        }
+        return 0;
+    }
+
+    namespace {
+        constexpr uint32_t MIN_DICTIONARY_LOG = 8;
+        constexpr uint32_t MAX_DICTIONARY_LOG = 24;
+        constexpr size_t MAX_DICTIONARY_SIZE = size_t(1) << MAX_DICTIONARY_LOG;
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {12, 0, 0, 0, 0, Strategy::Greedy},
+            {13, 0, 0, 0, 0, Strategy::Greedy},
+            {14, 0, 0, 0, 0, Strategy::Greedy},
+            {14, 0, 0, 0, 0, Strategy::Greedy},
+            {16, 0, 0, 0, 0, Strategy::Greedy},
+            {16, 0, 0, 0, 0, Strategy::Greedy},
+            {18, 0, 0, 0, 0, Strategy::Greedy},
+            {20, 0, 0, 0, 0, Strategy::Greedy},
+            {22, 0, 0, 0, 0, Strategy::Greedy}};
+
+        inline uint32_t dictionaryLog(const Params& params) {
+            return std::clamp(params.windowLog, MIN_DICTIONARY_LOG, MAX_DICTIONARY_LOG);
+        }
+
+        inline size_t dictionarySize(const Params& params) {
+            return size_t(1) << dictionaryLog(params);
+        }
+        constexpr uint32_t EMPTY_SLOT = 0;
+
+        void checkDictionarySize(size_t maxDictionarySize) {
+            if (maxDictionarySize == 0 || maxDictionarySize > MAX_DICTIONARY_SIZE) {
+                throw std::runtime_error("LZ78 dictionary size must be between 1 and 2^24 entries");
+            }
+        }
+
+        inline uint32_t slotOf(uint32_t key, uint32_t hashLog) {
+            return (key * 2654435761u) >> (32 - hashLog);
+        }
+
+        // Entry lengths replayed in the decoder's lockstep; returns the decoded size and throws
+        // on an index that does not exist yet.
+        size_t decodedSize(const std::vector<Token>& tokens, size_t maxDictionarySize, std::vector<uint32_t>& lengths) {
+            lengths.assign(1, 0);
+            size_t total = 0;
+            for (const auto& token : tokens) {
+                if (token.index >= lengths.size()) {
+                    throw std::runtime_error("Invalid LZ78 token stream");
+                }
+                lengths.push_back(lengths[token.index] + 1);
+                total += lengths.back();
+                if (lengths.size() > maxDictionarySize) {
+                    lengths.resize(1);
+                }
+            }
+            return total;
+        }
+
+        // Entries are stored as (parent index, byte) and unwound back to front into dst, which
+        // holds the size decodedSize returned. lengths is decodedSize's, reused for the lockstep.
+        void unwindTokens(const std::vector<Token>& tokens, size_t maxDictionarySize, std::vector<uint32_t>& lengths, char* dst) {
+            std::vector<uint32_t> parents(1, 0);
+            std::vector<char> bytes(1, '\0');
+            lengths.assign(1, 0);
+            size_t op = 0;
+
+            for (const auto& token : tokens) {
+                size_t length = lengths[token.index] + 1;
+                op += length;
+                dst[op - 1] = token.next;
+                for (size_t pos = op - 1, entry = token.index; entry != 0; entry = parents[entry]) {
+                    dst[--pos] = bytes[entry];
+                }
+
+                parents.push_back((uint32_t)token.index);
+                bytes.push_back(token.next);
+                lengths.push_back((uint32_t)length);
+                if (parents.size() > maxDictionarySize) {
+                    parents.resize(1);
+                    bytes.resize(1);
+                    lengths.resize(1);
+                }
+            }
+        }
+    }
+
+    LIBCOMPRA_API Trie::Trie(size_t maxEntries) : maxEntries(maxEntries), nextIndex(1), hashLog(4) {
+        checkDictionarySize(maxEntries);
+        while ((size_t(1) << hashLog) < 2 * maxEntries) {
+            ++hashLog;
+        }
+        keys.assign(size_t(1) << hashLog, 0);
+        children.assign(size_t(1) << hashLog, EMPTY_SLOT);
+    }
+
+    LIBCOMPRA_API size_t Trie::child(size_t parent, uint8_t byte) const {
+        uint32_t key = (uint32_t)(parent << 8) | byte;
+        uint32_t mask = (uint32_t(1) << hashLog) - 1;
+        for (uint32_t slot = slotOf(key, hashLog); children[slot] != EMPTY_SLOT; slot = (slot + 1) & mask) {
+            if (keys[slot] == key) {
+                return children[slot];
+            }
+        }
+        return 0;
+    }
+
+    LIBCOMPRA_API void Trie::add(size_t parent, uint8_t byte) {
+        uint32_t key = (uint32_t)(parent << 8) | byte;
+        uint32_t mask = (uint32_t(1) << hashLog) - 1;
+        uint32_t slot = slotOf(key, hashLog);
+        while (children[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        keys[slot] = key;
+        children[slot] = (uint32_t)nextIndex++;
+
+        if (nextIndex > maxEntries) {
+            reset();
+        }
+    }
+
+    LIBCOMPRA_API void Trie::reset() {
+        std::fill(children.begin(), children.end(), EMPTY_SLOT);
+        nextIndex = 1;
+    }
+
+    namespace {
+        // Emits each token as the trie walk ends it; stops with false as soon as emit does.
+        template <typename Emit>
+        bool parse(std::string_view input, size_t maxDictionarySize, Emit&& emit) {
+            checkDictionarySize(maxDictionarySize);
+            // A dictionary larger than the input can never fill, so size the table to what can be used.
+            Trie trie(std::min(maxDictionarySize, input.size() + 1));
+            size_t node = 0;
+            size_t parent = 0;
+
+            for (char c : input) {
+                size_t next = trie.child(node, (uint8_t)c);
+                if (next != 0) {
+                    parent = node;
+                    node = next;
+                    continue;
+                }
+
+                if (!emit(Token{node, c})) return false;
+                trie.add(node, (uint8_t)c);
+                node = 0;
+            }
+
+            // The input ended inside an existing entry: send its prefix and last byte.
+            return node == 0 || emit(Token{parent, input.back()});
+        }
+
+        template <typename Writer>
+        inline bool writeToken(Writer& out, const Token& token) {
+            return out.varint(token.index) && out.byte((uint8_t)token.next);
+        }
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t maxDictionarySize) {
+        std::vector<Token> tokens;
+        parse(input, maxDictionarySize, [&](const Token& token) {
+            tokens.push_back(token);
+            return true;
+        });
+        return tokens;
+    }
+
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens, size_t maxDictionarySize) {
+        checkDictionarySize(maxDictionarySize);
+        std::vector<uint32_t> lengths;
+        std::string output(decodedSize(tokens, maxDictionarySize, lengths), '\0');
+        unwindTokens(tokens, maxDictionarySize, lengths, &output[0]);
+        return output;
+    }
+
+    namespace Utils {
+        LIBCOMPRA_API std::string serializeToken(const Token& token) {
+            return std::to_string(token.index) + "," + std::to_string(token.next);
+        }
+
+        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
+            std::string result;
+            for (const auto& token : tokens) {
+                result += serializeToken(token) + ";";
+            }
+            if (!result.empty()) {
+                result.pop_back();
+            }
+            return result;
+        }
+
+        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
+            size_t firstComma = str.find(',');
+            size_t secondComma = str.find(',', firstComma + 1);
+            size_t index = std::stoull(str.substr(0, firstComma));
+            char next = str[secondComma + 1];
+            return {index, next};
+        }
+
+        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
+            std::vector<Token> tokens;
+            size_t start = 0;
+            size_t end;
+            while ((end = str.find(';', start)) != std::string::npos) {
+                tokens.push_back(deserializeToken(str.substr(start, end - start)));
+                start = end + 1;
+            }
+            if (start < str.size()) {
+                tokens.push_back(deserializeToken(str.substr(start)));
+            }
+            return tokens;
+        }
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens) {
+            std::string result;
+            result.reserve(tokens.size() * 3 + 4);
+            StringWriter out{result};
+            out.varint(tokens.size());
+            for (const auto& token : tokens) {
+                writeToken(out, token);
+            }
+            return result;
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size) {
+            ByteReader reader(data, size, "Invalid LZ78 token stream");
+            size_t count = reader.varint();
+            if (count > reader.remaining() / 2) {
+                throw std::runtime_error("Invalid LZ78 token stream");
+            }
+
+            std::vector<Token> tokens(count);
+            for (auto& token : tokens) {
+                token.index = reader.varint();
+                token.next = (char)reader.byte();
+            }
+            if (reader.remaining() != 0) {
+                throw std::runtime_error("Invalid LZ78 token stream");
+            }
+            return tokens;
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded) {
+            return decodeTokens((const uint8_t*)encoded.data(), encoded.size());
+        }
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params) {
+        return compress(input, dictionarySize(params));
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        return inputSize * (1 + varintLength(inputSize)) + 11;
+    }
+
+    // The span form leads with the log2 of the dictionary size the decoder must mirror.
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return compress(input, output, preset(DEFAULT_LEVEL));
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        return guarded(Error::InputTooLarge, [&] {
+            ByteWriter out(output);
+            bool fitted = out.byte((uint8_t)dictionaryLog(params)) && writeVarintPrefixed(out, [&]() -> uint64_t {
+                size_t count = 0;
+                bool parsed = parse(asView(input), dictionarySize(params), [&](const Token& token) {
+                    ++count;
+                    return writeToken(out, token);
+                });
+                return parsed ? count : NIL;
+            });
+            return out.finish(fitted);
+        });
+    }
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&]() -> Result {
+            if (input.size == 0 || input.data[0] < MIN_DICTIONARY_LOG || input.data[0] > MAX_DICTIONARY_LOG) {
+                return {0, Error::InvalidInput};
+            }
+            size_t maxDictionarySize = size_t(1) << input.data[0];
+            std::vector<Token> tokens = Utils::decodeTokens(input.data + 1, input.size - 1);
+            std::vector<uint32_t> lengths;
+            size_t total = decodedSize(tokens, maxDictionarySize, lengths);
+            if (total > output.size) {
+                return {total, Error::OutputTooSmall};
+            }
+            unwindTokens(tokens, maxDictionarySize, lengths, (char*)output.data);
+            return Result{total, Error::None};
+        });
+    }
+}
+
+namespace LZMA {
+    namespace {
+        constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+        constexpr size_t MAX_MATCH_LENGTH = 273;
+
+        size_t treeWalk(BinaryTree& tree, const char* data, size_t pos, uint32_t curMatch, size_t lenLimit, size_t bestLength, std::vector<Match>* matches) {
+            size_t cyclicPos = pos % tree.cyclicSize;
+            uint32_t* ptr0 = &tree.son[2 * cyclicPos + 1];
+            uint32_t* ptr1 = &tree.son[2 * cyclicPos];
+            size_t len0 = 0, len1 = 0;
+            const char* current = data + pos;
+
+            for (size_t depth = tree.cutValue; ; --depth) {
+                size_t delta = pos - curMatch;
+                if (curMatch == EMPTY || depth == 0 || delta >= tree.cyclicSize) {
+                    *ptr0 = *ptr1 = EMPTY;
+                    return bestLength;
+                }
+
+                size_t pairPos = (cyclicPos >= delta) ? cyclicPos - delta : cyclicPos - delta + tree.cyclicSize;
+                uint32_t* pair = &tree.son[2 * pairPos];
+                const char* match = data + curMatch;
+                size_t length = std::min(len0, len1);
+                length += countMatch(match + length, current + length, lenLimit - length);
+
+                if (matches && length > bestLength) {
+                    bestLength = length;
+                    matches->push_back({length, delta});
+                }
+
+                if (length == lenLimit) {
+                    *ptr1 = pair[0];
+                    *ptr0 = pair[1];
+                    return bestLength;
+                }
+
+                if ((unsigned char)match[length] < (unsigned char)current[length]) {
+                    *ptr1 = curMatch;
+                    ptr1 = pair + 1;
+                    curMatch = *ptr1;
+                    len1 = length;
+                } else {
+                    *ptr0 = curMatch;
+                    ptr0 = pair;
+                    curMatch = *ptr0;
+                    len0 = length;
+                }
+            }
+        }
+    }
+
+    LIBCOMPRA_API BinaryTree::BinaryTree(size_t dictionarySize, size_t niceLength, size_t cutValue, size_t hashLog)
+        : dictionarySize(dictionarySize), niceLength(std::clamp<size_t>(niceLength, 4, MAX_MATCH_LENGTH)), cutValue(std::max<size_t>(cutValue, 1)),
+          hashLog(std::clamp<size_t>(hashLog, 10, 24)), cyclicSize(dictionarySize + 1) {
+        head3.assign(size_t(1) << 16, EMPTY);
+        head4.assign(size_t(1) << this->hashLog, EMPTY);
+        son.assign(2 * cyclicSize, EMPTY);
+    }
+
+    LIBCOMPRA_API size_t BinaryTree::getMatches(std::string_view input, size_t pos, std::vector<Match>& matches) {
+        matches.clear();
+
+        size_t lenLimit = std::min(niceLength, input.size() - pos);
+        if (lenLimit < 4) return 0;
+
+        const char* data = input.data();
+        uint32_t value = read32(data + pos);
+        size_t h3 = ((value & 0xFFFFFF) * 2654435761u) >> 16;
+        size_t h4 = (value * 2654435761u) >> (32 - hashLog);
+        uint32_t match3 = head3[h3];
+        uint32_t match4 = head4[h4];
+        head3[h3] = (uint32_t)pos;
+        head4[h4] = (uint32_t)pos;
+
+        size_t bestLength = 3;
+        if (match3 != EMPTY && pos - match3 < cyclicSize && std::memcmp(data + match3, data + pos, 3) == 0) {
+            size_t length = 3 + countMatch(data + match3 + 3, data + pos + 3, lenLimit - 3);
+            matches.push_back({length, pos - match3});
+            if (length == lenLimit) {
+                treeWalk(*this, data, pos, match4, lenLimit, length, nullptr);
+                return matches.size();
+            }
+            bestLength = length;
+        }
+
+        treeWalk(*this, data, pos, match4, lenLimit, bestLength, &matches);
+        return matches.size();
+    }
+
+    LIBCOMPRA_API void BinaryTree::skip(std::string_view input, size_t pos) {
+        size_t lenLimit = std::min(niceLength, input.size() - pos);
+        if (lenLimit < 4) return;
+
+        const char* data = input.data();
+        uint32_t value = read32(data + pos);
+        size_t h3 = ((value & 0xFFFFFF) * 2654435761u) >> 16;
+        size_t h4 = (value * 2654435761u) >> (32 - hashLog);
+        uint32_t match4 = head4[h4];
+        head3[h3] = (uint32_t)pos;
+        head4[h4] = (uint32_t)pos;
+
+        treeWalk(*this, data, pos, match4, lenLimit, 0, nullptr);
+    }
+
+    LIBCOMPRA_API size_t findLongestMatch(std::string_view input, size_t pos, size_t dictionarySize, size_t& matchPos) {
+        size_t maxLength = 0;
+        matchPos = 0;
+        
+        for (size_t i = (pos > dictionarySize ? pos - dictionarySize : 0); i < pos; ++i) {
+            size_t length = 0;
+            while (length < dictionarySize && pos + length < input.size() && input[i + length] == input[pos + length]) {
+                ++length;
+            }
+            if (length > maxLength) {
+                maxLength = length;
+                matchPos = i;
+            }
+        }
+        return maxLength;
+    }
+
+    namespace {
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {16, 14, 4, 4, 16, Strategy::Greedy},
+            {18, 16, 8, 3, 24, Strategy::Greedy},
+            {20, 18, 16, 3, 32, Strategy::Greedy},
+            {21, 18, 24, 3, 48, Strategy::Greedy},
+            {22, 20, 32, 3, 64, Strategy::Greedy},
+            {23, 20, 48, 3, 64, Strategy::Greedy},
+            {23, 20, 64, 3, 96, Strategy::Greedy},
+            {24, 20, 96, 3, 128, Strategy::Greedy},
+            {24, 20, 160, 3, 273, Strategy::Greedy}};
+
+        void checkInputSize(std::string_view input) {
+            if (input.size() >= EMPTY) {
+                throw std::runtime_error("LZMA input exceeds 4 GiB");
+            }
+        }
+
+        inline size_t treeWindow(size_t dictionarySize, size_t inputSize) {
+            return std::max<size_t>(1, std::min(dictionarySize, inputSize));
+        }
+
+        // Stops with false as soon as emit(token) does.
+        template <typename Emit>
+        bool parse(std::string_view input, BinaryTree& tree, size_t minLength, Emit&& emit) {
+            size_t inputSize = input.size();
+            std::vector<Match> matches;
+            size_t pos = 0;
+
+            while (pos < inputSize) {
+                if (tree.getMatches(input, pos, matches) > 0 && matches.back().length >= minLength) {
+                    size_t matchLength = matches.back().length;
+                    size_t distance = matches.back().distance;
+                    size_t limit = std::min(MAX_MATCH_LENGTH, inputSize - pos - 1);
+                    if (matchLength == tree.niceLength && matchLength < limit) {
+                        matchLength += countMatch(input.data() + pos - distance + matchLength, input.data() + pos + matchLength, limit - matchLength);
+                    }
+                    matchLength = std::min(matchLength, limit);
+                    if (matchLength == 0) {
+                        distance = 0;
+                    }
+
+                    for (size_t p = pos + 1; p <= pos + matchLength && p < inputSize; ++p) {
+                        tree.skip(input, p);
+                    }
+
+                    if (!emit(Token{distance, matchLength, input[pos + matchLength]})) return false;
+                    pos += matchLength + 1;
+                } else {
+                    if (!emit(Token{0, 0, input[pos]})) return false;
+                    ++pos;
+                }
+            }
+
+            return true;
+        }
+
+        std::vector<Token> parse(std::string_view input, BinaryTree& tree, size_t minLength) {
+            std::vector<Token> tokens;
+            parse(input, tree, minLength, [&](const Token& token) {
+                tokens.push_back(token);
+                return true;
+            });
+            return tokens;
+        }
+
+        BinaryTree defaultTree(std::string_view input, size_t dictionarySize, size_t niceLength) {
+            checkInputSize(input);
+
+            size_t window = treeWindow(dictionarySize, input.size());
+            size_t hashLog = 10;
+            while (hashLog < 20 && (size_t(1) << hashLog) < window) {
+                ++hashLog;
+            }
+            return BinaryTree(window, niceLength, 16 + niceLength / 2, hashLog);
+        }
+
+        BinaryTree paramsTree(std::string_view input, const Params& params) {
+            checkInputSize(input);
+            return BinaryTree(treeWindow(clampedLog(params.windowLog, 12, 30), input.size()), params.niceLength, params.searchDepth, params.hashLog);
+        }
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t dictionarySize, size_t niceLength) {
+        BinaryTree tree = defaultTree(input, dictionarySize, niceLength);
+        return parse(input, tree, 0);
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params) {
+        BinaryTree tree = paramsTree(input, params);
+        return parse(input, tree, params.minMatch);
+    }
+
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens, size_t dictionarySize) {
+        return expandTokens(tokens, &Token::position, "Invalid LZMA token stream");
+    }
+
+    namespace Utils {
+        LIBCOMPRA_API std::string serializeToken(const Token& token) {
+            return std::to_string(token.position) + "," + std::to_string(token.length) + "," + token.next;
+        }
+
+        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
+            std::string result;
+            for (const auto& token : tokens) {
+                result += serializeToken(token) + ";";
+            }
+            if (!result.empty()) {
+                result.pop_back();
+            }
+            return result;
+        }
+
+        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
+            size_t firstComma = str.find(',');
+            size_t secondComma = str.find(',', firstComma + 1);
+            size_t thirdComma = str.find(',', secondComma + 1);
+            
+            size_t position = std::stoull(str.substr(0, firstComma));
+            size_t length = std::stoull(str.substr(firstComma + 1, secondComma - firstComma - 1));
+            char next = str[thirdComma + 1];
+            
+            return {position, length, next};
+        }
+
+        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
+            std::vector<Token> tokens;
+            size_t start = 0;
+            size_t end;
+            
+            while ((end = str.find(';', start)) != std::string::npos) {
+                tokens.push_back(deserializeToken(str.substr(start, end - start)));
+                start = end + 1;
+            }
+            
+            if (start < str.size()) {
+                tokens.push_back(deserializeToken(str.substr(start)));
+            }
+            
+            return tokens;
+        }
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens) {
+            return encodeTokenStream(tokens, &Token::position);
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size) {
+            return decodeTokenStream(data, size, &Token::position, "Invalid LZMA token stream");
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded) {
+            return decodeTokens((const uint8_t*)encoded.data(), encoded.size());
+        }
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        return inputSize * 3 + 10;
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&] {
+            // The dictionary and nice length compress(std::string_view) defaults to.
+            BinaryTree tree = defaultTree(asView(input), 8 * 1024 * 1024, 64);
+            return writeTokenStream(output, &Token::position, [&](auto&& emit) {
+                return parse(asView(input), tree, 0, emit);
+            });
+        });
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        return guarded(Error::InputTooLarge, [&] {
+            BinaryTree tree = paramsTree(asView(input), params);
+            return writeTokenStream(output, &Token::position, [&](auto&& emit) {
+                return parse(asView(input), tree, params.minMatch, emit);
+            });
+        });
+    }
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&] {
+            return replayTokens(Utils::decodeTokens(input.data, input.size), &Token::position, output);
+        });
+    }
+}
+
+namespace Huffman {
+    LIBCOMPRA_API HuffmanNode::HuffmanNode(char data, int freq) {
+        this->data = data;
+        this->freq = freq;
+        left = right = nullptr;
+    }
+
+    LIBCOMPRA_API bool HuffmanCompare::operator()(HuffmanNode* left, HuffmanNode* right) {
+        return left->freq > right->freq;
+    }
+
+    namespace {
+        struct PendingCode {
+            uint32_t symbol;
+            uint64_t value;
+            uint32_t length;
+        };
+
+        constexpr size_t MAX_CODE_LENGTH = 32;
+
+        constexpr size_t MAX_SYMBOLS = 256;
+        constexpr size_t MAX_NODES = 2 * MAX_SYMBOLS;
+
+        // Moffat-Katajainen in-place code lengths over a node array sorted by ascending weight.
+        // On return weights[i] holds the depth of the i-th lightest symbol.
+        void computeDepths(uint64_t* weights, size_t n) {
+            if (n == 1) {
+                weights[0] = 1;
+                return;
+            }
+
+            size_t root = 0, leaf = 2;
+            weights[0] += weights[1];
+            for (size_t next = 1; next < n - 1; ++next) {
+                if (leaf >= n || weights[root] < weights[leaf]) {
+                    weights[next] = weights[root];
+                    weights[root++] = next;
+                } else {
+                    weights[next] = weights[leaf++];
+                }
+
+                if (leaf >= n || (root < next && weights[root] < weights[leaf])) {
+                    weights[next] += weights[root];
+                    weights[root++] = next;
+                } else {
+                    weights[next] += weights[leaf++];
+                }
+            }
+
+            weights[n - 2] = 0;
+            for (size_t next = n - 2; next-- > 0;) {
+                weights[next] = weights[weights[next]] + 1;
+            }
+
+            int64_t available = 1, used = 0, depth = 0;
+            int64_t internal = (int64_t)n - 2, next = (int64_t)n - 1;
+            while (available > 0) {
+                for (; internal >= 0 && (int64_t)weights[internal] == depth; --internal) {
+                    ++used;
+                }
+                for (; available > used; --available) {
+                    weights[next--] = depth;
+                }
+                available = 2 * used;
+                ++depth;
+                used = 0;
+            }
+        }
+
+        // Computes length-limited code lengths without touching the heap: symbols are sorted by
+        // weight in a fixed node array, depths come from computeDepths, and when the longest code
+        // exceeds maxCodeLength the per-length counts are rebalanced until the Kraft sum fits.
+        void computeCodeLengths(const uint64_t* frequencies, size_t symbolCount, uint8_t* lengths, size_t maxCodeLength) {
+            if (symbolCount > MAX_NODES) {
+                throw std::invalid_argument("Huffman alphabet too large");
+            }
+
+            std::array<uint16_t, MAX_NODES> order;
+            std::array<uint64_t, MAX_NODES> weights;
+            size_t n = 0;
+
+            for (size_t symbol = 0; symbol < symbolCount; ++symbol) {
+                lengths[symbol] = 0;
+                if (frequencies[symbol] > 0) {
+                    order[n++] = (uint16_t)symbol;
+                }
+            }
+            if (n == 0) return;
+
+            std::sort(order.begin(), order.begin() + n, [&](uint16_t a, uint16_t b) {
+                return frequencies[a] != frequencies[b] ? frequencies[a] < frequencies[b] : a < b;
+            });
+            for (size_t i = 0; i < n; ++i) {
+                weights[i] = frequencies[order[i]];
+            }
+
+            computeDepths(weights.data(), n);
+
+            size_t minLength = 1;
+            while ((size_t(1) << minLength) < n) {
+                ++minLength;
+            }
+            maxCodeLength = std::clamp(maxCodeLength, minLength, MAX_CODE_LENGTH);
+
+            if (weights[0] > maxCodeLength) {
+                std::array<uint64_t, MAX_CODE_LENGTH + 1> lengthCount{};
+                for (size_t i = 0; i < n; ++i) {
+                    ++lengthCount[std::min<size_t>(weights[i], maxCodeLength)];
+                }
+
+                uint64_t total = 0;
+                for (size_t bits = 1; bits <= maxCodeLength; ++bits) {
+                    total += lengthCount[bits] << (maxCodeLength - bits);
+                }
+
+                for (; total > (uint64_t(1) << maxCodeLength); --total) {
+                    --lengthCount[maxCodeLength];
+                    for (size_t bits = maxCodeLength - 1; bits > 0; --bits) {
+                        if (lengthCount[bits]) {
+                            --lengthCount[bits];
+                            lengthCount[bits + 1] += 2;
+                            break;
+                        }
+                    }
+                }
+
+                size_t next = n;
+                for (size_t bits = 1; bits <= maxCodeLength; ++bits) {
+                    for (uint64_t i = 0; i < lengthCount[bits]; ++i) {
+                        weights[--next] = bits;
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                lengths[order[i]] = (uint8_t)weights[i];
+            }
+        }
+
+        void assignCanonicalCodes(const uint8_t* lengths, size_t symbolCount, Code* codes) {
+            std::array<uint32_t, MAX_CODE_LENGTH + 1> lengthCount{};
+            for (size_t symbol = 0; symbol < symbolCount; ++symbol) {
+                if (lengths[symbol] > MAX_CODE_LENGTH) {
+                    throw std::runtime_error("Invalid Huffman code lengths");
+                }
+                ++lengthCount[lengths[symbol]];
+            }
+            lengthCount[0] = 0;
+
+            std::array<uint64_t, MAX_CODE_LENGTH + 1> nextCode{};
+            uint64_t code = 0;
+            int64_t left = 1;
+            for (size_t bits = 1; bits <= MAX_CODE_LENGTH; ++bits) {
+                code = (code + lengthCount[bits - 1]) << 1;
+                nextCode[bits] = code;
+
+                left = (left << 1) - lengthCount[bits];
+                if (left < 0) {
+                    throw std::runtime_error("Invalid Huffman code lengths");
+                }
+            }
+
+            for (size_t symbol = 0; symbol < symbolCount; ++symbol) {
+                codes[symbol] = (lengths[symbol] > 0) ? Code{nextCode[lengths[symbol]]++, lengths[symbol]} : Code{0, 0};
+            }
+        }
+
+        void fillDecodeTable(DecodeTable& table, size_t base, size_t bits, const std::vector<PendingCode>& codes) {
+            std::map<uint64_t, std::vector<PendingCode>> longCodes;
+
+            for (const auto& code : codes) {
+                if (code.length <= bits) {
+                    size_t first = (size_t)(code.value << (bits - code.length));
+                    size_t count = size_t(1) << (bits - code.length);
+                    for (size_t i = 0; i < count; ++i) {
+                        table.entries[base + first + i] = {code.symbol, (uint8_t)code.length, 0};
+                    }
+                } else {
+                    uint32_t rest = code.length - (uint32_t)bits;
+                    longCodes[code.value >> rest].push_back({code.symbol, code.value & ((uint64_t(1) << rest) - 1), rest});
+                }
+            }
+
+            for (const auto& [prefix, group] : longCodes) {
+                uint32_t maxLength = 0;
+                for (const auto& code : group) {
+                    maxLength = std::max(maxLength, code.length);
+                }
+
+                size_t subBits = std::min<size_t>(maxLength, table.rootBits);
+                size_t subBase = table.entries.size();
+                table.entries.resize(subBase + (size_t(1) << subBits), {0, 0, 0});
+                table.entries[base + prefix] = {(uint32_t)subBase, 0, (uint8_t)subBits};
+                fillDecodeTable(table, subBase, subBits, group);
+            }
+        }
+
+        // Calls emit(symbol) for each code in the first bitLength bits of data.
+        template <typename Emit>
+        void decodeSymbols(const uint8_t* data, size_t size, size_t bitLength, const DecodeTable& table, Emit&& emit) {
+            BitIO::BitReader reader(data, size);
+
+            while (reader.consumedBits() < bitLength) {
+                reader.refill();
+
+                size_t base = 0;
+                size_t bits = table.rootBits;
+                while (true) {
+                    const DecodeEntry& entry = table.entries[base + (size_t)reader.peek(bits)];
+                    if (entry.subBits) {
+                        reader.consume(bits);
+                        base = entry.value;
+                        bits = entry.subBits;
+                        continue;
+                    }
+                    if (entry.length == 0) {
+                        throw std::runtime_error("Invalid Huffman input");
+                    }
+                    reader.consume(entry.length);
+                    emit((char)entry.value);
+                    break;
+                }
+            }
+
+            if (reader.consumedBits() != bitLength) {
+                throw std::runtime_error("Invalid Huffman input");
+            }
+        }
+    }
+
+    namespace Methods {
+        LIBCOMPRA_API HuffmanNode* BuildHuffmanTree(const Huffman::FreqMap& freqMap) {
+            std::priority_queue<HuffmanNode*, std::vector<HuffmanNode*>, HuffmanCompare> pq;
+
+            for (const auto& pair : freqMap) {
+                pq.push(new HuffmanNode(pair.first, pair.second));
+            }
+
+            if (pq.empty()) return nullptr;
+
+            while (pq.size() != 1) {
+                HuffmanNode *left = pq.top(); pq.pop();
+                HuffmanNode *right = pq.top(); pq.pop();
+
+                int sum = left->freq + right->freq;
+                HuffmanNode* node = new HuffmanNode('\0', sum);
+                node->left = left;
+                node->right = right;
+                pq.push(node);
+            }
+
+            return pq.top();
+        }
+
+        LIBCOMPRA_API void GenerateCodes(HuffmanNode* node, const std::string& code, std::map<char, std::string>& huffmanCode) {
+            if (!node) return;
+
+            if (!node->left && !node->right) {
+                huffmanCode[node->data] = code.empty() ? "0" : code;
+            }
+
+            GenerateCodes(node->left, code + '0', huffmanCode);
+            GenerateCodes(node->right, code + '1', huffmanCode);
+        }
+
+        LIBCOMPRA_API void FreeTree(HuffmanNode* node) {
+            if (node == nullptr) return;
+            FreeTree(node->left);
+            FreeTree(node->right);
+            delete node;
+        }
+
+        LIBCOMPRA_API CodeTable BuildCodeTable(const std::map<char, std::string>& huffmanCode) {
+            CodeTable codes{};
+
+            for (const auto& [ch, bits] : huffmanCode) {
+                Code code{0, (uint32_t)bits.size()};
+                for (char bit : bits) {
+                    code.value = (code.value << 1) | (bit == '1' ? 1 : 0);
+                }
+                codes[(unsigned char)ch] = code;
+            }
+
+            return codes;
+        }
+
+        LIBCOMPRA_API std::vector<uint8_t> BuildCodeLengths(const std::vector<uint64_t>& frequencies, size_t maxCodeLength) {
+            std::vector<uint8_t> lengths(frequencies.size(), 0);
+            computeCodeLengths(frequencies.data(), frequencies.size(), lengths.data(), maxCodeLength);
+            return lengths;
+        }
+
+        LIBCOMPRA_API CodeLengths BuildCodeLengths(const FreqMap& freqMap, size_t maxCodeLength) {
+            std::array<uint64_t, 256> frequencies{};
+            for (const auto& [ch, freq] : freqMap) {
+                frequencies[(unsigned char)ch] = (uint64_t)std::max(freq, 0);
+            }
+
+            CodeLengths codeLengths;
+            computeCodeLengths(frequencies.data(), frequencies.size(), codeLengths.data(), maxCodeLength);
+            return codeLengths;
+        }
+
+        LIBCOMPRA_API std::vector<Code> BuildCanonicalCodes(const std::vector<uint8_t>& lengths) {
+            std::vector<Code> codes(lengths.size());
+            assignCanonicalCodes(lengths.data(), lengths.size(), codes.data());
+            return codes;
+        }
+
+        LIBCOMPRA_API CodeTable BuildCanonicalCodes(const CodeLengths& lengths) {
+            CodeTable codes;
+            assignCanonicalCodes(lengths.data(), lengths.size(), codes.data());
+            return codes;
+        }
+
+        LIBCOMPRA_API DecodeTable BuildDecodeTable(const CodeTable& codes, size_t rootBits) {
+            std::vector<PendingCode> pending;
+            uint32_t maxLength = 0;
+
+            for (size_t symbol = 0; symbol < codes.size(); ++symbol) {
+                if (codes[symbol].length > 0) {
+                    pending.push_back({(uint32_t)symbol, codes[symbol].value, codes[symbol].length});
+                    maxLength = std::max(maxLength, codes[symbol].length);
+                }
+            }
+
+            DecodeTable table;
+            table.rootBits = std::clamp<size_t>(std::min<size_t>(rootBits, maxLength), 1, 16);
+            table.entries.assign(size_t(1) << table.rootBits, {0, 0, 0});
+            fillDecodeTable(table, 0, table.rootBits, pending);
+            return table;
+        }
+
+        LIBCOMPRA_API ByteVector EncodeSymbols(std::string_view text, const CodeTable& codes, size_t& bitLength) {
+            BitIO::BitWriter writer;
+            writer.bytes.reserve(text.size() / 2 + 8);
+
+            for (char ch : text) {
+                const Code& code = codes[(unsigned char)ch];
+                writer.write(code.value, code.length);
+            }
+
+            bitLength = writer.bitLength;
+            return writer.finish();
+        }
+
+        LIBCOMPRA_API std::string DecodeSymbols(const ByteVector& compressedData, size_t bitLength, const DecodeTable& table) {
+            std::string result;
+            decodeSymbols(compressedData.data(), compressedData.size(), bitLength, table, [&](char symbol) {
+                result += symbol;
+            });
+            return result;
+        }
+
+        LIBCOMPRA_API Huffman::ByteVector PackBitsToBytes(const std::string& bitString) {
+            size_t bitLength = 0;
+            return PackBitsToBytes(bitString, bitLength);
+        }
+
+        LIBCOMPRA_API std::string UnpackBytesToBits(const Huffman::ByteVector& compressedData) {
+            return UnpackBytesToBits(compressedData, compressedData.size() * 8);
+        }
+
+        LIBCOMPRA_API Huffman::ByteVector PackBitsToBytes(const std::string& bitString, size_t& bitLength) {
+            BitIO::BitWriter writer;
+
+            for (char bit : bitString) {
+                writer.write(bit == '1' ? 1 : 0, 1);
+            }
+
+            bitLength = writer.bitLength;
+            return writer.finish();
+        }
+
+        LIBCOMPRA_API std::string UnpackBytesToBits(const Huffman::ByteVector& compressedData, size_t bitLength) {
+            BitIO::BitReader reader(compressedData.data(), compressedData.size());
+            std::string bitString(std::min(bitLength, compressedData.size() * 8), '0');
+
+            for (char& bit : bitString) {
+                if (reader.read(1)) {
+                    bit = '1';
+                }
+            }
+
+            return bitString;
+        }
+    }
+
+    LIBCOMPRA_API Compressed compress(std::string_view text, size_t maxCodeLength) {
+        Compressed compressed;
+
+        std::array<uint64_t, 256> frequencies{};
+        for (char ch : text) {
+            ++frequencies[(unsigned char)ch];
+        }
+
+        computeCodeLengths(frequencies.data(), frequencies.size(), compressed.codeLengths.data(), maxCodeLength);
+
+        compressed.byteVec = Methods::EncodeSymbols(text, Methods::BuildCanonicalCodes(compressed.codeLengths), compressed.bitLength);
+        return compressed;
+    }
+
+    LIBCOMPRA_API std::string decompress(const ByteVector& compressed, const CodeLengths& codeLengths, size_t bitLength) {
+        DecodeTable table = Methods::BuildDecodeTable(Methods::BuildCanonicalCodes(codeLengths));
+        return Methods::DecodeSymbols(compressed, bitLength, table);
+    }
+
+    LIBCOMPRA_API std::string decompress(const ByteVector& compressed, const FreqMap& freqMap, size_t bitLength) {
+        return decompress(compressed, Methods::BuildCodeLengths(freqMap), bitLength);
+    }
+
+    LIBCOMPRA_API std::string decompress(const Compressed& compressed) {
+        return decompress(compressed.byteVec, compressed.codeLengths, compressed.bitLength);
+    }
+
+    /* COMPATIBILITY */
+
+    LIBCOMPRA_API Huffman::ByteVector compress(std::string_view text, FreqMap& freqMap, size_t& bitLength) {
+        for (char ch : text) {
+            freqMap[ch]++;
+        }
+
+        return Methods::EncodeSymbols(text, Methods::BuildCanonicalCodes(Methods::BuildCodeLengths(freqMap)), bitLength);
+    }
+
+    LIBCOMPRA_API Huffman::ByteVector Compress(std::string_view text, FreqMap& freqMap, size_t& bitLength) {
+        return compress(text, freqMap, bitLength);
+    }
+
+    LIBCOMPRA_API std::string Decompress(const ByteVector& compressed, const FreqMap& freqMap, size_t bitLength) {
+        return decompress(compressed, freqMap, bitLength);
+    }
+
+    namespace Stringize {
+        LIBCOMPRA_API std::string StringizeFreqMap(const Huffman::FreqMap& freqMap) {
+            std::stringstream ss;
+
+            for (const auto& pair : freqMap) {
+                ss << "'" << pair.first << "'" << ":" << "'" << pair.second << "'" << " "; 
+            }
+
+            return ss.str();
+        }
+
+        LIBCOMPRA_API std::string StringizeByteVec(const Huffman::ByteVector& byteVec) {
+            std::stringstream ss;
+
+            for (size_t i = 0; i < byteVec.size(); ++i) {
+                ss << byteVec[i];
+            }
+
+            return ss.str();
+        }
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return {std::clamp(level, MIN_LEVEL, MAX_LEVEL), 0, 0, 0, 0, 0, Strategy::Greedy};
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        // Code lengths as 128 nibble pairs, the bit count, then at most 11 bits per symbol.
+        return 128 + 10 + (inputSize * 11 + 7) / 8;
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&]() -> Result {
+            std::array<uint64_t, 256> frequencies{};
+            for (size_t i = 0; i < input.size; ++i) {
+                ++frequencies[input.data[i]];
+            }
+            // The 11-bit limit compress(std::string_view) defaults to, which compressBound assumes.
+            CodeLengths codeLengths{};
+            computeCodeLengths(frequencies.data(), frequencies.size(), codeLengths.data(), 11);
+            CodeTable codes = Methods::BuildCanonicalCodes(codeLengths);
+
+            // The code lengths give the exact size before a single bit is written.
+            size_t bitLength = 0;
+            for (size_t s = 0; s < 256; ++s) {
+                bitLength += frequencies[s] * codeLengths[s];
+            }
+            size_t total = 128 + varintLength(bitLength) + (bitLength + 7) / 8;
+            if (total > output.size) {
+                return {total, Error::OutputTooSmall};
+            }
+
+            ByteWriter out(output);
+            for (size_t s = 0; s < 256; s += 2) {
+                out.byte((uint8_t)(codeLengths[s] | (codeLengths[s + 1] << 4)));
+            }
+            out.varint(bitLength);
+            SpanBitWriter bits(out);
+            for (size_t i = 0; i < input.size; ++i) {
+                const Code& code = codes[input.data[i]];
+                bits.write(code.value, code.length);
+            }
+            return out.finish(bits.finish());
+        });
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params&) {
+        return compress(input, output);
+    }
+
+    // Decodes straight from the caller's input into the caller's buffer. Once the buffer is full
+    // the symbols are only counted, so OutputTooSmall still reports the size that would fit.
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&]() -> Result {
+            ByteReader reader(input.data, input.size, "Invalid Huffman input");
+            CodeLengths codeLengths{};
+            const unsigned char* packed = reader.take(128);
+            for (size_t s = 0; s < 256; s += 2) {
+                codeLengths[s] = packed[s / 2] & 15;
+                codeLengths[s + 1] = packed[s / 2] >> 4;
+            }
+
+            size_t bitLength = reader.varint();
+            if ((bitLength + 7) / 8 != reader.remaining()) {
+                throw std::runtime_error("Invalid Huffman input");
+            }
+
+            DecodeTable table = Methods::BuildDecodeTable(Methods::BuildCanonicalCodes(codeLengths));
+            size_t op = 0;
+            decodeSymbols(reader.ip, reader.remaining(), bitLength, table, [&](char symbol) {
+                if (op < output.size) {
+                    output.data[op] = (uint8_t)symbol;
+                }
+                ++op;
+            });
+            return {op, op <= output.size ? Error::None : Error::OutputTooSmall};
+        });
+    }
+}
+
+namespace Deflate {
+    namespace {
+        constexpr size_t WINDOW_SIZE = 32768;
+        constexpr size_t MIN_MATCH = 3;
+        constexpr size_t MAX_MATCH = 258;
+        constexpr size_t LITERAL_SYMBOLS = 288;
+        constexpr size_t DISTANCE_SYMBOLS = 30;
+        constexpr size_t CODE_LENGTH_SYMBOLS = 19;
+        constexpr size_t END_OF_BLOCK = 256;
+        constexpr size_t MAX_CODE_LENGTH = 15;
+        constexpr size_t MAX_STORED_SIZE = 65535;
+        constexpr size_t SPLIT_INTERVAL = 4096;
+        constexpr size_t MAX_BLOCK_TOKENS = 1 << 17;
+        // Roughly what a dynamic block header costs; a split must save more than this.
+        constexpr double SPLIT_PENALTY = 800.0;
+
+        constexpr uint32_t LITERAL_ROOT_BITS = 10;
+        constexpr uint32_t DISTANCE_ROOT_BITS = 8;
+        constexpr uint32_t CODE_LENGTH_ROOT_BITS = 7;
+        constexpr uint32_t SUBTABLE = 0x80000000u;
+        // Longest symbol: 15-bit length code, 5 extra bits, 15-bit distance code, 13 extra bits.
+        constexpr size_t MAX_SYMBOL_BITS = 48;
+        constexpr size_t INPUT_PADDING = 8;
+        constexpr size_t FLUSH_THRESHOLD = 256 * 1024;
+
+        constexpr uint16_t LENGTH_BASE[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        constexpr uint8_t LENGTH_EXTRA[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        constexpr uint16_t DISTANCE_BASE[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        constexpr uint8_t DISTANCE_EXTRA[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        constexpr uint8_t CODE_LENGTH_ORDER[CODE_LENGTH_SYMBOLS] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        enum State { HEADER, BLOCK_HEADER, STORED, CODES, TRAILER, DONE };
+
+        // A literal when distance is 0, otherwise a match of `value` bytes.
+        struct Token {
+            uint16_t value;
+            uint16_t distance;
+        };
+
+        struct CodeBook {
+            std::array<uint16_t, LITERAL_SYMBOLS> literalCodes{};
+            std::array<uint8_t, LITERAL_SYMBOLS> literalLengths{};
+            std::array<uint16_t, DISTANCE_SYMBOLS> distanceCodes{};
+            std::array<uint8_t, DISTANCE_SYMBOLS> distanceLengths{};
+        };
+
+        inline uint32_t reverseBits(uint32_t code, size_t length) {
+            uint32_t reversed = 0;
+            for (size_t i = 0; i < length; ++i) {
+                reversed = (reversed << 1) | ((code >> i) & 1);
+            }
+            return reversed;
+        }
+
+        inline uint8_t lengthCode(size_t length) {
+            return (uint8_t)(std::upper_bound(LENGTH_BASE, LENGTH_BASE + 29, length) - LENGTH_BASE - 1);
+        }
+
+        inline uint8_t distanceCode(size_t distance) {
+            return (uint8_t)(std::upper_bound(DISTANCE_BASE, DISTANCE_BASE + 30, distance) - DISTANCE_BASE - 1);
+        }
+
+        // DEFLATE packs bits LSB-first, the opposite of BitIO::BitWriter.
+        struct LsbWriter {
+            std::string& out;
+            uint64_t buffer = 0;
+            size_t count = 0;
+
+            explicit LsbWriter(std::string& out) : out(out) {}
+
+            void write(uint32_t value, size_t bits) {
+                buffer |= (uint64_t)value << count;
+                count += bits;
+                if (count >= 32) {
+                    char word[4] = {(char)buffer, (char)(buffer >> 8), (char)(buffer >> 16), (char)(buffer >> 24)};
+                    out.append(word, 4);
+                    buffer >>= 32;
+                    count -= 32;
+                }
+            }
+
+            void alignToByte() {
+                for (; count > 0; count = count > 8 ? count - 8 : 0) {
+                    out += (char)buffer;
+                    buffer >>= 8;
+                }
+                buffer = 0;
+            }
+        };
+
+        void assignCodes(const uint8_t* lengths, size_t count, uint16_t* codes) {
+            std::vector<Huffman::Code> canonical = Huffman::Methods::BuildCanonicalCodes(std::vector<uint8_t>(lengths, lengths + count));
+            for (size_t s = 0; s < count; ++s) {
+                codes[s] = (uint16_t)reverseBits((uint32_t)canonical[s].value, lengths[s]);
+            }
+        }
+
+        const CodeBook& fixedCodeBook() {
+            static const CodeBook book = [] {
+                CodeBook fixed;
+                for (size_t s = 0; s < LITERAL_SYMBOLS; ++s) {
+                    fixed.literalLengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+                }
+                fixed.distanceLengths.fill(5);
+                assignCodes(fixed.literalLengths.data(), LITERAL_SYMBOLS, fixed.literalCodes.data());
+                assignCodes(fixed.distanceLengths.data(), DISTANCE_SYMBOLS, fixed.distanceCodes.data());
+                return fixed;
+            }();
+            return book;
+        }
+
+        // Every code gets at least two symbols so stock inflaters accept it as complete.
+        std::vector<uint8_t> limitedLengths(std::vector<uint64_t> frequencies, size_t maxCodeLength) {
+            size_t used = 0;
+            for (uint64_t frequency : frequencies) {
+                used += frequency != 0;
+            }
+            for (size_t s = 0; used < 2 && s < frequencies.size(); ++s) {
+                if (frequencies[s] == 0) {
+                    frequencies[s] = 1;
+                    ++used;
+                }
+            }
+            return Huffman::Methods::BuildCodeLengths(frequencies, maxCodeLength);
+        }
+
+        struct CodeLengthSymbol {
+            uint8_t symbol;
+            uint8_t extra;
+        };
+
+        // Run-length codes the concatenated literal and distance code lengths (RFC 1951 3.2.7).
+        std::vector<CodeLengthSymbol> runLengthEncode(const std::vector<uint8_t>& lengths) {
+            std::vector<CodeLengthSymbol> symbols;
+            for (size_t i = 0; i < lengths.size();) {
+                uint8_t length = lengths[i];
+                size_t run = 1;
+                while (i + run < lengths.size() && lengths[i + run] == length) {
+                    ++run;
+                }
+                i += run;
+
+                if (length == 0) {
+                    while (run >= 11) {
+                        size_t chunk = std::min<size_t>(run, 138);
+                        symbols.push_back({18, (uint8_t)(chunk - 11)});
+                        run -= chunk;
+                    }
+                    if (run >= 3) {
+                        symbols.push_back({17, (uint8_t)(run - 3)});
+                        run = 0;
+                    }
+                } else {
+                    symbols.push_back({length, 0});
+                    --run;
+                    while (run >= 3) {
+                        size_t chunk = std::min<size_t>(run, 6);
+                        symbols.push_back({16, (uint8_t)(chunk - 3)});
+                        run -= chunk;
+                    }
+                }
+                for (; run > 0; --run) {
+                    symbols.push_back({length, 0});
+                }
+            }
+            return symbols;
+        }
+
+        inline size_t codeLengthExtraBits(uint8_t symbol) {
+            return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+        }
+
+        double entropyCost(const uint32_t* histogram, size_t count) {
+            uint64_t total = 0;
+            for (size_t s = 0; s < count; ++s) {
+                total += histogram[s];
+            }
+            double cost = 0;
+            for (size_t s = 0; s < count; ++s) {
+                if (histogram[s]) {
+                    cost += histogram[s] * std::log2((double)total / histogram[s]);
+                }
+            }
+            return cost;
+        }
+
+        struct Histogram {
+            std::array<uint32_t, LITERAL_SYMBOLS> literals{};
+            std::array<uint32_t, DISTANCE_SYMBOLS> distances{};
+
+            void add(const Token& token) {
+                if (token.distance == 0) {
+                    ++literals[token.value];
+                } else {
+                    ++literals[257 + lengthCode(token.value)];
+                    ++distances[distanceCode(token.distance)];
+                }
+            }
+
+            void merge(const Histogram& other) {
+                for (size_t s = 0; s < LITERAL_SYMBOLS; ++s) literals[s] += other.literals[s];
+                for (size_t s = 0; s < DISTANCE_SYMBOLS; ++s) distances[s] += other.distances[s];
+            }
+
+            double cost() const {
+                return entropyCost(literals.data(), LITERAL_SYMBOLS) + entropyCost(distances.data(), DISTANCE_SYMBOLS);
+            }
+        };
+
+        bool shouldSplit(const Histogram& block, const Histogram& chunk) {
+            Histogram merged = block;
+            merged.merge(chunk);
+            return block.cost() + chunk.cost() + SPLIT_PENALTY < merged.cost();
+        }
+
+        void writeStored(LsbWriter& writer, const char* data, size_t size, bool final) {
+            do {
+                size_t chunk = std::min(size, MAX_STORED_SIZE);
+                writer.write((final && chunk == size) ? 1 : 0, 3);
+                writer.alignToByte();
+                char header[4] = {(char)chunk, (char)(chunk >> 8), (char)~chunk, (char)(~chunk >> 8)};
+                writer.out.append(header, 4);
+                writer.out.append(data, chunk);
+                data += chunk;
+                size -= chunk;
+            } while (size > 0);
+        }
+
+        void writeTokens(LsbWriter& writer, const Token* tokens, size_t count, const CodeBook& book) {
+            for (size_t i = 0; i < count; ++i) {
+                const Token& token = tokens[i];
+                if (token.distance == 0) {
+                    writer.write(book.literalCodes[token.value], book.literalLengths[token.value]);
+                    continue;
+                }
+                uint8_t lc = lengthCode(token.value);
+                writer.write(book.literalCodes[257 + lc], book.literalLengths[257 + lc]);
+                writer.write(token.value - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+                uint8_t dc = distanceCode(token.distance);
+                writer.write(book.distanceCodes[dc], book.distanceLengths[dc]);
+                writer.write(token.distance - DISTANCE_BASE[dc], DISTANCE_EXTRA[dc]);
+            }
+            writer.write(book.literalCodes[END_OF_BLOCK], book.literalLengths[END_OF_BLOCK]);
+        }
+
+        uint64_t symbolCost(const Histogram& histogram, const uint8_t* literalLengths, const uint8_t* distanceLengths) {
+            uint64_t bits = 0;
+            for (size_t s = 0; s < LITERAL_SYMBOLS; ++s) {
+                bits += (uint64_t)histogram.literals[s] * literalLengths[s];
+                if (s >= 257 && s < 257 + 29) bits += (uint64_t)histogram.literals[s] * LENGTH_EXTRA[s - 257];
+            }
+            for (size_t s = 0; s < DISTANCE_SYMBOLS; ++s) {
+                bits += (uint64_t)histogram.distances[s] * (distanceLengths[s] + DISTANCE_EXTRA[s]);
+            }
+            return bits;
+        }
+
+        // Emits one block as stored, fixed or dynamic Huffman, whichever is smallest.
+        void writeBlock(LsbWriter& writer, const Token* tokens, size_t count, const char* raw, size_t rawSize, bool final) {
+            Histogram histogram;
+            for (size_t i = 0; i < count; ++i) {
+                histogram.add(tokens[i]);
+            }
+            histogram.literals[END_OF_BLOCK] = 1;
+
+            std::vector<uint8_t> literalLengths = limitedLengths(std::vector<uint64_t>(histogram.literals.begin(), histogram.literals.begin() + 286), MAX_CODE_LENGTH);
+            std::vector<uint8_t> distanceLengths = limitedLengths(std::vector<uint64_t>(histogram.distances.begin(), histogram.distances.end()), MAX_CODE_LENGTH);
+
+            size_t literalCount = 286;
+            while (literalCount > 257 && literalLengths[literalCount - 1] == 0) --literalCount;
+            size_t distanceCount = DISTANCE_SYMBOLS;
+            while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) --distanceCount;
+
+            std::vector<uint8_t> allLengths(literalLengths.begin(), literalLengths.begin() + literalCount);
+            allLengths.insert(allLengths.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+            std::vector<CodeLengthSymbol> runs = runLengthEncode(allLengths);
+
+            std::vector<uint64_t> codeLengthFrequencies(CODE_LENGTH_SYMBOLS, 0);
+            for (const CodeLengthSymbol& run : runs) {
+                ++codeLengthFrequencies[run.symbol];
+            }
+            std::vector<uint8_t> codeLengthLengths = limitedLengths(codeLengthFrequencies, 7);
+            size_t codeLengthCount = CODE_LENGTH_SYMBOLS;
+            while (codeLengthCount > 4 && codeLengthLengths[CODE_LENGTH_ORDER[codeLengthCount - 1]] == 0) --codeLengthCount;
+
+            uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * codeLengthCount;
+            for (const CodeLengthSymbol& run : runs) {
+                dynamicBits += codeLengthLengths[run.symbol] + codeLengthExtraBits(run.symbol);
+            }
+            literalLengths.resize(LITERAL_SYMBOLS, 0);
+            dynamicBits += symbolCost(histogram, literalLengths.data(), distanceLengths.data());
+
+            const CodeBook& fixed = fixedCodeBook();
+            uint64_t fixedBits = 3 + symbolCost(histogram, fixed.literalLengths.data(), fixed.distanceLengths.data());
+            uint64_t storedBits = (rawSize + (rawSize / MAX_STORED_SIZE + 1) * 5) * 8 + 7;
+
+            if (storedBits <= fixedBits && storedBits <= dynamicBits) {
+                writeStored(writer, raw, rawSize, final);
+                return;
+            }
+
+            if (fixedBits <= dynamicBits) {
+                writer.write(final ? 1 : 0, 1);
+                writer.write(1, 2);
+                writeTokens(writer, tokens, count, fixed);
+                return;
+            }
+
+            CodeBook book;
+            std::copy(literalLengths.begin(), literalLengths.end(), book.literalLengths.begin());
+            std::copy(distanceLengths.begin(), distanceLengths.end(), book.distanceLengths.begin());
+            assignCodes(book.literalLengths.data(), LITERAL_SYMBOLS, book.literalCodes.data());
+            assignCodes(book.distanceLengths.data(), DISTANCE_SYMBOLS, book.distanceCodes.data());
+            std::array<uint16_t, CODE_LENGTH_SYMBOLS> codeLengthCodes;
+            assignCodes(codeLengthLengths.data(), CODE_LENGTH_SYMBOLS, codeLengthCodes.data());
+
+            writer.write(final ? 1 : 0, 1);
+            writer.write(2, 2);
+            writer.write((uint32_t)(literalCount - 257), 5);
+            writer.write((uint32_t)(distanceCount - 1), 5);
+            writer.write((uint32_t)(codeLengthCount - 4), 4);
+            for (size_t i = 0; i < codeLengthCount; ++i) {
+                writer.write(codeLengthLengths[CODE_LENGTH_ORDER[i]], 3);
+            }
+            for (const CodeLengthSymbol& run : runs) {
+                writer.write(codeLengthCodes[run.symbol], codeLengthLengths[run.symbol]);
+                writer.write(run.extra, codeLengthExtraBits(run.symbol));
+            }
+            writeTokens(writer, tokens, count, book);
+        }
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {15, 15, 4, 3, 258, Strategy::Greedy},
+            {15, 15, 8, 3, 258, Strategy::Greedy},
+            {15, 15, 16, 3, 258, Strategy::Greedy},
+            {15, 15, 16, 3, 258, Strategy::Lazy},
+            {15, 15, 32, 3, 258, Strategy::Lazy},
+            {15, 15, 64, 3, 258, Strategy::Lazy},
+            {15, 15, 128, 3, 258, Strategy::Lazy},
+            {15, 15, 512, 3, 258, Strategy::Lazy},
+            {15, 15, 2048, 3, 258, Strategy::Lazy}};
+
+        void writeHeader(std::string& out, Wrapper wrapper, int level) {
+            if (wrapper == Wrapper::Zlib) {
+                // CMF: deflate with a 32K window; FLG: compression level hint plus FCHECK.
+                uint8_t cmf = 0x78;
+                uint8_t flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+                uint8_t flg = (uint8_t)(flevel << 6);
+                flg |= 31 - ((cmf << 8) | flg) % 31;
+                out += (char)cmf;
+                out += (char)flg;
+            } else if (wrapper == Wrapper::Gzip) {
+                const char header[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, (char)(level == 9 ? 2 : level == 1 ? 4 : 0), '\xff'};
+                out.append(header, 10);
+            }
+        }
+
+        void writeTrailer(std::string& out, Wrapper wrapper, std::string_view input) {
+            if (wrapper == Wrapper::Zlib) {
+                uint32_t adler = Methods::Adler32(input.data(), input.size());
+                for (int shift = 24; shift >= 0; shift -= 8) {
+                    out += (char)(adler >> shift);
+                }
+            } else if (wrapper == Wrapper::Gzip) {
+                uint32_t crc = Methods::Crc32(input.data(), input.size());
+                uint32_t size = (uint32_t)input.size();
+                for (int shift = 0; shift < 32; shift += 8) {
+                    out += (char)(crc >> shift);
+                }
+                for (int shift = 0; shift < 32; shift += 8) {
+                    out += (char)(size >> shift);
+                }
+            }
+        }
+
+        // Two-level decoding table indexed by LSB-first input bits. Leaf entries hold
+        // symbol | length << 16; root entries with SUBTABLE set point at a second level.
+        void buildTable(const uint8_t* lengths, size_t count, uint32_t rootBits, std::vector<uint32_t>& table) {
+            uint32_t lengthCounts[MAX_CODE_LENGTH + 1] = {};
+            for (size_t s = 0; s < count; ++s) {
+                ++lengthCounts[lengths[s]];
+            }
+            lengthCounts[0] = 0;
+
+            int left = 1;
+            uint32_t nextCode[MAX_CODE_LENGTH + 1] = {};
+            for (size_t bits = 1; bits <= MAX_CODE_LENGTH; ++bits) {
+                left = (left << 1) - (int)lengthCounts[bits];
+                if (left < 0) {
+                    throw std::runtime_error("Invalid Deflate code lengths");
+                }
+                nextCode[bits] = (nextCode[bits - 1] + lengthCounts[bits - 1]) << 1;
+            }
+
+            uint32_t rootMask = (1u << rootBits) - 1;
+            table.assign(size_t(1) << rootBits, 0);
+
+            uint8_t subBits[1 << LITERAL_ROOT_BITS] = {};
+            uint32_t codes[LITERAL_SYMBOLS];
+            uint32_t firstCode[MAX_CODE_LENGTH + 1];
+            std::copy(nextCode, nextCode + MAX_CODE_LENGTH + 1, firstCode);
+            for (size_t s = 0; s < count; ++s) {
+                if (lengths[s] == 0) continue;
+                codes[s] = reverseBits(nextCode[lengths[s]]++, lengths[s]);
+                if (lengths[s] > rootBits) {
+                    uint32_t prefix = codes[s] & rootMask;
+                    subBits[prefix] = std::max<uint8_t>(subBits[prefix], (uint8_t)(lengths[s] - rootBits));
+                }
+            }
+            for (uint32_t prefix = 0; prefix <= rootMask; ++prefix) {
+                if (subBits[prefix]) {
+                    table[prefix] = SUBTABLE | ((uint32_t)subBits[prefix] << 16) | (uint32_t)table.size();
+                    table.resize(table.size() + (size_t(1) << subBits[prefix]), 0);
+                }
+            }
+
+            for (size_t s = 0; s < count; ++s) {
+                uint32_t length = lengths[s];
+                if (length == 0) continue;
+                uint32_t entry = (uint32_t)s | (length << 16);
+                if (length <= rootBits) {
+                    for (uint32_t i = codes[s]; i <= rootMask; i += 1u << length) {
+                        table[i] = entry;
+                    }
+                } else {
+                    uint32_t root = table[codes[s] & rootMask];
+                    uint32_t base = root & 0xFFFF;
+                    uint32_t size = 1u << ((root >> 16) & 0x7F);
+                    for (uint32_t i = codes[s] >> rootBits; i < size; i += 1u << (length - rootBits)) {
+                        table[base + i] = entry;
+                    }
+                }
+            }
+        }
+
+        inline uint32_t decodeEntry(const std::vector<uint32_t>& table, uint32_t rootBits, uint64_t bits) {
+            uint32_t entry = table[bits & ((1u << rootBits) - 1)];
+            if (entry & SUBTABLE) {
+                uint32_t subMask = (1u << ((entry >> 16) & 0x7F)) - 1;
+                entry = table[(entry & 0xFFFF) + ((bits >> rootBits) & subMask)];
+            }
+            return entry;
+        }
+
+        const std::vector<uint32_t>& fixedLiteralTable() {
+            static const std::vector<uint32_t> table = [] {
+                std::vector<uint32_t> fixed;
+                buildTable(fixedCodeBook().literalLengths.data(), LITERAL_SYMBOLS, LITERAL_ROOT_BITS, fixed);
+                return fixed;
+            }();
+            return table;
+        }
+
+        const std::vector<uint32_t>& fixedDistanceTable() {
+            static const std::vector<uint32_t> table = [] {
+                uint8_t lengths[32];
+                std::fill(lengths, lengths + 32, 5);
+                std::vector<uint32_t> fixed;
+                buildTable(lengths, 32, DISTANCE_ROOT_BITS, fixed);
+                return fixed;
+            }();
+            return table;
+        }
+
+        inline size_t availableBits(const Inflater& inflater) {
+            return (inflater.input.size() - INPUT_PADDING) * 8 - inflater.bitPosition;
+        }
+
+        inline uint64_t peekBits(const Inflater& inflater) {
+            return readLE64(inflater.input.data() + (inflater.bitPosition >> 3)) >> (inflater.bitPosition & 7);
+        }
+
+        inline bool readBits(Inflater& inflater, size_t bits, uint32_t& value) {
+            if (availableBits(inflater) < bits) return false;
+            value = (uint32_t)(peekBits(inflater) & ((uint64_t(1) << bits) - 1));
+            inflater.bitPosition += bits;
+            return true;
+        }
+
+        void reserveWindow(Inflater& inflater, size_t length) {
+            if (inflater.windowEnd + length + WILDCOPY_SLACK > inflater.window.size()) {
+                inflater.window.resize(std::max(inflater.window.size() * 2, inflater.windowEnd + length + WILDCOPY_SLACK));
+            }
+        }
+
+        // Hands decoded bytes to the caller, then drops history older than the 32K window.
+        void flushWindow(Inflater& inflater, std::string& output) {
+            const char* start = inflater.window.data() + inflater.flushed;
+            size_t size = inflater.windowEnd - inflater.flushed;
+            if (inflater.wrapper == Wrapper::Zlib) {
+                inflater.checksum = Methods::Adler32(start, size, inflater.checksum);
+            } else if (inflater.wrapper == Wrapper::Gzip) {
+                inflater.checksum = Methods::Crc32(start, size, inflater.checksum);
+            }
+            output.append(start, size);
+            inflater.totalOut += size;
+            inflater.flushed = inflater.windowEnd;
+
+            if (inflater.windowEnd > FLUSH_THRESHOLD + WINDOW_SIZE) {
+                std::memmove(&inflater.window[0], inflater.window.data() + inflater.windowEnd - WINDOW_SIZE, WINDOW_SIZE);
+                inflater.windowEnd = inflater.flushed = WINDOW_SIZE;
+            }
+        }
+
+        // The readers below return false when input runs out; callers rewind to a safe position.
+        bool readHeader(Inflater& inflater) {
+            const unsigned char* data = (const unsigned char*)inflater.input.data() + (inflater.bitPosition >> 3);
+            size_t size = availableBits(inflater) >> 3;
+
+            if (inflater.wrapper == Wrapper::Zlib) {
+                if (size < 2) return false;
+                if ((data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0) {
+                    throw std::runtime_error("Invalid zlib header");
+                }
+                if (data[1] & 0x20) {
+                    throw std::runtime_error("zlib preset dictionaries are not supported");
+                }
+                inflater.bitPosition += 16;
+                return true;
+            }
+
+            if (size < 10) return false;
+            if (data[0] != 0x1f || data[1] != 0x8b || data[2] != 8) {
+                throw std::runtime_error("Invalid gzip header");
+            }
+            uint8_t flags = data[3];
+            size_t pos = 10;
+            if (flags & 0x04) {
+                if (size < pos + 2) return false;
+                pos += 2 + (data[pos] | (data[pos + 1] << 8));
+            }
+            for (uint8_t field : {0x08, 0x10}) {
+                if (!(flags & field)) continue;
+                while (pos < size && data[pos] != 0) ++pos;
+                if (pos >= size) return false;
+                ++pos;
+            }
+            if (flags & 0x02) pos += 2;
+            if (size < pos) return false;
+
+            inflater.bitPosition += pos * 8;
+            return true;
+        }
+
+        bool readDynamicTables(Inflater& inflater) {
+            uint32_t literalCount, distanceCount, codeLengthCount;
+            if (!readBits(inflater, 5, literalCount) || !readBits(inflater, 5, distanceCount) || !readBits(inflater, 4, codeLengthCount)) {
+                return false;
+            }
+            literalCount += 257;
+            distanceCount += 1;
+            codeLengthCount += 4;
+            if (literalCount > 286 || distanceCount > DISTANCE_SYMBOLS) {
+                throw std::runtime_error("Invalid Deflate block header");
+            }
+
+            uint8_t codeLengthLengths[CODE_LENGTH_SYMBOLS] = {};
+            for (size_t i = 0; i < codeLengthCount; ++i) {
+                uint32_t length;
+                if (!readBits(inflater, 3, length)) return false;
+                codeLengthLengths[CODE_LENGTH_ORDER[i]] = (uint8_t)length;
+            }
+            std::vector<uint32_t> codeLengthTable;
+            buildTable(codeLengthLengths, CODE_LENGTH_SYMBOLS, CODE_LENGTH_ROOT_BITS, codeLengthTable);
+
+            uint8_t lengths[286 + DISTANCE_SYMBOLS] = {};
+            size_t total = literalCount + distanceCount;
+            for (size_t i = 0; i < total;) {
+                uint32_t entry = codeLengthTable[peekBits(inflater) & ((1u << CODE_LENGTH_ROOT_BITS) - 1)];
+                uint32_t length = (entry >> 16) & 0xFF;
+                if (length == 0 || length > availableBits(inflater)) {
+                    if (availableBits(inflater) < CODE_LENGTH_ROOT_BITS) return false;
+                    throw std::runtime_error("Invalid Deflate code lengths");
+                }
+                inflater.bitPosition += length;
+
+                uint32_t symbol = entry & 0xFFFF;
+                if (symbol < 16) {
+                    lengths[i++] = (uint8_t)symbol;
+                    continue;
+                }
+
+                uint32_t repeat;
+                uint8_t value = 0;
+                if (symbol == 16) {
+                    if (i == 0) throw std::runtime_error("Invalid Deflate code lengths");
+                    if (!readBits(inflater, 2, repeat)) return false;
+                    repeat += 3;
+                    value = lengths[i - 1];
+                } else if (symbol == 17) {
+                    if (!readBits(inflater, 3, repeat)) return false;
+                    repeat += 3;
+                } else {
+                    if (!readBits(inflater, 7, repeat)) return false;
+                    repeat += 11;
+                }
+                if (i + repeat > total) {
+                    throw std::runtime_error("Invalid Deflate code lengths");
+                }
+                std::fill(lengths + i, lengths + i + repeat, value);
+                i += repeat;
+            }
+            if (lengths[END_OF_BLOCK] == 0) {
+                throw std::runtime_error("Invalid Deflate code lengths");
+            }
+
+            buildTable(lengths, literalCount, LITERAL_ROOT_BITS, inflater.literalTable);
+            buildTable(lengths + literalCount, distanceCount, DISTANCE_ROOT_BITS, inflater.distanceTable);
+            return true;
+        }
+
+        bool readBlockHeader(Inflater& inflater) {
+            uint32_t header;
+            if (!readBits(inflater, 3, header)) return false;
+            inflater.finalBlock = header & 1;
+
+            switch (header >> 1) {
+                case 0: {
+                    inflater.bitPosition = (inflater.bitPosition + 7) & ~size_t(7);
+                    if (availableBits(inflater) < 32) return false;
+                    const unsigned char* data = (const unsigned char*)inflater.input.data() + (inflater.bitPosition >> 3);
+                    uint32_t length = data[0] | (data[1] << 8);
+                    uint32_t complement = data[2] | (data[3] << 8);
+                    if ((length ^ 0xFFFF) != complement) {
+                        throw std::runtime_error("Invalid Deflate stored block");
+                    }
+                    inflater.bitPosition += 32;
+                    inflater.storedRemaining = length;
+                    inflater.state = STORED;
+                    return true;
+                }
+                case 1:
+                    inflater.literalTable = fixedLiteralTable();
+                    inflater.distanceTable = fixedDistanceTable();
+                    inflater.state = CODES;
+                    return true;
+                case 2:
+                    if (!readDynamicTables(inflater)) return false;
+                    inflater.state = CODES;
+                    return true;
+                default:
+                    throw std::runtime_error("Invalid Deflate block type");
+            }
+        }
+
+        // Decodes symbols until the end of the block; returns false when input runs out.
+        bool readCodes(Inflater& inflater, std::string& output) {
+            const std::vector<uint32_t>& literals = inflater.literalTable;
+            const std::vector<uint32_t>& distances = inflater.distanceTable;
+
+            while (true) {
+                if (inflater.windowEnd - inflater.flushed > FLUSH_THRESHOLD) {
+                    flushWindow(inflater, output);
+                }
+
+                size_t available = availableBits(inflater);
+                uint64_t bits = peekBits(inflater);
+                uint32_t entry = decodeEntry(literals, LITERAL_ROOT_BITS, bits);
+                size_t used = (entry >> 16) & 0xFF;
+                uint32_t symbol = entry & 0xFFFF;
+                if (used == 0 || (symbol > 256 && symbol - 257 >= 29)) {
+                    if (available < MAX_SYMBOL_BITS) return false;
+                    throw std::runtime_error("Invalid Deflate literal/length code");
+                }
+
+                if (symbol < 256) {
+                    if (used > available) return false;
+                    inflater.bitPosition += used;
+                    reserveWindow(inflater, 1);
+                    inflater.window[inflater.windowEnd++] = (char)symbol;
+                    continue;
+                }
+
+                if (symbol == END_OF_BLOCK) {
+                    if (used > available) return false;
+                    inflater.bitPosition += used;
+                    inflater.state = inflater.finalBlock ? TRAILER : BLOCK_HEADER;
+                    return true;
+                }
+
+                size_t lc = symbol - 257;
+                size_t length = LENGTH_BASE[lc] + ((bits >> used) & ((1u << LENGTH_EXTRA[lc]) - 1));
+                used += LENGTH_EXTRA[lc];
+
+                uint32_t distanceEntry = decodeEntry(distances, DISTANCE_ROOT_BITS, bits >> used);
+                size_t distanceUsed = (distanceEntry >> 16) & 0xFF;
+                uint32_t dc = distanceEntry & 0xFFFF;
+                if (distanceUsed == 0 || dc >= DISTANCE_SYMBOLS) {
+                    if (available < MAX_SYMBOL_BITS) return false;
+                    throw std::runtime_error("Invalid Deflate distance code");
+                }
+                used += distanceUsed;
+                size_t distance = DISTANCE_BASE[dc] + ((bits >> used) & ((1u << DISTANCE_EXTRA[dc]) - 1));
+                used += DISTANCE_EXTRA[dc];
+
+                if (used > available) return false;
+                if (distance > inflater.windowEnd) {
+                    throw std::runtime_error("Invalid Deflate distance");
+                }
+                inflater.bitPosition += used;
+
+                reserveWindow(inflater, length);
+                copyMatch(&inflater.window[inflater.windowEnd], distance, length);
+                inflater.windowEnd += length;
+            }
+        }
+
+        bool readStored(Inflater& inflater) {
+            size_t size = std::min(inflater.storedRemaining, availableBits(inflater) >> 3);
+            reserveWindow(inflater, size);
+            std::memcpy(&inflater.window[inflater.windowEnd], inflater.input.data() + (inflater.bitPosition >> 3), size);
+            inflater.windowEnd += size;
+            inflater.bitPosition += size * 8;
+            inflater.storedRemaining -= size;
+
+            if (inflater.storedRemaining > 0) return false;
+            inflater.state = inflater.finalBlock ? TRAILER : BLOCK_HEADER;
+            return true;
+        }
+
+        bool readTrailer(Inflater& inflater, std::string& output) {
+            size_t position = (inflater.bitPosition + 7) & ~size_t(7);
+            size_t size = inflater.wrapper == Wrapper::Zlib ? 4 : inflater.wrapper == Wrapper::Gzip ? 8 : 0;
+            if ((inflater.input.size() - INPUT_PADDING) * 8 < position + size * 8) return false;
+
+            flushWindow(inflater, output);
+            const unsigned char* data = (const unsigned char*)inflater.input.data() + (position >> 3);
+            if (inflater.wrapper == Wrapper::Zlib) {
+                uint32_t adler = ((uint32_t)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+                if (adler != inflater.checksum) {
+                    throw std::runtime_error("zlib checksum mismatch");
+                }
+            } else if (inflater.wrapper == Wrapper::Gzip) {
+                uint32_t crc = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+                uint32_t size = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+                if (crc != inflater.checksum || size != (uint32_t)inflater.totalOut) {
+                    throw std::runtime_error("gzip checksum mismatch");
+                }
+            }
+
+            inflater.bitPosition = position + size * 8;
+            inflater.state = DONE;
+            return true;
+        }
+    }
+
+    namespace Methods {
+        LIBCOMPRA_API uint32_t Crc32(const char* data, size_t size, uint32_t crc) {
+            static const std::array<uint32_t, 256> table = [] {
+                std::array<uint32_t, 256> entries;
+                for (uint32_t n = 0; n < 256; ++n) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; ++k) {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    entries[n] = c;
+                }
+                return entries;
+            }();
+
+            crc = ~crc;
+            for (size_t i = 0; i < size; ++i) {
+                crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        LIBCOMPRA_API uint32_t Adler32(const char* data, size_t size, uint32_t adler) {
+            constexpr uint32_t MOD = 65521;
+            constexpr size_t NMAX = 5552;
+
+            uint32_t a = adler & 0xFFFF;
+            uint32_t b = adler >> 16;
+            while (size > 0) {
+                size_t chunk = std::min(size, NMAX);
+                size -= chunk;
+                for (; chunk > 0; --chunk) {
+                    a += (uint8_t)*data++;
+                    b += a;
+                }
+                a %= MOD;
+                b %= MOD;
+            }
+            return (b << 16) | a;
+        }
+    }
+
+    LIBCOMPRA_API Inflater::Inflater(Wrapper wrapper)
+        : wrapper(wrapper), state(wrapper == Wrapper::Raw ? BLOCK_HEADER : HEADER), input(INPUT_PADDING, '\0'), bitPosition(0),
+          windowEnd(0), flushed(0), finalBlock(false), storedRemaining(0), checksum(wrapper == Wrapper::Zlib ? 1 : 0), totalOut(0) {}
+
+    LIBCOMPRA_API bool Inflater::update(const char* data, size_t size, std::string& output) {
+        input.resize(input.size() - INPUT_PADDING);
+        input.append(data, size);
+        input.append(INPUT_PADDING, '\0');
+
+        bool progress = true;
+        while (progress && state != DONE) {
+            size_t checkpoint = bitPosition;
+            switch (state) {
+                case HEADER:
+                    progress = readHeader(*this);
+                    if (progress) state = BLOCK_HEADER;
+                    break;
+                case BLOCK_HEADER:
+                    progress = readBlockHeader(*this);
+                    break;
+                case STORED:
+                    progress = readStored(*this);
+                    checkpoint = bitPosition;
+                    break;
+                case CODES:
+                    progress = readCodes(*this, output);
+                    checkpoint = bitPosition;
+                    break;
+                case TRAILER:
+                    progress = readTrailer(*this, output);
+                    break;
+            }
+            if (!progress) {
+                bitPosition = checkpoint;
+            }
+        }
+
+        flushWindow(*this, output);
+
+        size_t consumed = std::min(bitPosition >> 3, input.size() - INPUT_PADDING);
+        input.erase(0, consumed);
+        bitPosition -= consumed * 8;
+        return state == DONE;
+    }
+
+    LIBCOMPRA_API void Inflater::setDictionary(std::string_view dictionary) {
+        if (totalOut > 0 || windowEnd > 0 || input.size() > INPUT_PADDING || state != (wrapper == Wrapper::Raw ? BLOCK_HEADER : HEADER)) {
+            throw std::runtime_error("Deflate dictionary must be set before decoding starts");
+        }
+        dictionary = dictionary.substr(dictionary.size() - std::min(dictionary.size(), WINDOW_SIZE));
+        window.assign(dictionary.data(), dictionary.size());
+        windowEnd = flushed = dictionary.size();
+    }
+
+    LIBCOMPRA_API bool Inflater::update(const std::string& data, std::string& output) {
+        return update(data.data(), data.size(), output);
+    }
+
+    LIBCOMPRA_API bool Inflater::finished() const {
+        return state == DONE;
+    }
+
+    LIBCOMPRA_API size_t Inflater::trailingBytes() const {
+        return state == DONE ? input.size() - INPUT_PADDING - (bitPosition + 7) / 8 : 0;
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
+
+    LIBCOMPRA_API std::string compress(std::string_view input, Wrapper wrapper, int level) {
+        if (level > 0) {
+            return compress(input, preset(level), wrapper);
+        }
+
+        Params stored = preset(MIN_LEVEL);
+        stored.level = 0;
+        stored.searchDepth = 0;
+        return compress(input, stored, wrapper);
+    }
+
+    namespace {
+        // Compresses input as if it followed dictionary, so early matches may reach into it.
+        std::string deflate(std::string_view dictionary, std::string_view input, const Params& params, Wrapper wrapper) {
+            int level = std::clamp(params.level, 0, MAX_LEVEL);
+
+            std::string out;
+            out.reserve(input.size() / 2 + 64);
+            writeHeader(out, wrapper, level);
+            LsbWriter writer(out);
+
+            dictionary = dictionary.substr(dictionary.size() - std::min(dictionary.size(), WINDOW_SIZE));
+            std::string joined;
+            std::string_view source = input;
+            if (!dictionary.empty()) {
+                joined.reserve(dictionary.size() + input.size());
+                joined.append(dictionary).append(input);
+                source = joined;
+            }
+
+            const char* data = source.data();
+            size_t n = source.size();
+            size_t start = dictionary.size();
+
+            if (params.searchDepth == 0) {
+                writeStored(writer, data + start, n - start, true);
+            } else {
+                bool lazy = params.strategy != Strategy::Greedy;
+                size_t niceLength = std::clamp<size_t>(params.niceLength, MIN_MATCH, MAX_MATCH);
+                LZ77::HashChain chain(clampedLog(params.windowLog, 8, 15), params.searchDepth, params.minMatch, params.hashLog, niceLength);
+                std::vector<Token> tokens;
+                Histogram block, chunk;
+                size_t blockStart = start;
+                size_t chunkStart = start;
+                size_t chunkFirstToken = 0;
+                size_t nextInsert = 0;
+                size_t pos = start;
+
+                auto insertUpTo = [&](size_t target) {
+                    for (; nextInsert < target; ++nextInsert) {
+                        chain.insert(source, nextInsert);
+                    }
+                };
+
+                auto endChunk = [&]() {
+                    if (chunkFirstToken > 0 && shouldSplit(block, chunk)) {
+                        writeBlock(writer, tokens.data(), chunkFirstToken, data + blockStart, chunkStart - blockStart, false);
+                        tokens.erase(tokens.begin(), tokens.begin() + chunkFirstToken);
+                        blockStart = chunkStart;
+                        block = chunk;
+                    } else {
+                        block.merge(chunk);
+                    }
+                    chunk = Histogram();
+                    chunkFirstToken = tokens.size();
+                    chunkStart = pos;
+
+                    if (tokens.size() >= MAX_BLOCK_TOKENS) {
+                        writeBlock(writer, tokens.data(), tokens.size(), data + blockStart, pos - blockStart, false);
+                        tokens.clear();
+                        block = Histogram();
+                        blockStart = chunkStart = pos;
+                        chunkFirstToken = 0;
+                    }
+                };
+
+                while (pos < n) {
+                    insertUpTo(pos);
+                    size_t distance = 0;
+                    size_t length = chain.findLongestMatch(source, pos, MAX_MATCH, distance);
+
+                    while (lazy && length > 0 && length < niceLength && pos + 1 < n) {
+                        insertUpTo(pos + 1);
+                        size_t nextDistance = 0;
+                        size_t nextLength = chain.findLongestMatch(source, pos + 1, MAX_MATCH, nextDistance);
+                        if (nextLength <= length) break;
+
+                        tokens.push_back({(uint8_t)data[pos], 0});
+                        chunk.add(tokens.back());
+                        ++pos;
+                        length = nextLength;
+                        distance = nextDistance;
+                    }
+
+                    if (length >= MIN_MATCH) {
+                        tokens.push_back({(uint16_t)length, (uint16_t)distance});
+                        pos += length;
+                    } else {
+                        tokens.push_back({(uint8_t)data[pos], 0});
+                        ++pos;
+                    }
+                    chunk.add(tokens.back());
+
+                    if (tokens.size() - chunkFirstToken >= SPLIT_INTERVAL) {
+                        endChunk();
+                    }
+                }
+
+                block.merge(chunk);
+                writeBlock(writer, tokens.data(), tokens.size(), data + blockStart, n - blockStart, true);
+            }
+
+            writer.alignToByte();
+            writeTrailer(out, wrapper, input);
+            return out;
+        }
+    }
+
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params, Wrapper wrapper) {
+        return deflate(std::string_view(), input, params, wrapper);
+    }
+
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params, std::string_view dictionary) {
+        return deflate(dictionary, input, params, Wrapper::Raw);
+    }
+
+    LIBCOMPRA_API std::string decompress(std::string_view input, Wrapper wrapper) {
+        Inflater inflater(wrapper);
+        std::string output;
+        output.reserve(input.size() * 3);
+
+        if (!inflater.update(input.data(), input.size(), output)) {
+            throw std::runtime_error("Truncated Deflate input");
+        }
+        if (inflater.trailingBytes() > 0) {
+            throw std::runtime_error("Trailing data after Deflate stream");
+        }
+        return output;
+    }
+
+    LIBCOMPRA_API std::string decompress(std::string_view input, std::string_view dictionary) {
+        Inflater inflater;
+        inflater.setDictionary(dictionary);
+        std::string output;
+        output.reserve(input.size() * 3);
+
+        if (!inflater.update(input.data(), input.size(), output)) {
+            throw std::runtime_error("Truncated Deflate input");
+        }
+        if (inflater.trailingBytes() > 0) {
+            throw std::runtime_error("Trailing data after Deflate stream");
+        }
+        return output;
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        // Stored blocks at every split point and every 64 KiB, plus the largest (gzip) wrapper.
+        return inputSize + 5 * (inputSize / SPLIT_INTERVAL + inputSize / MAX_STORED_SIZE + 2) + 32;
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, Wrapper wrapper, int level) {
+        return guarded(Error::InputTooLarge, [&] {
+            return writeOutput(compress(asView(input), wrapper, level), output);
+        });
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params, Wrapper wrapper) {
+        return guarded(Error::InputTooLarge, [&] {
+            return writeOutput(compress(asView(input), params, wrapper), output);
+        });
+    }
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output, Wrapper wrapper) {
+        return guarded(Error::InvalidInput, [&]() -> Result {
+            // Feed the stream in slices so a stream that overruns the buffer is caught early.
+            constexpr size_t SLICE = 16 * 1024;
+            Inflater inflater(wrapper);
+            std::string chunk;
+            size_t fed = 0;
+            size_t op = 0;
+
+            while (!inflater.finished() && fed < input.size) {
+                size_t size = std::min(SLICE, input.size - fed);
+                inflater.update((const char*)input.data + fed, size, chunk);
+                fed += size;
+                if (chunk.size() > output.size - op) {
+                    return {0, Error::OutputTooSmall};
+                }
+                if (!chunk.empty()) {
+                    std::memcpy(output.data + op, chunk.data(), chunk.size());
+                }
+                op += chunk.size();
+                chunk.clear();
+            }
+
+            if (!inflater.finished() || inflater.trailingBytes() > 0 || fed < input.size) {
+                return {0, Error::InvalidInput};
+            }
+            return {op, Error::None};
+        });
+    }
+}
+
+namespace LZ4 {
+    namespace {
+        constexpr size_t MIN_MATCH = 4;
+        constexpr size_t LAST_LITERALS = 5;
+        constexpr size_t MF_LIMIT = 12;
+        constexpr size_t MAX_DISTANCE = 65535;
+        constexpr size_t HASH_LOG = 12;
+        constexpr size_t SKIP_TRIGGER = 6;
+        constexpr size_t MAX_INPUT_SIZE = 0x7E000000;
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {16, 12, 1, 4, 0, Strategy::Greedy},
+            {16, 14, 1, 4, 0, Strategy::Greedy},
+            {16, 16, 4, 4, 64, Strategy::Lazy},
+            {16, 16, 8, 4, 128, Strategy::Lazy},
+            {16, 16, 16, 4, 256, Strategy::Lazy},
+            {16, 16, 32, 4, 512, Strategy::Lazy},
+            {16, 16, 64, 4, 1024, Strategy::Lazy},
+            {16, 16, 256, 4, 4096, Strategy::Lazy},
+            {16, 17, 1024, 4, 65536, Strategy::Lazy}};
+
+        inline size_t hashPosition(const char* p, size_t hashLog) {
+            return (read32(p) * 2654435761u) >> (32 - hashLog);
+        }
+
+        inline char* writeLength(char* op, size_t length) {
+            for (; length >= 255; length -= 255) {
+                *op++ = (char)255;
+            }
+            *op++ = (char)length;
+            return op;
+        }
+
+        char* writeSequence(char* op, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+            char* token = op++;
+            size_t matchCode = matchLength - MIN_MATCH;
+            unsigned char tokenValue = (unsigned char)((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15));
+
+            if (literalLength >= 15) {
+                op = writeLength(op, literalLength - 15);
+            }
+            std::memcpy(op, literals, literalLength);
+            op += literalLength;
+
+            *op++ = (char)(offset & 0xFF);
+            *op++ = (char)(offset >> 8);
+
+            if (matchCode >= 15) {
+                op = writeLength(op, matchCode - 15);
+            }
+
+            *token = (char)tokenValue;
+            return op;
+        }
+
+        char* writeLastLiterals(char* op, const char* literals, size_t literalLength) {
+            *op++ = (char)(std::min<size_t>(literalLength, 15) << 4);
+            if (literalLength >= 15) {
+                op = writeLength(op, literalLength - 15);
+            }
+            std::memcpy(op, literals, literalLength);
+            return op + literalLength;
+        }
+
+        size_t compressBlock(const char* src, size_t srcSize, char* dst, size_t hashLog = HASH_LOG) {
+            char* op = dst;
+            size_t anchor = 0;
+
+            if (srcSize >= MF_LIMIT + 1) {
+                std::vector<uint32_t> table(size_t(1) << hashLog, 0);
+                size_t mfLimit = srcSize - MF_LIMIT;
+                size_t matchLimit = srcSize - LAST_LITERALS;
+                size_t ip = 1;
+
+                while (true) {
+                    size_t forward = ip;
+                    size_t searchCount = size_t(1) << SKIP_TRIGGER;
+                    size_t ref;
+
+                    do {
+                        ip = forward;
+                        forward = ip + (searchCount++ >> SKIP_TRIGGER);
+                        if (forward > mfLimit) goto lastLiterals;
+
+                        size_t h = hashPosition(src + ip, hashLog);
+                        ref = table[h];
+                        table[h] = (uint32_t)ip;
+                    } while (ip - ref > MAX_DISTANCE || read32(src + ref) != read32(src + ip));
+
+                    while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                        --ip;
+                        --ref;
+                    }
+
+                    size_t matchLength = MIN_MATCH + countMatch(src + ref + MIN_MATCH, src + ip + MIN_MATCH, matchLimit - ip - MIN_MATCH);
+                    op = writeSequence(op, src + anchor, ip - anchor, ip - ref, matchLength);
+
+                    ip += matchLength;
+                    anchor = ip;
+                    if (ip > mfLimit) break;
+
+                    table[hashPosition(src + ip - 2, hashLog)] = (uint32_t)(ip - 2);
+                }
+            }
+
+        lastLiterals:
+            op = writeLastLiterals(op, src + anchor, srcSize - anchor);
+            return op - dst;
+        }
+
+        // Decodes into a fixed buffer; matches use wildcopy only while WILDCOPY_SLACK bytes of room remain.
+        Result decompressBlock(const unsigned char* ip, size_t size, uint8_t* dst, size_t capacity) {
+            const unsigned char* iend = ip + size;
+            size_t op = 0;
+
+            auto readLength = [&](size_t& length) {
+                unsigned char byte;
+                do {
+                    if (ip >= iend) return false;
+                    byte = *ip++;
+                    length += byte;
+                } while (byte == 255);
+                return true;
+            };
+
+            while (ip < iend) {
+                unsigned char token = *ip++;
+
+                size_t literalLength = token >> 4;
+                if (literalLength == 15 && !readLength(literalLength)) {
+                    return {0, Error::InvalidInput};
+                }
+                if (literalLength > (size_t)(iend - ip)) {
+                    return {0, Error::InvalidInput};
+                }
+                if (literalLength > capacity - op) {
+                    return {0, Error::OutputTooSmall};
+                }
+
+                std::memcpy(dst + op, ip, literalLength);
+                ip += literalLength;
+                op += literalLength;
+
+                if (ip == iend) break;
+
+                if (iend - ip < 2) {
+                    return {0, Error::InvalidInput};
+                }
+                size_t offset = ip[0] | (ip[1] << 8);
+                ip += 2;
+                if (offset == 0 || offset > op) {
+                    return {0, Error::InvalidInput};
+                }
+
+                size_t matchLength = token & 15;
+                if (matchLength == 15 && !readLength(matchLength)) {
+                    return {0, Error::InvalidInput};
+                }
+                matchLength += MIN_MATCH;
+                if (matchLength > capacity - op) {
+                    return {0, Error::OutputTooSmall};
+                }
+
+                if (capacity - op >= matchLength + WILDCOPY_SLACK) {
+                    copyMatch((char*)dst + op, offset, matchLength);
+                } else {
+                    for (size_t i = 0; i < matchLength; ++i) {
+                        dst[op + i] = dst[op + i - offset];
+                    }
+                }
+                op += matchLength;
+            }
+
+            return {op, Error::None};
+        }
+        size_t compressHCBlock(std::string_view input, char* dst, size_t depth, bool lazy, size_t hashLog, size_t niceLength) {
+            size_t inputSize = input.size();
+            const char* src = input.data();
+            char* op = dst;
+            size_t anchor = 0;
+
+            if (inputSize >= MF_LIMIT + 1) {
+                LZ77::HashChain chain(MAX_DISTANCE, depth, MIN_MATCH, hashLog, niceLength);
+                size_t mfLimit = inputSize - MF_LIMIT;
+                size_t matchLimit = inputSize - LAST_LITERALS;
+                size_t nextInsert = 0;
+                size_t ip = 0;
+
+                auto insertUpTo = [&](size_t target) {
+                    for (; nextInsert < target; ++nextInsert) {
+                        chain.insert(input, nextInsert);
+                    }
+                };
+
+                while (ip <= mfLimit) {
+                    insertUpTo(ip);
+
+                    size_t offset = 0;
+                    size_t matchLength = chain.findLongestMatch(input, ip, matchLimit - ip, offset);
+                    if (matchLength < MIN_MATCH) {
+                        ++ip;
+                        continue;
+                    }
+
+                    while (lazy && ip + 1 <= mfLimit) {
+                        insertUpTo(ip + 1);
+
+                        size_t nextOffset = 0;
+                        size_t nextLength = chain.findLongestMatch(input, ip + 1, matchLimit - ip - 1, nextOffset);
+                        if (nextLength <= matchLength) break;
+
+                        ++ip;
+                        matchLength = nextLength;
+                        offset = nextOffset;
+                    }
+
+                    while (ip > anchor && ip > offset && src[ip - 1] == src[ip - 1 - offset]) {
+                        --ip;
+                        ++matchLength;
+                    }
+
+                    op = writeSequence(op, src + anchor, ip - anchor, offset, matchLength);
+                    ip += matchLength;
+                    anchor = ip;
+                }
+            }
+
+            op = writeLastLiterals(op, src + anchor, inputSize - anchor);
+            return op - dst;
+        }
+
+        // A search depth of 1 is the single-probe fast path; deeper searches use the HC parser.
+        size_t compressWith(std::string_view input, char* dst, const Params& params) {
+            size_t hashLog = std::clamp<uint32_t>(params.hashLog, 10, 20);
+            if (params.searchDepth <= 1) {
+                return compressBlock(input.data(), input.size(), dst, hashLog);
+            }
+            return compressHCBlock(input, dst, params.searchDepth, params.strategy != Strategy::Greedy, hashLog, std::max<uint32_t>(params.niceLength, MIN_MATCH));
+        }
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        return inputSize + inputSize / 255 + 16;
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        if (input.size > MAX_INPUT_SIZE) {
+            return {0, Error::InputTooLarge};
+        }
+
+        size_t bound = compressBound(input.size);
+        if (output.size >= bound) {
+            return {compressBlock((const char*)input.data, input.size, (char*)output.data), Error::None};
+        }
+
+        std::string staged(bound, '\0');
+        staged.resize(compressBlock((const char*)input.data, input.size, &staged[0]));
+        return writeOutput(staged, output);
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        if (input.size > MAX_INPUT_SIZE) {
+            return {0, Error::InputTooLarge};
+        }
+
+        size_t bound = compressBound(input.size);
+        if (output.size >= bound) {
+            return {compressWith(asView(input), (char*)output.data, params), Error::None};
+        }
+
+        std::string staged(bound, '\0');
+        staged.resize(compressWith(asView(input), &staged[0], params));
+        return writeOutput(staged, output);
+    }
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return decompressBlock(input.data, input.size, output.data, output.size);
+    }
+
+    LIBCOMPRA_API std::string compress(std::string_view input) {
+        if (input.size() > MAX_INPUT_SIZE) {
+            throw std::runtime_error("LZ4 input too large");
+        }
+
+        std::string output(compressBound(input.size()), '\0');
+        output.resize(compressBlock(input.data(), input.size(), &output[0]));
+        return output;
+    }
+
+    LIBCOMPRA_API std::string compressHC(std::string_view input, int level) {
+        if (input.size() > MAX_INPUT_SIZE) {
+            throw std::runtime_error("LZ4 input too large");
+        }
+
+        level = std::clamp(level, 1, 12);
+        std::string output(compressBound(input.size()), '\0');
+        output.resize(compressHCBlock(input, &output[0], size_t(1) << (level - 1), level >= 3, 16, MAX_INPUT_SIZE));
+        return output;
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
+
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params) {
+        if (input.size() > MAX_INPUT_SIZE) {
+            throw std::runtime_error("LZ4 input too large");
+        }
+
+        std::string output(compressBound(input.size()), '\0');
+        output.resize(compressWith(input, &output[0], params));
+        return output;
+    }
+
+    LIBCOMPRA_API std::string decompress(std::string_view input) {
+        std::string output(std::max<size_t>(input.size() * 3, 64), '\0');
+        const unsigned char* ip = (const unsigned char*)input.data();
+        const unsigned char* iend = ip + input.size();
+        size_t op = 0;
+
+        auto readLength = [&](size_t length) {
+            unsigned char byte;
+            do {
+                if (ip >= iend) throw std::runtime_error("Invalid LZ4 input");
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+            return length;
+        };
+        auto reserve = [&](size_t length) {
+            if (op + length + WILDCOPY_SLACK > output.size()) {
+                output.resize(std::max(output.size() * 2, op + length + WILDCOPY_SLACK));
+            }
+        };
+
+        while (ip < iend) {
+            unsigned char token = *ip++;
+
+            size_t literalLength = token >> 4;
+            if (literalLength == 15) {
+                literalLength = readLength(literalLength);
+            }
+            if (literalLength > (size_t)(iend - ip)) {
+                throw std::runtime_error("Invalid LZ4 input");
+            }
+
+            reserve(literalLength);
+            std::memcpy(&output[op], ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            if (ip == iend) break;
+
+            if (iend - ip < 2) {
+                throw std::runtime_error("Invalid LZ4 input");
+            }
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > op) {
+                throw std::runtime_error("Invalid LZ4 input");
+            }
+
+            size_t matchLength = token & 15;
+            if (matchLength == 15) {
+                matchLength = readLength(matchLength);
+            }
+            matchLength += MIN_MATCH;
+
+            reserve(matchLength);
+            copyMatch(&output[op], offset, matchLength);
+            op += matchLength;
+        }
+
+        output.resize(op);
+        return output;
+    }
+}
+
+namespace LZ5 {
+    LIBCOMPRA_API size_t findLongestMatch(std::string_view input, size_t pos, size_t maxOffset, size_t& matchOffset) {
+        size_t bestLength = 0;
+
+        size_t searchStart = (pos > maxOffset) ? pos - maxOffset : 0;
+        for (size_t i = searchStart; i < pos; ++i) {
+            size_t length = 0;
+            while (length < maxOffset && pos + length < input.size() && input[i + length] == input[pos + length]) {
+                ++length;
+            }
+
+            if (length > bestLength) {
+                bestLength = length;
+                matchOffset = pos - i;
+            }
+        }
+
+        return bestLength;
+    }
+
+    namespace {
+        constexpr size_t MIN_MATCH = 4;
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {14, 14, 4, 5, 32, Strategy::Greedy},
+            {15, 15, 8, 4, 64, Strategy::Greedy},
+            {15, 15, 16, 4, 128, Strategy::Greedy},
+            {15, 15, 16, 4, 128, Strategy::Lazy},
+            {15, 15, 32, 4, 256, Strategy::Lazy},
+            {16, 16, 64, 4, 512, Strategy::Lazy},
+            {16, 16, 128, 4, 1024, Strategy::Lazy2},
+            {17, 17, 256, 4, 4096, Strategy::Lazy2},
+            {18, 17, 1024, 4, 65536, Strategy::Lazy2}};
+
+        LZ77::HashChain strategyChain(size_t maxOffset, Strategy strategy) {
+            return LZ77::HashChain(maxOffset, strategy == Strategy::Greedy ? 16 : strategy == Strategy::Lazy ? 32 : 128, MIN_MATCH);
+        }
+
+        LZ77::HashChain paramsChain(const Params& params) {
+            return LZ77::HashChain(clampedLog(params.windowLog, 8, 24), std::max<uint32_t>(params.searchDepth, 1), params.minMatch, params.hashLog, std::max<uint32_t>(params.niceLength, 1));
+        }
+
+        inline size_t paramsMinLength(const Params& params) {
+            return std::max<uint32_t>(params.minMatch, 3);
+        }
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t maxOffset, Strategy strategy) {
+        LZ77::HashChain chain = strategyChain(maxOffset, strategy);
+        return parseTokens<Token>(input, chain, strategy, MIN_MATCH);
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params) {
+        LZ77::HashChain chain = paramsChain(params);
+        return parseTokens<Token>(input, chain, params.strategy, paramsMinLength(params));
+    }
+
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
+        return expandTokens(tokens, &Token::offset, "Invalid LZ5 token stream");
+    }
+
+    namespace Utils {
+        LIBCOMPRA_API std::string serializeToken(const Token& token) {
+            return std::to_string(token.offset) + "," + std::to_string(token.length) + "," + token.next;
+        }
+
+        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
+            std::string result;
+            for (const auto& token : tokens) {
+                result += serializeToken(token) + ";";
+            }
+            if (!result.empty()) {
+                result.pop_back();
+            }
+            return result;
+        }
+
+        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
+            size_t firstComma = str.find(',');
+            size_t secondComma = str.find(',', firstComma + 1);
+            size_t thirdComma = str.find(',', secondComma + 1);
+
+            size_t offset = std::stoull(str.substr(0, firstComma));
+            size_t length = std::stoull(str.substr(firstComma + 1, secondComma - firstComma - 1));
+            char next = (thirdComma != std::string::npos) ? str[thirdComma + 1] : '\0'; 
+
+            return {offset, length, next};
+        }
+
+        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
+            std::vector<Token> tokens;
+            size_t start = 0;
+            size_t end;
+
+            while ((end = str.find(';', start)) != std::string::npos) {
+                tokens.push_back(deserializeToken(str.substr(start, end - start)));
+                start = end + 1;
+            }
+
+            if (start < str.size()) {
+                tokens.push_back(deserializeToken(str.substr(start)));
+            }
+
+            return tokens;
+        }
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens) {
+            return encodeTokenStream(tokens, &Token::offset);
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size) {
+            return decodeTokenStream(data, size, &Token::offset, "Invalid LZ5 token stream");
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded) {
+            return decodeTokens((const uint8_t*)encoded.data(), encoded.size());
+        }
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        return inputSize * 3 + 10;
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&] {
+            // The offset and strategy compress(std::string_view) defaults to.
+            LZ77::HashChain chain = strategyChain(32 * 1024, Strategy::Lazy);
+            return writeTokenStream(output, &Token::offset, [&](auto&& emit) {
+                return parseTokens<Token>(asView(input), chain, Strategy::Lazy, MIN_MATCH, emit);
+            });
+        });
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        return guarded(Error::InputTooLarge, [&] {
+            LZ77::HashChain chain = paramsChain(params);
+            return writeTokenStream(output, &Token::offset, [&](auto&& emit) {
+                return parseTokens<Token>(asView(input), chain, params.strategy, paramsMinLength(params), emit);
+            });
+        });
+    }
+
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&] {
+            return replayTokens(Utils::decodeTokens(input.data, input.size), &Token::offset, output);
+        });
+    }
+}
+
+namespace LZW {
+    namespace {
+        constexpr uint32_t FIRST_CODE = 256;
+        constexpr uint32_t CLEAR_CODE = 256;
+        constexpr uint32_t MIN_CODE_WIDTH = 9;
+        constexpr uint32_t MAX_CODE_WIDTH = 20;
+        constexpr uint32_t EMPTY_SLOT = 0;
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {12, 0, 0, 0, 0, Strategy::Greedy},
+            {13, 0, 0, 0, 0, Strategy::Greedy},
+            {14, 0, 0, 0, 0, Strategy::Greedy},
+            {15, 0, 0, 0, 0, Strategy::Greedy},
+            {16, 0, 0, 0, 0, Strategy::Greedy},
+            {16, 0, 0, 0, 0, Strategy::Greedy},
+            {17, 0, 0, 0, 0, Strategy::Greedy},
+            {18, 0, 0, 0, 0, Strategy::Greedy},
+            {20, 0, 0, 0, 0, Strategy::Greedy}};
+
+        void checkCodeWidth(uint32_t maxCodeWidth) {
+            if (maxCodeWidth < MIN_CODE_WIDTH || maxCodeWidth > MAX_CODE_WIDTH) {
+                throw std::runtime_error("LZW code width must be between 9 and 20 bits");
+            }
+        }
+
+        inline uint32_t slotOf(uint32_t key, uint32_t hashLog) {
+            return (key * 2654435761u) >> (32 - hashLog);
+        }
+
+        inline uint32_t paramsCodeWidth(const Params& params) {
+            return std::clamp(params.windowLog, MIN_CODE_WIDTH, MAX_CODE_WIDTH);
+        }
+
+        // Bits needed for the largest code the other side could see next.
+        inline uint32_t codeWidth(uint32_t largestCode) {
+            return std::max<uint32_t>(MIN_CODE_WIDTH, highBit32(largestCode) + 1);
+        }
+
+        // Decoder side of the dictionary: entries are (prefix code, last byte, length) and are
+        // written back to front straight into the output. Each entry is added one code later
+        // than on the encoder side, once the first byte of the following string is known.
+        struct EntryTable {
+            uint32_t firstCode;
+            uint32_t limit;
+            uint32_t nextCode;
+            std::vector<uint32_t> prefixes;
+            std::vector<uint32_t> lengths;
+            std::vector<uint8_t> bytes;
+            std::vector<uint8_t> firsts;
+
+            EntryTable(uint32_t maxCodeWidth, uint32_t firstCode)
+                : firstCode(firstCode), limit(uint32_t(1) << maxCodeWidth), nextCode(firstCode),
+                  prefixes(limit), lengths(limit, 1), bytes(limit), firsts(limit) {
+                for (uint32_t c = 0; c < 256; ++c) {
+                    bytes[c] = firsts[c] = (uint8_t)c;
+                }
+            }
+
+            // Length of the string for code, which may be the entry previous is about to add.
+            size_t length(uint32_t code, uint32_t previous) const {
+                if (code == nextCode && nextCode < limit) {
+                    return lengths[previous] + 1;
+                }
+                if (code >= nextCode || (code >= 256 && code < firstCode)) {
+                    throw std::runtime_error("Invalid LZW decompression input");
+                }
+                return lengths[code];
+            }
+
+            uint8_t first(uint32_t code, uint32_t previous) const {
+                return firsts[code == nextCode ? previous : code];
+            }
+
+            // Writes the string for a code length() accepted to dst.
+            void expand(uint32_t code, uint32_t previous, uint8_t* dst) const {
+                size_t pos = length(code, previous);
+                if (code == nextCode) {
+                    dst[--pos] = firsts[previous];
+                    code = previous;
+                }
+                for (; pos-- > 0; code = prefixes[code]) {
+                    dst[pos] = bytes[code];
+                }
+            }
+
+            void add(uint32_t previous, uint8_t byte) {
+                if (nextCode == limit) return;
+                prefixes[nextCode] = previous;
+                bytes[nextCode] = byte;
+                firsts[nextCode] = firsts[previous];
+                lengths[nextCode] = lengths[previous] + 1;
+                ++nextCode;
+            }
+        };
+
+        // Writes the string for code at op unless output is already full or fills here, in which
+        // case full is set and the decode carries on counting; returns the op after it.
+        template <typename Output>
+        size_t expandCode(EntryTable& table, uint32_t code, uint32_t previous, Output& output, size_t op, bool& full) {
+            size_t length = table.length(code, previous);
+            full = full || !output.reserve(op, length);
+            if (!full) {
+                table.expand(code, previous, output.data + op);
+            }
+            table.add(previous, table.first(code, previous));
+            return op + length;
+        }
+
+        template <typename Output>
+        size_t writeByte(uint8_t byte, Output& output, size_t op, bool& full) {
+            full = full || !output.reserve(op, 1);
+            if (!full) {
+                output.data[op] = byte;
+            }
+            return op + 1;
+        }
+
+        // Returns the payload's bit length, or NIL once it outgrew the buffer.
+        size_t packCodes(std::string_view input, uint32_t maxCodeWidth, ByteWriter& out) {
+            Dictionary dictionary(maxCodeWidth, FullPolicy::Freeze, CLEAR_CODE + 1);
+            uint32_t limit = uint32_t(1) << maxCodeWidth;
+            SpanBitWriter writer(out);
+
+            if (!input.empty()) {
+                uint32_t prefix = (uint8_t)input[0];
+                for (size_t i = 1; i < input.size(); ++i) {
+                    uint8_t byte = (uint8_t)input[i];
+                    int code = dictionary.find(prefix, byte);
+                    if (code >= 0) {
+                        prefix = (uint32_t)code;
+                        continue;
+                    }
+
+                    writer.write(prefix, codeWidth(dictionary.nextCode - 1));
+                    if (writer.overflow) return NIL;
+                    if (dictionary.nextCode == limit) {
+                        writer.write(CLEAR_CODE, codeWidth(limit - 1));
+                        dictionary.reset();
+                    } else {
+                        dictionary.add(prefix, byte);
+                    }
+                    prefix = byte;
+                }
+                writer.write(prefix, codeWidth(dictionary.nextCode - 1));
+            }
+
+            return writer.finish() ? writer.bitLength : NIL;
+        }
+
+        bool compressInto(std::string_view input, uint32_t maxCodeWidth, ByteWriter& out) {
+            checkCodeWidth(maxCodeWidth);
+            return out.byte((uint8_t)maxCodeWidth) && writeVarintPrefixed(out, [&]() -> uint64_t {
+                return packCodes(input, maxCodeWidth, out);
+            });
+        }
+
+        template <typename Output>
+        Result decompressInto(std::string_view input, Output& output) {
+            ByteReader reader((const unsigned char*)input.data(), input.size(), "Invalid LZW decompression input");
+            uint32_t maxCodeWidth = reader.byte();
+            checkCodeWidth(maxCodeWidth);
+            size_t bitLength = reader.varint();
+            if ((bitLength + 7) / 8 != reader.remaining()) {
+                throw std::runtime_error("Invalid LZW decompression input");
+            }
+
+            EntryTable table(maxCodeWidth, CLEAR_CODE + 1);
+            BitIO::BitReader bits(reader.ip, reader.remaining());
+            size_t op = 0;
+            bool full = false;
+            bool restart = true;
+            uint32_t previous = 0;
+
+            // The decoder lags the encoder by one entry, so its next code is the largest it can receive.
+            while (bits.consumedBits() < bitLength) {
+                size_t width = codeWidth(restart ? CLEAR_CODE : std::min(table.nextCode, table.limit - 1));
+                if (bits.consumedBits() + width > bitLength) {
+                    throw std::runtime_error("Invalid LZW decompression input");
+                }
+
+                uint32_t code = (uint32_t)bits.read(width);
+                if (code == CLEAR_CODE) {
+                    table.nextCode = table.firstCode;
+                    restart = true;
+                    continue;
+                }
+                if (restart) {
+                    if (code >= 256) throw std::runtime_error("Invalid LZW decompression input");
+                    op = writeByte((uint8_t)code, output, op, full);
+                    restart = false;
+                } else {
+                    op = expandCode(table, code, previous, output, op, full);
+                }
+                previous = code;
+            }
+
+            return {op, full ? Error::OutputTooSmall : Error::None};
+        }
+    }
+
+    LIBCOMPRA_API Dictionary::Dictionary(uint32_t maxCodeWidth, FullPolicy policy, uint32_t firstCode)
+        : maxCodeWidth(maxCodeWidth), policy(policy), firstCode(firstCode), nextCode(firstCode), hashLog(maxCodeWidth + 1) {
+        checkCodeWidth(maxCodeWidth);
+        keys.assign(size_t(1) << hashLog, 0);
+        codes.assign(size_t(1) << hashLog, EMPTY_SLOT);
+    }
+
+    LIBCOMPRA_API int Dictionary::find(uint32_t prefix, uint8_t byte) const {
+        uint32_t key = (prefix << 8) | byte;
+        uint32_t mask = (uint32_t(1) << hashLog) - 1;
+        for (uint32_t slot = slotOf(key, hashLog); codes[slot] != EMPTY_SLOT; slot = (slot + 1) & mask) {
+            if (keys[slot] == key) {
+                return (int)codes[slot];
+            }
+        }
+        return -1;
+    }
+
+    LIBCOMPRA_API void Dictionary::add(uint32_t prefix, uint8_t byte) {
+        uint32_t limit = uint32_t(1) << maxCodeWidth;
+        if (nextCode == limit) return;
+
+        // The table has twice as many slots as codes, so probing always reaches an empty slot.
+        uint32_t key = (prefix << 8) | byte;
+        uint32_t mask = (uint32_t(1) << hashLog) - 1;
+        uint32_t slot = slotOf(key, hashLog);
+        while (codes[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        keys[slot] = key;
+        codes[slot] = nextCode++;
+
+        if (nextCode == limit && policy == FullPolicy::Reset) {
+            reset();
+        }
+    }
+
+    LIBCOMPRA_API void Dictionary::reset() {
+        std::fill(codes.begin(), codes.end(), EMPTY_SLOT);
+        nextCode = firstCode;
+    }
+
+    LIBCOMPRA_API std::vector<int> compress(std::string_view input, uint32_t maxCodeWidth, FullPolicy policy) {
+        Dictionary dictionary(maxCodeWidth, policy);
+        std::vector<int> result;
+        if (input.empty()) return result;
+
+        uint32_t prefix = (uint8_t)input[0];
+        for (size_t i = 1; i < input.size(); ++i) {
+            uint8_t byte = (uint8_t)input[i];
+            int code = dictionary.find(prefix, byte);
+            if (code >= 0) {
+                prefix = (uint32_t)code;
+                continue;
+            }
+
+            result.push_back((int)prefix);
+            dictionary.add(prefix, byte);
+            prefix = byte;
+        }
+        result.push_back((int)prefix);
+
+        return result;
+    }
+
+    LIBCOMPRA_API std::string decompress(const std::vector<int>& input, uint32_t maxCodeWidth, FullPolicy policy) {
+        checkCodeWidth(maxCodeWidth);
+        EntryTable table(maxCodeWidth, FIRST_CODE);
+        std::string output(std::max<size_t>(input.size() * 3, 64), '\0');
+        GrowingOutput sink(output);
+        size_t op = 0;
+        bool full = false;
+        uint32_t previous = 0;
+
+        for (size_t i = 0; i < input.size(); ++i) {
+            uint32_t code = (uint32_t)input[i];
+            if (input[i] < 0 || (i == 0 && code >= FIRST_CODE)) {
+                throw std::runtime_error("Invalid LZW decompression input");
+            }
+            if (i == 0) {
+                op = writeByte((uint8_t)code, sink, op, full);
+            } else {
+                op = expandCode(table, code, previous, sink, op, full);
+                if (table.nextCode == table.limit && policy == FullPolicy::Reset) {
+                    table.nextCode = FIRST_CODE;
+                }
+            }
+            previous = code;
+        }
+
+        output.resize(op);
+        return output;
+    }
+
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, uint32_t maxCodeWidth) {
+        std::string output(compressBound(input.size()), '\0');
+        ByteWriter out({(uint8_t*)&output[0], output.size()});
+        compressInto(input, maxCodeWidth, out);
+        output.resize(out.written());
+        return output;
+    }
+
+    LIBCOMPRA_API std::string decompressPacked(std::string_view input) {
+        std::string output(std::max<size_t>(input.size() * 3, 64), '\0');
+        GrowingOutput sink(output);
+        output.resize(decompressInto(input, sink).size);
+        return output;
+    }
+
+    /* COMPATIBILITY */
+
+    LIBCOMPRA_API void addToDictionary(std::map<std::string, int>& dictionary, const std::string& key, int& code) {
+        dictionary[key] = code++;
+    }
+
+    LIBCOMPRA_API void compress(std::vector<int>& result, std::map<std::string, int>& dictionary, std::string_view input, int& code) {
+        std::string current;
+        for (char c : input) {
+            std::string next = current + c;
+            if (dictionary.count(next)) {
+                current = next;
+            } else {
+                result.push_back(dictionary[current]);
+                addToDictionary(dictionary, next, code);
+                current = std::string(1, c);
+            }
+        }
+
+        if (!current.empty()) {
+            result.push_back(dictionary[current]);
+        }
+    }
+
+    LIBCOMPRA_API void decompress(std::string& result, std::map<int, std::string>& dictionary, const std::vector<int>& input, int& code) {
+        std::string current = dictionary[input[0]];
+        result = current;
+
+        for (size_t i = 1; i < input.size(); ++i) {
+            std::string entry;
+            if (dictionary.count(input[i])) {
+                entry = dictionary[input[i]];
+            } else if (input[i] == code) {
+                entry = current + current[0];
+            } else {
+                throw std::runtime_error("Invalid LZW decompression input");
+            }
+
+            result += entry;
+            dictionary[code++] = current + entry[0];
+            current = entry;
+        }
+    }
+
+    LIBCOMPRA_API void compressOptimized(std::vector<int>& result, std::map<std::string, int>& dictionary, std::string_view input, int& code) {
+        std::string current;
+        for (char c : input) {
+            current += c;
+            if (dictionary.count(current) == 0) {
+                result.push_back(dictionary[current.substr(0, current.size() - 1)]);
+                addToDictionary(dictionary, current, code);
+                current = std::string(1, c);
+            }
+        }
+
+        if (!current.empty()) {
+            result.push_back(dictionary[current]);
+        }
+    }
+
+    LIBCOMPRA_API void decompressOptimized(std::string& result, std::map<int, std::string>& dictionary, const std::vector<int>& input, int& code) {
+        std::string current = dictionary[input[0]];
+        result = current;
+
+        for (size_t i = 1; i < input.size(); ++i) {
+            std::string entry;
+            if (dictionary.count(input[i])) {
+                entry = dictionary[input[i]];
+            } else if (input[i] == code) {
+                entry = current + current[0];
+            } else {
+                throw std::runtime_error("Invalid LZW decompression input");
+            }
+
+            result += entry;
+            dictionary[code++] = current + entry[0];
+            current = entry;
+        }
+    }
+
+    LIBCOMPRA_API std::vector<int> compressOptimized(std::string_view input) {
+        return compress(input);
+    }
+
+    LIBCOMPRA_API std::string decompressOptimized(const std::vector<int>& input) {
+        return decompress(input);
+    }
+
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
+
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, const Params& params) {
+        return compressPacked(input, paramsCodeWidth(params));
+    }
+
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        // At most one code per byte, plus a CLEAR each time the free codes run out (every 255
+        // codes at the narrowest width), at up to MAX_CODE_WIDTH bits each.
+        return ((inputSize + inputSize / 255 + 1) * MAX_CODE_WIDTH + 7) / 8 + 11;
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&] {
+            ByteWriter out(output);
+            // The code width compressPacked(std::string_view) defaults to.
+            return out.finish(compressInto(asView(input), 16, out));
+        });
+    }
+
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        return guarded(Error::InputTooLarge, [&] {
+            ByteWriter out(output);
+            return out.finish(compressInto(asView(input), paramsCodeWidth(params), out));
+        });
+    }
+
+    // Decodes into the caller's buffer; past its end the codes are only counted, so
+    // OutputTooSmall still reports the size that would fit.
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&] {
+            FixedOutput sink{output.data, output.size};
+            return decompressInto(asView(input), sink);
+        });
+    }
+}
+
+namespace LZO {
+    namespace {
+        constexpr size_t M2_MAX_OFFSET = 0x0800;
+        constexpr size_t M3_MAX_OFFSET = 0x4000;
+        constexpr size_t M4_MAX_OFFSET = 0xBFFF;
+        constexpr size_t M2_MAX_LENGTH = 8;
+        constexpr size_t M3_MAX_LENGTH = 33;
+        constexpr size_t M4_MAX_LENGTH = 9;
+        constexpr unsigned char M3_MARKER = 32;
+        constexpr unsigned char M4_MARKER = 16;
+        constexpr uint32_t DICTIONARY_LOG = 14;
+        constexpr size_t SKIP_SHIFT = 5;
+        // The search stops this far from the end; whatever remains goes out as literals.
+        constexpr size_t TAIL_LENGTH = 20;
+        constexpr size_t MAX_INPUT_SIZE = 0xFFFFFFFF;
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {16, 10, 1, 4, 0, Strategy::Greedy},
+            {16, 11, 1, 4, 0, Strategy::Greedy},
+            {16, 12, 1, 4, 0, Strategy::Greedy},
+            {16, 13, 1, 4, 0, Strategy::Greedy},
+            {16, 14, 1, 4, 0, Strategy::Greedy},
+            {16, 14, 1, 4, 0, Strategy::Greedy},
+            {16, 15, 1, 4, 0, Strategy::Greedy},
+            {16, 16, 1, 4, 0, Strategy::Greedy},
+            {16, 16, 1, 4, 0, Strategy::Greedy}};
+
+        inline size_t dictionaryIndex(const char* p, uint32_t dictionaryLog) {
+            return (read32(p) * 0x1824429du) >> (32 - dictionaryLog);
+        }
+
+        inline uint32_t dictionaryLog(const Params& params) {
+            return std::clamp<uint32_t>(params.hashLog, 8, 16);
+        }
+
+        // Long lengths: a zero byte per 255, then the remainder, which is never zero.
+        inline char* writeRun(char* op, size_t length) {
+            for (; length > 255; length -= 255) {
+                *op++ = 0;
+            }
+            *op++ = (char)length;
+            return op;
+        }
+
+        char* writeLiterals(char* op, const char* dst, const char* literals, size_t length) {
+            if (length == 0) return op;
+
+            if (op == dst && length <= 238) {
+                *op++ = (char)(17 + length);
+            } else if (length <= 3) {
+                // Up to three literals ride in the low bits of the previous match's second-to-last byte.
+                op[-2] |= (char)length;
+            } else if (length <= 18) {
+                *op++ = (char)(length - 3);
+            } else {
+                *op++ = 0;
+                op = writeRun(op, length - 18);
+            }
+            std::memcpy(op, literals, length);
+            return op + length;
+        }
+
+        char* writeMatch(char* op, size_t offset, size_t length) {
+            if (length <= M2_MAX_LENGTH && offset <= M2_MAX_OFFSET) {
+                offset -= 1;
+                *op++ = (char)(((length - 1) << 5) | ((offset & 7) << 2));
+                *op++ = (char)(offset >> 3);
+                return op;
+            }
+
+            unsigned char marker;
+            size_t maxLength;
+            if (offset <= M3_MAX_OFFSET) {
+                offset -= 1;
+                marker = M3_MARKER;
+                maxLength = M3_MAX_LENGTH;
+            } else {
+                offset -= M3_MAX_OFFSET;
+                marker = (unsigned char)(M4_MARKER | ((offset >> 11) & 8));
+                maxLength = M4_MAX_LENGTH;
+            }
+
+            if (length <= maxLength) {
+                *op++ = (char)(marker | (length - 2));
+            } else {
+                *op++ = (char)marker;
+                op = writeRun(op, length - maxLength);
+            }
+            *op++ = (char)(offset << 2);
+            *op++ = (char)(offset >> 6);
+            return op;
+        }
+
+        size_t compress1XBlock(const char* src, size_t srcSize, char* dst, uint32_t dictionaryLog = DICTIONARY_LOG) {
+            char* op = dst;
+            size_t anchor = 0;
+
+            if (srcSize > TAIL_LENGTH) {
+                std::vector<uint32_t> dictionary(size_t(1) << dictionaryLog, 0);
+                size_t limit = srcSize - TAIL_LENGTH;
+                size_t ip = 1;
+
+                while (ip < limit) {
+                    size_t h = dictionaryIndex(src + ip, dictionaryLog);
+                    size_t ref = dictionary[h];
+                    dictionary[h] = (uint32_t)ip;
+
+                    if (ip - ref > M4_MAX_OFFSET || read32(src + ref) != read32(src + ip)) {
+                        ip += 1 + ((ip - anchor) >> SKIP_SHIFT);
+                        continue;
+                    }
+
+                    size_t length = 4 + countMatch(src + ref + 4, src + ip + 4, srcSize - ip - 4);
+                    op = writeLiterals(op, dst, src + anchor, ip - anchor);
+                    op = writeMatch(op, ip - ref, length);
+                    ip += length;
+                    anchor = ip;
+                }
+            }
+
+            op = writeLiterals(op, dst, src + anchor, srcSize - anchor);
+            *op++ = (char)(M4_MARKER | 1);
+            *op++ = 0;
+            *op++ = 0;
+            return op - dst;
+        }
+
+        // The instruction byte and the number of literals trailing the previous instruction
+        // (the state: 0-3 after a match, 4 after a literal run) select the opcode.
+        template <typename Output>
+        Result decompress1XBlock(const unsigned char* ip, size_t size, Output& output) {
+            const unsigned char* iend = ip + size;
+            size_t op = 0;
+            size_t state = 0;
+
+            auto readRun = [&](size_t& length, size_t base) {
+                while (ip < iend && *ip == 0) {
+                    base += 255;
+                    ++ip;
+                }
+                if (ip >= iend) return false;
+                length = base + *ip++;
+                return true;
+            };
+            auto copyLiterals = [&](size_t length) {
+                if (length == 0) return Error::None;
+                if (length > (size_t)(iend - ip)) return Error::InvalidInput;
+                if (!output.reserve(op, length)) return Error::OutputTooSmall;
+                std::memcpy(output.data + op, ip, length);
+                ip += length;
+                op += length;
+                return Error::None;
+            };
+
+            if (ip < iend && *ip > 17) {
+                size_t length = *ip++ - 17;
+                Error error = copyLiterals(length);
+                if (error != Error::None) return {0, error};
+                state = std::min<size_t>(length, 4);
+            }
+
+            while (true) {
+                if (ip >= iend) return {0, Error::InvalidInput};
+                size_t t = *ip++;
+                size_t length, distance, trailing;
+
+                if (t >= 64) {
+                    if (ip >= iend) return {0, Error::InvalidInput};
+                    length = (t >> 5) + 1;
+                    distance = ((t >> 2) & 7) + ((size_t)*ip++ << 3) + 1;
+                    trailing = t & 3;
+                } else if (t >= 16) {
+                    bool m3 = t >= 32;
+                    length = m3 ? t & 31 : t & 7;
+                    if (length == 0 && !readRun(length, m3 ? 31 : 7)) return {0, Error::InvalidInput};
+                    length += 2;
+                    if (iend - ip < 2) return {0, Error::InvalidInput};
+                    size_t word = ip[0] | (ip[1] << 8);
+                    ip += 2;
+                    trailing = word & 3;
+                    if (m3) {
+                        distance = (word >> 2) + 1;
+                    } else {
+                        distance = ((t & 8) << 11) + (word >> 2);
+                        if (distance == 0) {
+                            if (ip != iend) return {0, Error::InvalidInput};
+                            return {op, Error::None};
+                        }
+                        distance += M3_MAX_OFFSET;
+                    }
+                } else if (state == 0) {
+                    length = t;
+                    if (length == 0 && !readRun(length, 15)) return {0, Error::InvalidInput};
+                    Error error = copyLiterals(length + 3);
+                    if (error != Error::None) return {0, error};
+                    state = 4;
+                    continue;
+                } else {
+                    if (ip >= iend) return {0, Error::InvalidInput};
+                    length = state == 4 ? 3 : 2;
+                    distance = (t >> 2) + ((size_t)*ip++ << 2) + (state == 4 ? M2_MAX_OFFSET + 1 : 1);
+                    trailing = t & 3;
+                }
+
+                if (distance > op) return {0, Error::InvalidInput};
+                if (!output.reserve(op, length)) return {0, Error::OutputTooSmall};
+                writeMatch(output, op, distance, length);
+                op += length;
+
+                Error error = copyLiterals(trailing);
+                if (error != Error::None) return {0, error};
+                state = trailing;
+            }
+        }
+    }
+
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t windowSize) {
+        std::vector<Token> tokens;
+        size_t i = 0;
+
+        while (i < input.size()) {
+            size_t bestOffset = 0, bestLength = 0;
+            size_t searchStart = (i > windowSize) ? i - windowSize : 0;
+
+            for (size_t j = searchStart; j < i; ++j) {
+                size_t length = 0;
+                while (j + length < i && i + length < input.size() && input[j + length] == input[i + length]) {
+                    ++length;
+                }
+
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestOffset = i - j;
+                }
+            }
+
+            bestLength = std::min(bestLength, input.size() - i - 1);
+            if (bestLength == 0) {
+                bestOffset = 0;
+            }
+            tokens.push_back({bestOffset, bestLength, input[i + bestLength]});
+            i += bestLength + 1;
+        }
+
+        return tokens;
+    }
+
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
+        return expandTokens(tokens, &Token::offset, "Invalid LZO token stream");
     }
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens, size_t dictionarySize) {
-        std::string output;
+    LIBCOMPRA_API std::string compress1X(std::string_view input) {
+        if (input.size() > MAX_INPUT_SIZE) {
+            throw std::runtime_error("LZO input too large");
+        }
 
-        for (const auto& token : tokens) {
-            if (token.position > 0 && token.position <= output.size()) {
-                size_t start = output.size() - token.position;
-                for (size_t i = 0; i < token.length; ++i) {
-                    output += output[start + i];
-                }
-            }
-            if (token.next != '\0') {
-                output += token.next;
-            }
+        std::string output(compressBound(input.size()), '\0');
+        output.resize(compress1XBlock(input.data(), input.size(), &output[0]));
+        return output;
+    }
+
+    LIBCOMPRA_API std::string compress1X(std::string_view input, const Params& params) {
+        if (input.size() > MAX_INPUT_SIZE) {
+            throw std::runtime_error("LZO input too large");
         }
 
+        std::string output(compressBound(input.size()), '\0');
+        output.resize(compress1XBlock(input.data(), input.size(), &output[0], dictionaryLog(params)));
+        return output;
+    }
+
+    LIBCOMPRA_API std::string decompress1X(std::string_view input) {
+        std::string output(std::max<size_t>(input.size() * 3, 64), '\0');
+        GrowingOutput sink(output);
+        Result result = decompress1XBlock((const unsigned char*)input.data(), input.size(), sink);
+        if (!result.ok()) {
+            throw std::runtime_error("Invalid LZO input");
+        }
+        output.resize(result.size);
         return output;
     }
 
     namespace Utils {
         LIBCOMPRA_API std::string serializeToken(const Token& token) {
-            return std::to_string(token.position) + "," + std::to_string(token.length) + "," + token.next;
+            return std::to_string(token.offset) + "," + std::to_string(token.length) + "," + (token.next == '\0' ? "\\0" : std::string(1, token.next));
         }
 
         LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
@@ -264,1034 +4435,2105 @@ namespace LZMA {
             size_t firstComma = str.find(',');
             size_t secondComma = str.find(',', firstComma + 1);
             size_t thirdComma = str.find(',', secondComma + 1);
-            
-            size_t position = std::stoull(str.substr(0, firstComma));
+
+            size_t offset = std::stoull(str.substr(0, firstComma));
             size_t length = std::stoull(str.substr(firstComma + 1, secondComma - firstComma - 1));
-            char next = str[thirdComma + 1];
-            
-            return {position, length, next};
+
+            std::string nextStr = str.substr(thirdComma + 1);
+            char next = (nextStr == "\\0") ? '\0' : nextStr[0];
+
+            return {offset, length, next};
         }
 
         LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
             std::vector<Token> tokens;
             size_t start = 0;
             size_t end;
-            
+
             while ((end = str.find(';', start)) != std::string::npos) {
                 tokens.push_back(deserializeToken(str.substr(start, end - start)));
                 start = end + 1;
             }
-            
+
             if (start < str.size()) {
                 tokens.push_back(deserializeToken(str.substr(start)));
             }
-            
+
             return tokens;
         }
+
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens) {
+            return encodeTokenStream(tokens, &Token::offset);
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size) {
+            return decodeTokenStream(data, size, &Token::offset, "Invalid LZO token stream");
+        }
+
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded) {
+            return decodeTokens((const uint8_t*)encoded.data(), encoded.size());
+        }
     }
-}
 
-namespace Huffman {
-    LIBCOMPRA_API HuffmanNode::HuffmanNode(char data, int freq) {
-        this->data = data;
-        this->freq = freq;
-        left = right = nullptr;
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
     }
 
-    LIBCOMPRA_API bool HuffmanCompare::operator()(HuffmanNode* left, HuffmanNode* right) {
-        return left->freq > right->freq;
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        return inputSize + inputSize / 16 + 64 + 3;
     }
 
-    namespace Methods {
-        LIBCOMPRA_API HuffmanNode* BuildHuffmanTree(const Huffman::FreqMap& freqMap) {
-            std::priority_queue<HuffmanNode*, std::vector<HuffmanNode*>, HuffmanCompare> pq;
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        if (input.size > MAX_INPUT_SIZE) {
+            return {0, Error::InputTooLarge};
+        }
 
-            for (const auto& pair : freqMap) {
-                pq.push(new HuffmanNode(pair.first, pair.second));
-            }
+        size_t bound = compressBound(input.size);
+        if (output.size >= bound) {
+            return {compress1XBlock((const char*)input.data, input.size, (char*)output.data), Error::None};
+        }
 
-            while (pq.size() != 1) {
-                HuffmanNode *left = pq.top(); pq.pop();
-                HuffmanNode *right = pq.top(); pq.pop();
+        std::string staged(bound, '\0');
+        staged.resize(compress1XBlock((const char*)input.data, input.size, &staged[0]));
+        return writeOutput(staged, output);
+    }
 
-                int sum = left->freq + right->freq;
-                HuffmanNode* node = new HuffmanNode('\0', sum);
-                node->left = left;
-                node->right = right;
-                pq.push(node);
-            }
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        if (input.size > MAX_INPUT_SIZE) {
+            return {0, Error::InputTooLarge};
+        }
 
-            return pq.top();
+        size_t bound = compressBound(input.size);
+        if (output.size >= bound) {
+            return {compress1XBlock((const char*)input.data, input.size, (char*)output.data, dictionaryLog(params)), Error::None};
         }
 
-        LIBCOMPRA_API void GenerateCodes(HuffmanNode* node, const std::string& code, std::map<char, std::string>& huffmanCode) {
-            if (!node) return;
+        std::string staged(bound, '\0');
+        staged.resize(compress1XBlock((const char*)input.data, input.size, &staged[0], dictionaryLog(params)));
+        return writeOutput(staged, output);
+    }
 
-            if (!node->left && !node->right) {
-                huffmanCode[node->data] = code;
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        FixedOutput sink{output.data, output.size};
+        return decompress1XBlock(input.data, input.size, sink);
+    }
+}
+
+namespace LZSS {
+    LIBCOMPRA_API size_t findBestMatch(std::string_view input, size_t windowStart, size_t currentPos, size_t windowSize, size_t& bestOffset) {
+        size_t bestLength = 0;
+        bestOffset = 0;
+
+        for (size_t j = windowStart; j < currentPos; ++j) {
+            size_t length = 0;
+            while (j + length < currentPos && currentPos + length < input.size() && input[j + length] == input[currentPos + length]) {
+                ++length;
+                if (length >= windowSize) break;
             }
 
-            GenerateCodes(node->left, code + '0', huffmanCode);
-            GenerateCodes(node->right, code + '1', huffmanCode);
+            if (length > bestLength) {
+                bestLength = length;
+                bestOffset = currentPos - j;
+            }
         }
 
-        LIBCOMPRA_API void FreeTree(HuffmanNode* node) {
-            if (node == nullptr) return;
-            FreeTree(node->left);
-            FreeTree(node->right);
-            delete node;
-        }
+        return bestLength;
+    }
 
-        LIBCOMPRA_API Huffman::ByteVector PackBitsToBytes(const std::string& bitString) {
-            Huffman::ByteVector compressedData;
-            Huffman::Byte currentByte = 0;
-            int bitCount = 0;
+    LIBCOMPRA_API void addToken(std::vector<Token>& tokens, bool isLiteral, char literal, size_t offset, size_t length) {
+        tokens.push_back({isLiteral, literal, offset, length});
+    }
 
+    namespace {
+        constexpr size_t MIN_MATCH = 3;
+        constexpr uint32_t MAX_PAIR_BITS = 24;
+        constexpr size_t DEFAULT_DEPTH = 64;
+        constexpr uint32_t DEFAULT_HASH_LOG = 14;
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {10, 12, 4, 3, 18, Strategy::Greedy},
+            {11, 12, 8, 3, 18, Strategy::Greedy},
+            {12, 13, 16, 3, 18, Strategy::Greedy},
+            {12, 14, 32, 3, 18, Strategy::Greedy},
+            {12, 14, 48, 3, 18, Strategy::Greedy},
+            {12, 14, 64, 3, 18, Strategy::Greedy},
+            {14, 15, 128, 3, 66, Strategy::Greedy},
+            {15, 15, 256, 3, 514, Strategy::Greedy},
+            {16, 16, 1024, 3, 258, Strategy::Greedy}};
+
+        inline uint32_t bitsFor(size_t value) {
+            uint32_t bits = 0;
+            while (value >> bits) {
+                ++bits;
+            }
+            return bits;
+        }
 
-            for (char bit : bitString) {
-                currentByte <<= 1;
-                if (bit == '1') {
-                    currentByte |= 1;
+        // Greedy parse over a hash chain: emit(pos, offset, length) with length 0 for a literal.
+        // Stops with false as soon as emit does.
+        template <typename Emit>
+        bool parse(std::string_view input, LZ77::HashChain chain, size_t lookaheadSize, size_t minLength, Emit&& emit) {
+            size_t pos = 0;
+
+            while (pos < input.size()) {
+                size_t offset = 0;
+                size_t length = chain.findLongestMatch(input, pos, lookaheadSize, offset);
+                if (length < minLength) {
+                    length = 0;
                 }
-                bitCount++;
+                if (!emit(pos, offset, length)) return false;
 
-                if (bitCount == 8) {
-                    compressedData.push_back(currentByte);
-                    currentByte = 0;
-                    bitCount = 0;
+                for (size_t end = pos + std::max<size_t>(length, 1); pos < end; ++pos) {
+                    chain.insert(input, pos);
                 }
             }
+            return true;
+        }
 
-            if (bitCount > 0) {
-                currentByte <<= (8 - bitCount);
-                compressedData.push_back(currentByte);
+        void checkParameters(size_t windowSize, size_t lookaheadSize) {
+            if (windowSize == 0 || lookaheadSize < MIN_MATCH || bitsFor(windowSize - 1) + bitsFor(lookaheadSize - MIN_MATCH) > MAX_PAIR_BITS) {
+                throw std::runtime_error("LZSS window and lookahead must fit a 24-bit match");
             }
+        }
 
-            return compressedData;
+        LZ77::HashChain defaultChain(size_t windowSize) {
+            return LZ77::HashChain(windowSize, DEFAULT_DEPTH, MIN_MATCH, DEFAULT_HASH_LOG);
         }
 
-        LIBCOMPRA_API std::string UnpackBytesToBits(const Huffman::ByteVector& compressedData) {
-            std::string bitString;
+        // niceLength doubles as the lookahead; the window shrinks until the pair fits 24 bits.
+        size_t paramsLookahead(const Params& params) {
+            return std::clamp<size_t>(params.niceLength, MIN_MATCH, MIN_MATCH + 0xFFFF);
+        }
+
+        LZ77::HashChain paramsChain(const Params& params) {
+            uint32_t maxLog = MAX_PAIR_BITS - bitsFor(paramsLookahead(params) - MIN_MATCH);
+            size_t windowSize = clampedLog(params.windowLog, 0, maxLog);
+            return LZ77::HashChain(windowSize, std::max<uint32_t>(params.searchDepth, 1), MIN_MATCH, params.hashLog);
+        }
+
+        std::vector<Token> parseTokens(std::string_view input, LZ77::HashChain chain, size_t lookaheadSize) {
+            std::vector<Token> tokens;
 
-            for (Huffman::Byte byte : compressedData) {
-                for (int i = 7; i >= 0; --i) {
-                    bitString += (byte & (1 << i)) ? '1' : '0';
+            parse(input, std::move(chain), lookaheadSize, MIN_MATCH, [&](size_t pos, size_t offset, size_t length) {
+                if (length > 0) {
+                    addToken(tokens, false, '\0', offset, length);
+                } else {
+                    addToken(tokens, true, input[pos], 0, 0);
                 }
-            }
+                return true;
+            });
 
-            return bitString;
+            return tokens;
         }
+    }
 
-        LIBCOMPRA_API Huffman::ByteVector PackBitsToBytes(const std::string& bitString, size_t& bitLength) {
-            Huffman::ByteVector compressedData;
-            Huffman::Byte currentByte = 0;
-            int bitCount = 0;
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, size_t windowSize, size_t lookaheadSize) {
+        checkParameters(windowSize, lookaheadSize);
+        return parseTokens(input, defaultChain(windowSize), lookaheadSize);
+    }
 
-            bitLength = bitString.size();
+    LIBCOMPRA_API std::vector<Token> compress(std::string_view input, const Params& params) {
+        return parseTokens(input, paramsChain(params), paramsLookahead(params));
+    }
 
-            for (char bit : bitString) {
-                currentByte <<= 1;
-                if (bit == '1') {
-                    currentByte |= 1;
-                }
-                bitCount++;
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
 
-                if (bitCount == 8) {
-                    compressedData.push_back(currentByte);
-                    currentByte = 0;
-                    bitCount = 0;
-                }
+    namespace {
+        // Decoded size, or NIL if a match reaches before the output start.
+        size_t decodedSize(const std::vector<Token>& tokens) {
+            size_t total = 0;
+            for (const auto& token : tokens) {
+                size_t length = token.isLiteral ? 1 : token.length;
+                if (!token.isLiteral && (token.offset == 0 || token.offset > total)) return NIL;
+                if (length >= NIL - total) return NIL;
+                total += length;
             }
+            return total;
+        }
 
-            if (bitCount > 0) {
-                currentByte <<= (8 - bitCount);
-                compressedData.push_back(currentByte);
+        void expandTokens(const std::vector<Token>& tokens, char* dst, size_t capacity) {
+            char* op = dst;
+            char* end = dst + capacity;
+            for (const auto& token : tokens) {
+                if (token.isLiteral) {
+                    *op++ = token.literal;
+                } else if (token.length > 0 && (size_t)(end - op) >= token.length + WILDCOPY_SLACK) {
+                    copyMatch(op, token.offset, token.length);
+                    op += token.length;
+                } else {
+                    const char* match = op - token.offset;
+                    for (size_t i = 0; i < token.length; ++i) {
+                        op[i] = match[i];
+                    }
+                    op += token.length;
+                }
             }
+        }
+    }
 
-            return compressedData;
+    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
+        size_t total = decodedSize(tokens);
+        if (total == NIL) {
+            throw std::runtime_error("Invalid LZSS token stream");
         }
 
-        LIBCOMPRA_API std::string UnpackBytesToBits(const Huffman::ByteVector& compressedData, size_t bitLength) {
-            std::string bitString;
+        std::string output(total + WILDCOPY_SLACK, '\0');
+        expandTokens(tokens, &output[0], output.size());
+        output.resize(total);
+        return output;
+    }
 
-            for (Huffman::Byte byte : compressedData) {
-                for (int i = 7; i >= 0; --i) {
-                    bitString += (byte & (1 << i)) ? '1' : '0';
-                }
+    namespace {
+        bool packTokens(std::string_view input, LZ77::HashChain chain, size_t lookaheadSize, ByteWriter& out) {
+            uint32_t offsetBits = bitsFor(chain.windowSize - 1);
+            uint32_t lengthBits = bitsFor(lookaheadSize - MIN_MATCH);
+            size_t pairBytes = (offsetBits + lengthBits + 7) / 8;
+            if (!out.byte((uint8_t)offsetBits) || !out.byte((uint8_t)lengthBits)) {
+                return false;
             }
 
-            return bitString.substr(0, bitLength);
+            uint8_t* flags = nullptr;
+            size_t items = 8;
+            // A match is only worth a flag bit when it is longer than the pair that encodes it.
+            return parse(input, std::move(chain), lookaheadSize, std::max(MIN_MATCH, pairBytes + 1), [&](size_t pos, size_t offset, size_t length) {
+                if (items == 8) {
+                    flags = out.op;
+                    if (!out.byte(0)) return false;
+                    items = 0;
+                }
+                if (length > 0) {
+                    *flags |= (uint8_t)(1 << items);
+                    uint32_t pair = (uint32_t)((offset - 1) << lengthBits) | (uint32_t)(length - MIN_MATCH);
+                    uint8_t bytes[4];
+                    for (size_t b = 0; b < pairBytes; ++b) {
+                        bytes[b] = (uint8_t)(pair >> (8 * (pairBytes - 1 - b)));
+                    }
+                    if (!out.bytes(bytes, pairBytes)) return false;
+                } else if (!out.byte((uint8_t)input[pos])) {
+                    return false;
+                }
+                ++items;
+                return true;
+            });
         }
-    }
-
-    LIBCOMPRA_API Compressed compress(const std::string& text) {
-        Compressed compressed;
 
-        for (char ch : text) {
-            compressed.freqMap[ch]++;
+        std::string packTokens(std::string_view input, LZ77::HashChain chain, size_t lookaheadSize) {
+            std::string output(compressBound(input.size()), '\0');
+            ByteWriter out({(uint8_t*)&output[0], output.size()});
+            packTokens(input, std::move(chain), lookaheadSize, out);
+            output.resize(out.written());
+            return output;
         }
 
-        HuffmanNode* root = Methods::BuildHuffmanTree(compressed.freqMap);
-        
-        std::map<char, std::string> huffmanCode;
-        Methods::GenerateCodes(root, std::string(), huffmanCode);
+        // Flag bytes each lead eight items, set bits marking big-endian (offset, length) pairs.
+        // Past the end of a FixedOutput the items are only counted, so OutputTooSmall still
+        // reports the size that would fit.
+        template <typename Output>
+        Result unpackTokens(std::string_view input, Output& output) {
+            ByteReader reader((const unsigned char*)input.data(), input.size(), "Invalid LZSS input");
+            uint32_t offsetBits = reader.byte();
+            uint32_t lengthBits = reader.byte();
+            if (offsetBits + lengthBits > MAX_PAIR_BITS) {
+                throw std::runtime_error("Invalid LZSS input");
+            }
+            size_t pairBytes = (offsetBits + lengthBits + 7) / 8;
+            uint32_t lengthMask = (uint32_t(1) << lengthBits) - 1;
+
+            const unsigned char* ip = reader.ip;
+            const unsigned char* iend = reader.iend;
+            size_t op = 0;
+            bool full = false;
+
+            while (ip < iend) {
+                unsigned char flags = *ip++;
+                for (size_t item = 0; item < 8 && ip < iend; ++item) {
+                    if (!((flags >> item) & 1)) {
+                        full = full || !output.reserve(op, 1);
+                        if (!full) {
+                            output.data[op] = *ip;
+                        }
+                        ++ip;
+                        ++op;
+                        continue;
+                    }
+
+                    if ((size_t)(iend - ip) < pairBytes) {
+                        throw std::runtime_error("Invalid LZSS input");
+                    }
+                    uint32_t pair = 0;
+                    for (size_t b = 0; b < pairBytes; ++b) {
+                        pair = (pair << 8) | *ip++;
+                    }
+                    size_t offset = (pair >> lengthBits) + 1;
+                    size_t length = (pair & lengthMask) + MIN_MATCH;
+                    if (offset > op) {
+                        throw std::runtime_error("Invalid LZSS input");
+                    }
+                    full = full || !output.reserve(op, length);
+                    if (!full) {
+                        writeMatch(output, op, offset, length);
+                    }
+                    op += length;
+                }
+            }
 
-        std::string bitString;
-        for (char ch : text) {
-            bitString += huffmanCode[ch];
+            return {op, full ? Error::OutputTooSmall : Error::None};
         }
+    }
 
-        compressed.byteVec = Methods::PackBitsToBytes(bitString, compressed.bitLength);
-        Methods::FreeTree(root);
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, size_t windowSize, size_t lookaheadSize) {
+        checkParameters(windowSize, lookaheadSize);
+        return packTokens(input, defaultChain(windowSize), lookaheadSize);
+    }
 
-        return compressed;
+    LIBCOMPRA_API std::string compressPacked(std::string_view input, const Params& params) {
+        return packTokens(input, paramsChain(params), paramsLookahead(params));
     }
 
-    LIBCOMPRA_API std::string decompress(const ByteVector& compressed, const FreqMap& freqMap, size_t bitLength) {
-        HuffmanNode* root = Methods::BuildHuffmanTree(freqMap);
-        std::string result;
+    LIBCOMPRA_API std::string decompressPacked(std::string_view input) {
+        std::string output(std::max<size_t>(input.size() * 3, 64), '\0');
+        GrowingOutput sink(output);
+        output.resize(unpackTokens(input, sink).size);
+        return output;
+    }
 
-        std::string bitString = Methods::UnpackBytesToBits(compressed, bitLength);
-        HuffmanNode* current = root;
-        for (char bit : bitString) {
-            current = (bit == '0') ? current->left : current->right;
+    namespace Utils {
+        LIBCOMPRA_API std::string serializeToken(const Token& token) {
+            if (token.isLiteral) {
+                return std::to_string(token.isLiteral) + "," + std::string(1, token.literal) + ",0,0";
+            } else {
+                return std::to_string(token.isLiteral) + ",\0," + std::to_string(token.offset) + "," + std::to_string(token.length);
+            }
+        }
 
-            if (!current->left && !current->right) {
-                result += current->data;
-                current = root;
+        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
+            std::string result;
+            for (const auto& token : tokens) {
+                result += serializeToken(token) + ";";
+            }
+            if (!result.empty()) {
+                result.pop_back();
             }
+            return result;
         }
 
-        Methods::FreeTree(root);
-        return result;
-    }
+        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
+            size_t firstComma = str.find(',');
+            size_t secondComma = str.find(',', firstComma + 1);
+            size_t thirdComma = str.find(',', secondComma + 1);
+            size_t fourthComma = str.find(',', thirdComma + 1);
 
-    LIBCOMPRA_API std::string decompress(const Compressed& compressed) {
-        HuffmanNode* root = Methods::BuildHuffmanTree(compressed.freqMap);
-        std::string result;
-        
-        std::string bitString = Methods::UnpackBytesToBits(compressed.byteVec, compressed.bitLength);
-        HuffmanNode* current = root;
-        for (char bit : bitString) {
-            current = (bit == '0') ? current->left : current->right;
+            bool isLiteral = std::stoi(str.substr(0, firstComma));
+            char literal = str[secondComma + 1];
+            size_t offset = std::stoull(str.substr(thirdComma + 1, fourthComma - thirdComma - 1));
+            size_t length = std::stoull(str.substr(fourthComma + 1));
 
-            if (!current->left && !current->right) {
-                result += current->data;
-                current = root;
-            }
+            return {isLiteral, literal, offset, length};
         }
 
-        Methods::FreeTree(root);
-        return result;
-    }
+        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
+            std::vector<Token> tokens;
+            size_t start = 0;
+            size_t end;
 
-    /* COMPATIBILITY */
+            while ((end = str.find(';', start)) != std::string::npos) {
+                tokens.push_back(deserializeToken(str.substr(start, end - start)));
+                start = end + 1;
+            }
 
-    LIBCOMPRA_API Huffman::ByteVector compress(const std::string& text, FreqMap& freqMap, size_t& bitLength) {
-        for (char ch : text) {
-            freqMap[ch]++;
+            if (start < str.size()) {
+                tokens.push_back(deserializeToken(str.substr(start)));
+            }
+
+            return tokens;
         }
 
-        HuffmanNode* root = Methods::BuildHuffmanTree(freqMap);
-        
-        std::map<char, std::string> huffmanCode;
-        Methods::GenerateCodes(root, std::string(), huffmanCode);
+        LIBCOMPRA_API std::string encodeTokens(const std::vector<Token>& tokens) {
+            std::string result;
+            result.reserve(tokens.size() * 3 + 4);
+            writeVarint(result, tokens.size());
+            for (const auto& token : tokens) {
+                // Literals are tagged 1; matches store length << 1 so the low bit stays clear.
+                if (token.isLiteral) {
+                    writeVarint(result, 1);
+                    result += token.literal;
+                } else {
+                    writeVarint(result, (uint64_t)token.length << 1);
+                    writeVarint(result, token.offset);
+                }
+            }
+            return result;
+        }
 
-        std::string bitString;
-        for (char ch : text) {
-            bitString += huffmanCode[ch];
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const uint8_t* data, size_t size) {
+            ByteReader reader(data, size, "Invalid LZSS token stream");
+            size_t count = reader.varint();
+            if (count > reader.remaining() / 2) {
+                throw std::runtime_error("Invalid LZSS token stream");
+            }
+
+            std::vector<Token> tokens(count);
+            for (auto& token : tokens) {
+                uint64_t tag = reader.varint();
+                token.isLiteral = tag & 1;
+                if (token.isLiteral) {
+                    token.literal = (char)reader.byte();
+                    token.offset = 0;
+                    token.length = 0;
+                } else {
+                    token.literal = '\0';
+                    token.length = tag >> 1;
+                    token.offset = reader.varint();
+                }
+            }
+            if (reader.remaining() != 0) {
+                throw std::runtime_error("Invalid LZSS token stream");
+            }
+            return tokens;
         }
 
-        Huffman::ByteVector compressed = Methods::PackBitsToBytes(bitString, bitLength);
-        Methods::FreeTree(root);
-        return compressed;
+        LIBCOMPRA_API std::vector<Token> decodeTokens(const std::string& encoded) {
+            return decodeTokens((const uint8_t*)encoded.data(), encoded.size());
+        }
     }
 
-    LIBCOMPRA_API Huffman::ByteVector Compress(const std::string& text, FreqMap& freqMap, size_t& bitLength) {
-        return compress(text, freqMap, bitLength);
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        // Matches never cost more than the bytes they replace, so the worst case is all literals.
+        return inputSize + (inputSize + 7) / 8 + 2;
     }
 
-    LIBCOMPRA_API std::string Decompress(const ByteVector& compressed, const FreqMap& freqMap, size_t bitLength) {
-        return decompress(compressed, freqMap, bitLength);
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&] {
+            ByteWriter out(output);
+            // The window and lookahead compressPacked(std::string_view) defaults to.
+            return out.finish(packTokens(asView(input), defaultChain(4 * 1024), 18, out));
+        });
     }
 
-    namespace Stringize {
-        LIBCOMPRA_API std::string StringizeFreqMap(const Huffman::FreqMap& freqMap) {
-            std::stringstream ss;
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        return guarded(Error::InputTooLarge, [&] {
+            ByteWriter out(output);
+            return out.finish(packTokens(asView(input), paramsChain(params), paramsLookahead(params), out));
+        });
+    }
 
-            for (const auto& pair : freqMap) {
-                ss << "'" << pair.first << "'" << ":" << "'" << pair.second << "'" << " "; 
-            }
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&] {
+            FixedOutput sink{output.data, output.size};
+            return unpackTokens(asView(input), sink);
+        });
+    }
+}
 
-            return ss.str();
+namespace FSE {
+    namespace {
+        constexpr uint32_t MIN_TABLE_LOG = 5;
+        constexpr uint32_t MAX_TABLE_LOG = 12;
+        constexpr size_t MAX_STATES = 4;
+
+        inline uint32_t highBit(uint32_t value) {
+            return highBit32(value);
         }
 
-        LIBCOMPRA_API std::string StringizeByteVec(const Huffman::ByteVector& byteVec) {
-            std::stringstream ss;
+        // Reads an MSB-first stream from the end towards the start, undoing BitWriter order.
+        struct BackwardReader {
+            const uint8_t* data;
+            size_t position;
 
-            for (size_t i = 0; i < byteVec.size(); ++i) {
-                ss << byteVec[i];
+            uint32_t read(uint32_t bits) {
+                position -= bits;
+                uint64_t word = readBE64(data + (position >> 3)) << (position & 7);
+                return (uint32_t)(word >> 1 >> (63 - bits));
             }
-
-            return ss.str();
+        };
+
+        // Decodes one symbol per state per round while the stream holds enough bits for a full round;
+        // the states are independent, so their table lookups overlap. Returns the symbols decoded.
+        template <size_t StateCount>
+        size_t decodeRounds(const DecodeEntry* entries, BackwardReader& reader, uint32_t* states, char* output, size_t last, uint32_t tableLog) {
+            size_t i = 0;
+            size_t roundBits = StateCount * tableLog;
+            for (; i + StateCount <= last && reader.position >= roundBits; i += StateCount) {
+                for (size_t lane = 0; lane < StateCount; ++lane) {
+                    DecodeEntry entry = entries[states[lane]];
+                    output[i + lane] = (char)entry.symbol;
+                    states[lane] = entry.newState + reader.read(entry.nbBits);
+                }
+            }
+            return i;
         }
-    }
-}
 
-namespace Deflate {
-    LIBCOMPRA_API Huffman::Compressed compress(const std::string& input, size_t windowSize) {
-        std::vector<LZ77::Token> lz77Tokens = LZ77::compress(input, windowSize);
-
-        std::string lz77Compressed = LZ77::Utils::vectorToString(lz77Tokens);
+        uint32_t chooseTableLog(uint32_t tableLog, size_t inputSize, size_t symbolCount) {
+            uint32_t log = std::clamp(tableLog, MIN_TABLE_LOG, MAX_TABLE_LOG);
+            uint32_t sourceLog = inputSize > 1 ? highBit((uint32_t)std::min<size_t>(inputSize - 1, UINT32_MAX)) + 1 : 1;
+            uint32_t minLog = highBit((uint32_t)symbolCount) + 2;
 
-        auto [byteVec, freqMap, bitLength] = Huffman::compress(lz77Compressed);
+            log = std::min(log, std::max(sourceLog, MIN_TABLE_LOG));
+            return std::max(log, minLog);
+        }
 
-        return {byteVec, freqMap, bitLength};
-    }
+        void checkTable(const NormalizedCounts& normalizedCounts, uint32_t tableLog) {
+            if (tableLog < MIN_TABLE_LOG || tableLog > MAX_TABLE_LOG) {
+                throw std::runtime_error("Invalid FSE table log");
+            }
+            size_t total = 0;
+            for (uint16_t count : normalizedCounts) {
+                total += count;
+            }
+            if (total != (size_t(1) << tableLog)) {
+                throw std::runtime_error("Invalid FSE normalized counts");
+            }
+        }
 
-    LIBCOMPRA_API std::string decompress(const Huffman::ByteVector& byteVec, const Huffman::FreqMap& freqMap, const size_t bitLength) {
-        std::string decodedData = Huffman::decompress(byteVec, freqMap, bitLength);
+        std::vector<uint8_t> spreadSymbols(const NormalizedCounts& normalizedCounts, uint32_t tableLog) {
+            size_t tableSize = size_t(1) << tableLog;
+            size_t mask = tableSize - 1;
+            size_t step = (tableSize >> 1) + (tableSize >> 3) + 3;
+
+            std::vector<uint8_t> tableSymbol(tableSize);
+            size_t position = 0;
+            for (size_t s = 0; s < 256; ++s) {
+                for (uint16_t i = 0; i < normalizedCounts[s]; ++i) {
+                    tableSymbol[position] = (uint8_t)s;
+                    position = (position + step) & mask;
+                }
+            }
+            return tableSymbol;
+        }
 
-        std::vector<LZ77::Token> lz77Tokens = LZ77::Utils::stringToVector(decodedData);
+        inline bool overflowed(const BitIO::BitWriter&) {
+            return false;
+        }
 
-        return LZ77::decompress(lz77Tokens);
-    }
+        inline bool overflowed(const SpanBitWriter& writer) {
+            return writer.overflow;
+        }
 
-    LIBCOMPRA_API std::string decompress(const Huffman::Compressed& compressed) {
-        std::string decodedData = Huffman::decompress(compressed.byteVec, compressed.freqMap, compressed.bitLength);
+        // Symbols are encoded back to front, symbol i on state i % stateCount, so the
+        // decoder can emit them front to back while reading the stream from the end.
+        template <typename Writer>
+        void encodeSymbols(std::string_view input, const EncodeTable& table, size_t stateCount, Writer& writer) {
+            if (stateCount == 0 || stateCount > MAX_STATES) {
+                throw std::runtime_error("FSE supports 1 to 4 interleaved states");
+            }
 
-        std::vector<LZ77::Token> lz77Tokens = LZ77::Utils::stringToVector(decodedData);
+            const uint16_t* stateTable = table.stateTable.data();
+            const SymbolTransform* symbolTT = table.symbolTT.data();
+            size_t n = input.size();
+            uint32_t states[MAX_STATES] = {};
+
+            size_t i = n;
+            for (size_t lane = std::min(n, stateCount); lane-- > 0;) {
+                // The last symbol of each lane is folded into the initial state without emitting bits.
+                --i;
+                const SymbolTransform& transform = symbolTT[(uint8_t)input[i]];
+                uint32_t nbBitsOut = (transform.deltaNbBits + (1 << 15)) >> 16;
+                uint32_t value = (nbBitsOut << 16) - transform.deltaNbBits;
+                states[i % stateCount] = stateTable[(int32_t)(value >> nbBitsOut) + transform.deltaFindState];
+            }
 
-        return LZ77::decompress(lz77Tokens);
-    }
-}
+            while (i > 0 && !overflowed(writer)) {
+                --i;
+                uint32_t& state = states[i % stateCount];
+                const SymbolTransform& transform = symbolTT[(uint8_t)input[i]];
+                uint32_t nbBitsOut = (state + transform.deltaNbBits) >> 16;
+                writer.write(state, nbBitsOut);
+                state = stateTable[(int32_t)(state >> nbBitsOut) + transform.deltaFindState];
+            }
 
-namespace LZ4 {
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t i, size_t& match_offset) {
-        size_t match_length = 0;
+            uint32_t tableSize = uint32_t(1) << table.tableLog;
+            for (size_t lane = std::min(n, stateCount); lane-- > 0;) {
+                writer.write(states[lane] - tableSize, table.tableLog);
+            }
+        }
 
-        size_t window_start = std::max(i, size_t(16)) - 16;
-        for (size_t j = window_start; j < i; ++j) {
-            size_t k = 0;
-            while (k < 255 && j + k < i && i + k < input.size() && input[j + k] == input[i + k]) {
-                ++k;
+        // Decodes symbolCount symbols into output from the first bitLength bits of encoded.
+        void decodeSymbols(const uint8_t* encoded, size_t size, size_t bitLength, size_t symbolCount, const DecodeTable& table, size_t stateCount, char* output) {
+            if (stateCount == 0 || stateCount > MAX_STATES) {
+                throw std::runtime_error("FSE supports 1 to 4 interleaved states");
             }
-            if (k > match_length) {
-                match_length = k;
-                match_offset = i - j;
+            if (bitLength > size * 8) {
+                throw std::runtime_error("Invalid FSE bit length");
             }
-        }
+            if (symbolCount == 0) return;
 
-        return match_length;
-    }
+            // Padding lets every read load a full word without bounds checks.
+            ByteVector padded(size + sizeof(uint64_t), 0);
+            if (size > 0) {
+                std::memcpy(padded.data(), encoded, size);
+            }
 
+            BackwardReader reader{padded.data(), bitLength};
+            const DecodeEntry* entries = table.entries.data();
+            size_t lanes = std::min(symbolCount, stateCount);
+            size_t minimumBits = lanes * table.tableLog;
+            uint32_t states[MAX_STATES] = {};
 
-    LIBCOMPRA_API std::string compress(const std::string& input) {
-        std::string output;
-        size_t length = input.size();
-        size_t i = 0;
+            if (bitLength < minimumBits) {
+                throw std::runtime_error("Invalid FSE input");
+            }
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                states[lane] = reader.read(table.tableLog);
+            }
 
-        while (i < length) {
-            size_t match_offset = 0;
-            size_t match_length = findLongestMatch(input, i, match_offset);
+            size_t i = 0;
+            size_t last = symbolCount - lanes;
+            switch (stateCount) {
+                case 1: i = decodeRounds<1>(entries, reader, states, output, last, table.tableLog); break;
+                case 2: i = decodeRounds<2>(entries, reader, states, output, last, table.tableLog); break;
+                case 3: i = decodeRounds<3>(entries, reader, states, output, last, table.tableLog); break;
+                default: i = decodeRounds<4>(entries, reader, states, output, last, table.tableLog); break;
+            }
+            for (; i < last; ++i) {
+                uint32_t& state = states[i % stateCount];
+                DecodeEntry entry = entries[state];
+                if (entry.nbBits > reader.position) {
+                    throw std::runtime_error("Invalid FSE input");
+                }
+                output[i] = (char)entry.symbol;
+                state = entry.newState + reader.read(entry.nbBits);
+            }
+            for (; i < symbolCount; ++i) {
+                output[i] = (char)entries[states[i % stateCount]].symbol;
+            }
 
-            if (match_length > 3) {
-                output += (char)match_offset;
-                output += (char)match_length;
-                i += match_length;
-            } else {
-                output += input[i];
-                ++i;
+            if (reader.position != 0) {
+                throw std::runtime_error("Invalid FSE input");
             }
         }
-
-        return output;
     }
 
-    LIBCOMPRA_API std::string decompress(const std::string& input) {
-        std::string output;
-        size_t length = input.size();
+    namespace Methods {
+        LIBCOMPRA_API NormalizedCounts NormalizeCounts(const std::array<uint64_t, 256>& counts, uint32_t tableLog) {
+            NormalizedCounts normalized{};
+            uint64_t total = 0;
+            for (uint64_t count : counts) {
+                total += count;
+            }
+            if (total == 0) return normalized;
+
+            int64_t tableSize = int64_t(1) << tableLog;
+            int64_t assigned = 0;
+            for (size_t s = 0; s < 256; ++s) {
+                if (counts[s] == 0) continue;
+                uint64_t scaled = (counts[s] * (uint64_t)tableSize + total / 2) / total;
+                normalized[s] = (uint16_t)std::max<uint64_t>(scaled, 1);
+                assigned += normalized[s];
+            }
 
-        for (size_t i = 0; i < length;) {
-            if (i + 1 < length && (unsigned char)input[i] < 16) {
-                size_t offset = (unsigned char)input[i];
-                size_t match_length = (unsigned char)input[i + 1];
-                size_t start = output.size() - offset;
-                for (size_t j = 0; j < match_length; ++j) {
-                    output += output[start + j];
+            // Rounding leaves the sum slightly off; settle the difference on the most probable symbols,
+            // where one slot costs the least relative precision.
+            while (assigned != tableSize) {
+                size_t largest = 0;
+                for (size_t s = 1; s < 256; ++s) {
+                    if (normalized[s] > normalized[largest]) largest = s;
+                }
+                if (assigned < tableSize) {
+                    normalized[largest] += (uint16_t)(tableSize - assigned);
+                    assigned = tableSize;
+                } else {
+                    int64_t excess = std::min<int64_t>(assigned - tableSize, (normalized[largest] + 1) / 2);
+                    if (normalized[largest] <= 1) {
+                        throw std::runtime_error("FSE table log too small for alphabet");
+                    }
+                    normalized[largest] -= (uint16_t)excess;
+                    assigned -= excess;
                 }
-                i += 2;
-            } else {
-                output += input[i];
-                ++i;
             }
+
+            return normalized;
         }
 
-        return output;
-    }
-}
+        LIBCOMPRA_API EncodeTable BuildEncodeTable(const NormalizedCounts& normalizedCounts, uint32_t tableLog) {
+            checkTable(normalizedCounts, tableLog);
 
-namespace LZ5 {
-    LIBCOMPRA_API size_t findLongestMatch(const std::string& input, size_t pos, size_t maxOffset, size_t& matchOffset) {
-        size_t bestLength = 0;
+            size_t tableSize = size_t(1) << tableLog;
+            std::vector<uint8_t> tableSymbol = spreadSymbols(normalizedCounts, tableLog);
 
-        size_t searchStart = (pos > maxOffset) ? pos - maxOffset : 0;
-        for (size_t i = searchStart; i < pos; ++i) {
-            size_t length = 0;
-            while (length < maxOffset && pos + length < input.size() && input[i + length] == input[pos + length]) {
-                ++length;
+            std::array<uint32_t, 257> cumulative{};
+            for (size_t s = 0; s < 256; ++s) {
+                cumulative[s + 1] = cumulative[s] + normalizedCounts[s];
             }
 
-            if (length > bestLength) {
-                bestLength = length;
-                matchOffset = pos - i;
+            EncodeTable table;
+            table.tableLog = tableLog;
+            table.stateTable.resize(tableSize);
+            for (size_t u = 0; u < tableSize; ++u) {
+                table.stateTable[cumulative[tableSymbol[u]]++] = (uint16_t)(tableSize + u);
             }
-        }
-
-        return bestLength;
-    }
-
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t maxOffset) {
-        std::vector<Token> tokens;
-        size_t inputSize = input.size();
-        size_t pos = 0;
 
-        while (pos < inputSize) {
-            size_t matchOffset = 0;
-            size_t matchLength = findLongestMatch(input, pos, maxOffset, matchOffset);
-
-            if (matchLength > 3) {
-                tokens.push_back({matchOffset, matchLength, input[pos + matchLength]});
-                pos += matchLength + 1;
-            } else {
-                tokens.push_back({0, 0, input[pos]});
-                ++pos;
+            int32_t total = 0;
+            for (size_t s = 0; s < 256; ++s) {
+                uint32_t count = normalizedCounts[s];
+                SymbolTransform& transform = table.symbolTT[s];
+                if (count == 0) {
+                    transform = {0, ((tableLog + 1) << 16) - (uint32_t)tableSize};
+                } else if (count == 1) {
+                    transform = {total - 1, (tableLog << 16) - (uint32_t)tableSize};
+                } else {
+                    uint32_t maxBitsOut = tableLog - highBit(count - 1);
+                    uint32_t minStatePlus = count << maxBitsOut;
+                    transform = {total - (int32_t)count, (maxBitsOut << 16) - minStatePlus};
+                }
+                total += count;
             }
+
+            return table;
         }
 
-        return tokens;
-    }
+        LIBCOMPRA_API DecodeTable BuildDecodeTable(const NormalizedCounts& normalizedCounts, uint32_t tableLog) {
+            checkTable(normalizedCounts, tableLog);
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
-        std::string output;
+            size_t tableSize = size_t(1) << tableLog;
+            std::vector<uint8_t> tableSymbol = spreadSymbols(normalizedCounts, tableLog);
+            std::array<uint32_t, 256> symbolNext;
+            std::copy(normalizedCounts.begin(), normalizedCounts.end(), symbolNext.begin());
 
-        for (const auto& token : tokens) {
-            size_t start = output.size() - token.offset;
-            for (size_t i = 0; i < token.length; ++i) {
-                output += output[start + i];
+            DecodeTable table{tableLog, std::vector<DecodeEntry>(tableSize)};
+            for (size_t u = 0; u < tableSize; ++u) {
+                uint8_t symbol = tableSymbol[u];
+                uint32_t nextState = symbolNext[symbol]++;
+                uint8_t nbBits = (uint8_t)(tableLog - highBit(nextState));
+                table.entries[u] = {(uint16_t)((nextState << nbBits) - tableSize), symbol, nbBits};
             }
 
-            if (token.next != '\0') {
-                output += token.next;
-            }
+            return table;
         }
 
-        return output;
-    }
+        LIBCOMPRA_API ByteVector EncodeSymbols(std::string_view input, const EncodeTable& table, size_t stateCount, size_t& bitLength) {
+            BitIO::BitWriter writer;
+            writer.bytes.reserve(input.size() * table.tableLog / 8 + 16);
+            encodeSymbols(input, table, stateCount, writer);
+            bitLength = writer.bitLength;
+            return writer.finish();
+        }
 
-    namespace Utils {
-        LIBCOMPRA_API std::string serializeToken(const Token& token) {
-            return std::to_string(token.offset) + "," + std::to_string(token.length) + "," + token.next;
+        LIBCOMPRA_API std::string DecodeSymbols(const ByteVector& encoded, size_t bitLength, size_t symbolCount, const DecodeTable& table, size_t stateCount) {
+            std::string output(symbolCount, '\0');
+            decodeSymbols(encoded.data(), encoded.size(), bitLength, symbolCount, table, stateCount, &output[0]);
+            return output;
         }
 
-        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
-            std::string result;
-            for (const auto& token : tokens) {
-                result += serializeToken(token) + ";";
-            }
-            if (!result.empty()) {
-                result.pop_back();
-            }
-            return result;
+        LIBCOMPRA_API ByteVector PackBitsToBytes(const std::string& bitString) {
+            return Huffman::Methods::PackBitsToBytes(bitString);
         }
 
-        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
-            size_t firstComma = str.find(',');
-            size_t secondComma = str.find(',', firstComma + 1);
-            size_t thirdComma = str.find(',', secondComma + 1);
+        LIBCOMPRA_API std::string UnpackBytesToBits(const ByteVector& byteVec) {
+            return Huffman::Methods::UnpackBytesToBits(byteVec);
+        }
 
-            size_t offset = std::stoull(str.substr(0, firstComma));
-            size_t length = std::stoull(str.substr(firstComma + 1, secondComma - firstComma - 1));
-            char next = (thirdComma != std::string::npos) ? str[thirdComma + 1] : '\0'; 
+        LIBCOMPRA_API ByteVector PackBitsToBytes(const std::string& bitString, size_t& bitLength) {
+            return Huffman::Methods::PackBitsToBytes(bitString, bitLength);
+        }
 
-            return {offset, length, next};
+        LIBCOMPRA_API std::string UnpackBytesToBits(const ByteVector& byteVec, size_t bitLength) {
+            return Huffman::Methods::UnpackBytesToBits(byteVec, bitLength);
         }
+    }
 
-        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
-            std::vector<Token> tokens;
-            size_t start = 0;
-            size_t end;
+    namespace {
+        Table buildTable(std::string_view input, uint32_t tableLog, uint32_t stateCount) {
+            Table table{};
+            table.stateCount = stateCount;
+            table.symbolCount = input.size();
 
-            while ((end = str.find(';', start)) != std::string::npos) {
-                tokens.push_back(deserializeToken(str.substr(start, end - start)));
-                start = end + 1;
+            std::array<uint64_t, 256> counts{};
+            for (char c : input) {
+                ++counts[(uint8_t)c];
+            }
+            size_t distinct = 0;
+            for (uint64_t count : counts) {
+                distinct += count != 0;
             }
 
-            if (start < str.size()) {
-                tokens.push_back(deserializeToken(str.substr(start)));
+            table.tableLog = chooseTableLog(tableLog, input.size(), std::max<size_t>(distinct, 1));
+            if (!input.empty()) {
+                table.normalizedCounts = Methods::NormalizeCounts(counts, table.tableLog);
             }
+            return table;
+        }
+    }
 
-            return tokens;
+    LIBCOMPRA_API Compressed compress(std::string_view input, uint32_t tableLog, uint32_t stateCount) {
+        Table table = buildTable(input, tableLog, stateCount);
+        if (input.empty()) {
+            return {{}, table, 0};
         }
+
+        size_t bitLength = 0;
+        ByteVector encoded = Methods::EncodeSymbols(input, Methods::BuildEncodeTable(table.normalizedCounts, table.tableLog), stateCount, bitLength);
+
+        return {encoded, table, bitLength};
     }
-}
 
-namespace LZW {
-    LIBCOMPRA_API void addToDictionary(std::map<std::string, int>& dictionary, const std::string& key, int& code) {
-        dictionary[key] = code++;
+    LIBCOMPRA_API std::string decompress(const Compressed& compressed) {
+        return decompress(compressed.byteVec, compressed.table, compressed.bitLength);
     }
 
-    LIBCOMPRA_API void compress(std::vector<int>& result, std::map<std::string, int>& dictionary, const std::string& input, int& code) {
-        std::string current;
-        for (char c : input) {
-            std::string next = current + c;
-            if (dictionary.count(next)) {
-                current = next;
-            } else {
-                result.push_back(dictionary[current]);
-                addToDictionary(dictionary, next, code);
-                current = std::string(1, c);
+    LIBCOMPRA_API std::string decompress(const ByteVector& encoded, const Table& table, size_t bitLength) {
+        if (table.symbolCount == 0) return std::string();
+
+        DecodeTable decodeTable = Methods::BuildDecodeTable(table.normalizedCounts, table.tableLog);
+        return Methods::DecodeSymbols(encoded, bitLength, table.symbolCount, decodeTable, table.stateCount);
+    }
+
+    namespace Stringize {
+        LIBCOMPRA_API std::string StringizeTable(const FSE::Table& table) {
+            std::stringstream ss;
+
+            ss << "log:" << table.tableLog << " states:" << table.stateCount << " symbols:" << table.symbolCount << " ";
+            for (size_t s = 0; s < table.normalizedCounts.size(); ++s) {
+                if (table.normalizedCounts[s]) {
+                    ss << "'" << (char)s << "'" << ":" << table.normalizedCounts[s] << " ";
+                }
             }
-        }
 
-        if (!current.empty()) {
-            result.push_back(dictionary[current]);
+            return ss.str();
         }
-    }
 
-    LIBCOMPRA_API std::vector<int> compress(const std::string& input) {
-        std::vector<int> result;
-        std::map<std::string, int> dictionary;
+        LIBCOMPRA_API std::string StringizeByteVec(const FSE::ByteVector& byteVec) {
+            std::stringstream ss;
+
+            for (size_t i = 0; i < byteVec.size(); ++i) {
+                ss << byteVec[i];
+            }
 
-        for (int i = 0; i < 256; ++i) {
-            dictionary[std::string(1, i)] = i;
+            return ss.str();
         }
+    }
 
-        int code = 256;
-        compress(result, dictionary, input, code);
+    LIBCOMPRA_API Params preset(int level) {
+        return {std::clamp(level, MIN_LEVEL, MAX_LEVEL), 0, 0, 0, 0, 0, Strategy::Greedy};
+    }
 
-        return result;
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        // Header bytes, up to 256 two-byte counts, and at most tableLog bits per symbol and final state.
+        return 3 * 10 + 3 + 256 * 2 + ((inputSize + MAX_STATES) * MAX_TABLE_LOG + 7) / 8;
     }
 
-    LIBCOMPRA_API void decompress(std::string& result, std::map<int, std::string>& dictionary, const std::vector<int>& input, int& code) {
-        std::string current = dictionary[input[0]];
-        result = current;
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&] {
+            // The table log and state count compress(std::string_view) defaults to.
+            Table table = buildTable(asView(input), 11, 2);
+
+            ByteWriter out(output);
+            bool fitted = out.byte((uint8_t)table.tableLog) && out.byte((uint8_t)table.stateCount) && out.varint(table.symbolCount);
+            if (fitted && table.symbolCount > 0) {
+                size_t maxSymbol = 255;
+                while (table.normalizedCounts[maxSymbol] == 0) {
+                    --maxSymbol;
+                }
+                fitted = out.byte((uint8_t)maxSymbol);
+                for (size_t s = 0; fitted && s <= maxSymbol; ++s) {
+                    fitted = out.varint(table.normalizedCounts[s]);
+                }
 
-        for (size_t i = 1; i < input.size(); ++i) {
-            std::string entry;
-            if (dictionary.count(input[i])) {
-                entry = dictionary[input[i]];
-            } else if (input[i] == code) {
-                entry = current + current[0];
-            } else {
-                throw std::runtime_error("Invalid LZW decompression input");
+                EncodeTable encodeTable = Methods::BuildEncodeTable(table.normalizedCounts, table.tableLog);
+                fitted = fitted && writeVarintPrefixed(out, [&]() -> uint64_t {
+                    SpanBitWriter writer(out);
+                    encodeSymbols(asView(input), encodeTable, table.stateCount, writer);
+                    return writer.finish() ? writer.bitLength : NIL;
+                });
             }
-
-            result += entry;
-            dictionary[code++] = current + entry[0];
-            current = entry;
-        }
+            return out.finish(fitted);
+        });
     }
 
-    LIBCOMPRA_API std::string decompress(const std::vector<int>& input) {
-        std::map<int, std::string> dictionary;
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params&) {
+        return compress(input, output);
+    }
 
-        for (int i = 0; i < 256; ++i) {
-            dictionary[i] = std::string(1, i);
-        }
+    // The symbol count in the header sizes the output before decoding, straight into the
+    // caller's buffer. Only the payload is copied, to pad it for the word-wide backward reads.
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&]() -> Result {
+            ByteReader reader(input.data, input.size, "Invalid FSE input");
+            Table table{};
+            table.tableLog = reader.byte();
+            table.stateCount = reader.byte();
+            table.symbolCount = reader.varint();
+            if (table.symbolCount == 0) {
+                return {0, reader.remaining() == 0 ? Error::None : Error::InvalidInput};
+            }
+            if (table.symbolCount > output.size) {
+                return {table.symbolCount, Error::OutputTooSmall};
+            }
 
-        int code = 256;
-        std::string result;
-        decompress(result, dictionary, input, code);
+            size_t maxSymbol = reader.byte();
+            for (size_t s = 0; s <= maxSymbol; ++s) {
+                uint64_t normalized = reader.varint();
+                if (normalized > 0xFFFF) throw std::runtime_error("Invalid FSE input");
+                table.normalizedCounts[s] = (uint16_t)normalized;
+            }
 
-        return result;
+            size_t bitLength = reader.varint();
+            if ((bitLength + 7) / 8 != reader.remaining()) {
+                throw std::runtime_error("Invalid FSE input");
+            }
+            DecodeTable decodeTable = Methods::BuildDecodeTable(table.normalizedCounts, table.tableLog);
+            decodeSymbols(reader.ip, reader.remaining(), bitLength, table.symbolCount, decodeTable, table.stateCount, (char*)output.data);
+            return {table.symbolCount, Error::None};
+        });
     }
+}
 
-    LIBCOMPRA_API void compressOptimized(std::vector<int>& result, std::map<std::string, int>& dictionary, const std::string& input, int& code) {
-        std::string current;
-        for (char c : input) {
-            current += c;
-            if (dictionary.count(current) == 0) {
-                result.push_back(dictionary[current.substr(0, current.size() - 1)]);
-                addToDictionary(dictionary, current, code);
-                current = std::string(1, c);
-            }
+namespace Zstandard {
+    namespace {
+        constexpr size_t MAX_BLOCK_SIZE = 128 * 1024;
+        constexpr size_t MIN_MATCH = 3;
+        constexpr size_t REPEAT_CODES = 3;
+
+        constexpr Preset PRESETS[MAX_LEVEL] = {
+            {17, 14, 2, 4, 32, Strategy::Greedy},
+            {18, 15, 4, 4, 48, Strategy::Greedy},
+            {19, 16, 8, 4, 64, Strategy::Greedy},
+            {20, 16, 16, 4, 96, Strategy::Greedy},
+            {20, 16, 16, 4, 128, Strategy::Lazy},
+            {21, 17, 32, 4, 256, Strategy::Lazy},
+            {22, 18, 64, 4, 512, Strategy::Lazy2},
+            {22, 18, 256, 3, 1024, Strategy::Lazy2},
+            {23, 20, 1024, 3, 4096, Strategy::Lazy2}};
+
+        enum StreamMode : uint8_t { RAW = 0, RLE = 1, COMPRESSED = 2 };
+
+        // Literal and match lengths are sent as a code plus extra bits; codes 0-15 and 0-31
+        // are direct, larger values share a code per power-of-two range (RFC 8878 3.1.1.3.2.1).
+        constexpr uint32_t LL_BASE[36] = {
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+            16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 0x80, 0x100, 0x200, 0x400, 0x800, 0x1000,
+            0x2000, 0x4000, 0x8000, 0x10000};
+        constexpr uint8_t LL_BITS[36] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+            13, 14, 15, 16};
+        constexpr uint32_t ML_BASE[53] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+            19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+            35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 0x83, 0x103, 0x203, 0x403, 0x803,
+            0x1003, 0x2003, 0x4003, 0x8003, 0x10003};
+        constexpr uint8_t ML_BITS[53] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+            12, 13, 14, 15, 16};
+        constexpr uint32_t LL_TABLE_LOG = 9;
+        constexpr uint32_t ML_TABLE_LOG = 9;
+        constexpr uint32_t OF_TABLE_LOG = 8;
+        constexpr uint8_t MAX_OF_CODE = 31;
+
+        struct Sequence {
+            uint32_t literalLength;
+            uint32_t matchLength;
+            // 1-3 select a repeat offset, anything larger is the distance plus REPEAT_CODES.
+            uint32_t offsetValue;
+        };
+
+        template <size_t N>
+        inline uint8_t lengthCode(const uint32_t (&base)[N], uint32_t value) {
+            return (uint8_t)(std::upper_bound(base, base + N, value) - base - 1);
         }
 
-        if (!current.empty()) {
-            result.push_back(dictionary[current]);
+        inline uint8_t highBit(uint32_t value) {
+            return (uint8_t)highBit32(value);
         }
-    }
-
-    LIBCOMPRA_API std::vector<int> compressOptimized(const std::string& input) {
-        std::vector<int> result;
-        std::map<std::string, int> dictionary;
 
-        for (int i = 0; i < 256; ++i) {
-            dictionary[std::string(1, i)] = i;
+        // Repeat offsets behave like a move-to-front list shared by encoder and decoder.
+        inline uint32_t updateRepeats(uint32_t* repeats, uint32_t offsetValue) {
+            if (offsetValue > REPEAT_CODES) {
+                repeats[2] = repeats[1];
+                repeats[1] = repeats[0];
+                repeats[0] = offsetValue - REPEAT_CODES;
+            } else if (offsetValue == 2) {
+                std::swap(repeats[0], repeats[1]);
+            } else if (offsetValue == 3) {
+                uint32_t offset = repeats[2];
+                repeats[2] = repeats[1];
+                repeats[1] = repeats[0];
+                repeats[0] = offset;
+            }
+            return repeats[0];
         }
 
-        int code = 256;
-        compressOptimized(result, dictionary, input, code);
+        void writeLiterals(std::string& out, const std::string& literals) {
+            writeVarint(out, literals.size());
+            if (literals.empty()) return;
 
-        return result;
-    }
+            if (literals.find_first_not_of(literals[0]) == std::string::npos) {
+                out += (char)RLE;
+                out += literals[0];
+                return;
+            }
 
-    LIBCOMPRA_API void decompressOptimized(std::string& result, std::map<int, std::string>& dictionary, const std::vector<int>& input, int& code) {
-        std::string current = dictionary[input[0]];
-        result = current;
+            Huffman::Compressed compressed = Huffman::compress(literals);
+            size_t packedSize = sizeof(Huffman::CodeLengths) / 2 + compressed.byteVec.size() + 4;
+            if (packedSize >= literals.size()) {
+                out += (char)RAW;
+                out += literals;
+                return;
+            }
 
-        for (size_t i = 1; i < input.size(); ++i) {
-            std::string entry;
-            if (dictionary.count(input[i])) {
-                entry = dictionary[input[i]];
-            } else if (input[i] == code) {
-                entry = current + current[0];
-            } else {
-                throw std::runtime_error("Invalid LZW decompression input");
+            out += (char)COMPRESSED;
+            for (size_t s = 0; s < compressed.codeLengths.size(); s += 2) {
+                out += (char)(compressed.codeLengths[s] | (compressed.codeLengths[s + 1] << 4));
             }
+            writeVarint(out, compressed.bitLength);
+            out.append(compressed.byteVec.begin(), compressed.byteVec.end());
+        }
 
-            result += entry;
-            dictionary[code++] = current + entry[0];
-            current = entry;
+        void writeCodes(std::string& out, const std::string& codes, uint32_t tableLog) {
+            if (codes.find_first_not_of(codes[0]) == std::string::npos) {
+                out += (char)RLE;
+                out += codes[0];
+                return;
+            }
+
+            FSE::Compressed compressed = FSE::compress(codes, tableLog);
+            size_t maxSymbol = 0;
+            for (size_t s = 0; s < compressed.table.normalizedCounts.size(); ++s) {
+                if (compressed.table.normalizedCounts[s]) maxSymbol = s;
+            }
+
+            out += (char)COMPRESSED;
+            out += (char)compressed.table.tableLog;
+            out += (char)maxSymbol;
+            for (size_t s = 0; s <= maxSymbol; ++s) {
+                writeVarint(out, compressed.table.normalizedCounts[s]);
+            }
+            writeVarint(out, compressed.bitLength);
+            out.append(compressed.byteVec.begin(), compressed.byteVec.end());
         }
-    }
 
-    LIBCOMPRA_API std::string decompressOptimized(const std::vector<int>& input) {
-        std::map<int, std::string> dictionary;
+        std::string readLiterals(ByteReader& reader) {
+            size_t count = reader.varint();
+            if (count > MAX_BLOCK_SIZE) throw std::runtime_error("Invalid Zstandard input");
+            if (count == 0) return std::string();
 
-        for (int i = 0; i < 256; ++i) {
-            dictionary[i] = std::string(1, i);
+            switch (reader.byte()) {
+                case RAW: {
+                    const unsigned char* literals = reader.take(count);
+                    return std::string((const char*)literals, count);
+                }
+                case RLE:
+                    return std::string(count, (char)reader.byte());
+                case COMPRESSED: {
+                    Huffman::CodeLengths codeLengths;
+                    const unsigned char* packed = reader.take(codeLengths.size() / 2);
+                    for (size_t s = 0; s < codeLengths.size(); s += 2) {
+                        codeLengths[s] = packed[s / 2] & 15;
+                        codeLengths[s + 1] = packed[s / 2] >> 4;
+                    }
+                    size_t bitLength = reader.varint();
+                    if (bitLength > count * 16) throw std::runtime_error("Invalid Zstandard input");
+                    const unsigned char* bytes = reader.take((bitLength + 7) / 8);
+                    std::string literals = Huffman::decompress(Huffman::ByteVector(bytes, bytes + (bitLength + 7) / 8), codeLengths, bitLength);
+                    if (literals.size() != count) throw std::runtime_error("Invalid Zstandard input");
+                    return literals;
+                }
+                default:
+                    throw std::runtime_error("Invalid Zstandard input");
+            }
         }
 
-        int code = 256;
-        std::string result;
-        decompressOptimized(result, dictionary, input, code);
+        std::string readCodes(ByteReader& reader, size_t count, size_t maxCode) {
+            switch (reader.byte()) {
+                case RLE: {
+                    uint8_t code = reader.byte();
+                    if (code > maxCode) throw std::runtime_error("Invalid Zstandard input");
+                    return std::string(count, (char)code);
+                }
+                case COMPRESSED: {
+                    FSE::Table table{};
+                    table.tableLog = reader.byte();
+                    table.stateCount = 2;
+                    table.symbolCount = count;
+                    size_t maxSymbol = reader.byte();
+                    if (maxSymbol > maxCode) throw std::runtime_error("Invalid Zstandard input");
+                    for (size_t s = 0; s <= maxSymbol; ++s) {
+                        uint64_t normalized = reader.varint();
+                        if (normalized > 0xFFFF) throw std::runtime_error("Invalid Zstandard input");
+                        table.normalizedCounts[s] = (uint16_t)normalized;
+                    }
+                    size_t bitLength = reader.varint();
+                    if (bitLength > (count + 2) * 16) throw std::runtime_error("Invalid Zstandard input");
+                    const unsigned char* bytes = reader.take((bitLength + 7) / 8);
+                    return FSE::decompress(FSE::ByteVector(bytes, bytes + (bitLength + 7) / 8), table, bitLength);
+                }
+                default:
+                    throw std::runtime_error("Invalid Zstandard input");
+            }
+        }
 
-        return result;
-    }
-}
+        void writeBlock(std::string& out, const std::string& literals, const std::vector<Sequence>& sequences) {
+            writeLiterals(out, literals);
+            writeVarint(out, sequences.size());
+            if (sequences.empty()) return;
+
+            std::string literalCodes(sequences.size(), '\0');
+            std::string matchCodes(sequences.size(), '\0');
+            std::string offsetCodes(sequences.size(), '\0');
+            BitIO::BitWriter extraBits;
+
+            for (size_t i = 0; i < sequences.size(); ++i) {
+                const Sequence& sequence = sequences[i];
+                uint8_t literalCode = lengthCode(LL_BASE, sequence.literalLength);
+                uint8_t matchCode = lengthCode(ML_BASE, sequence.matchLength);
+                uint8_t offsetCode = highBit(sequence.offsetValue);
+
+                literalCodes[i] = (char)literalCode;
+                matchCodes[i] = (char)matchCode;
+                offsetCodes[i] = (char)offsetCode;
+
+                extraBits.write(sequence.literalLength - LL_BASE[literalCode], LL_BITS[literalCode]);
+                extraBits.write(sequence.matchLength - ML_BASE[matchCode], ML_BITS[matchCode]);
+                extraBits.write(sequence.offsetValue, offsetCode);
+            }
 
-namespace LZO {
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t windowSize) {
-        std::vector<Token> tokens;
-        size_t i = 0;
+            writeCodes(out, literalCodes, LL_TABLE_LOG);
+            writeCodes(out, matchCodes, ML_TABLE_LOG);
+            writeCodes(out, offsetCodes, OF_TABLE_LOG);
 
-        while (i < input.size()) {
-            size_t bestOffset = 0, bestLength = 0;
-            size_t searchStart = (i > windowSize) ? i - windowSize : 0;
+            writeVarint(out, extraBits.bitLength);
+            BitIO::ByteVector bytes = extraBits.finish();
+            out.append(bytes.begin(), bytes.end());
+        }
+    }
 
-            for (size_t j = searchStart; j < i; ++j) {
-                size_t length = 0;
-                while (j + length < i && i + length < input.size() && input[j + length] == input[i + length]) {
-                    ++length;
+    namespace {
+        // Writes the frame through a ByteWriter or StringWriter, giving up with false at the
+        // first block header or body that does not fit. Each block is still assembled in a
+        // scratch string first, as it is stored raw when that comes out no smaller.
+        template <typename Writer>
+        bool compressFrame(std::string_view input, LZ77::HashChain chain, Strategy strategy, Writer& out) {
+            size_t maxDeferred = strategy == Strategy::Lazy2 ? 2 : strategy == Strategy::Lazy ? 1 : 0;
+
+            if (!out.varint(input.size())) return false;
+
+            const char* data = input.data();
+            size_t indexed = 0;
+            auto indexUpTo = [&](size_t end) {
+                for (; indexed < end; ++indexed) {
+                    chain.insert(input, indexed);
                 }
-
-                if (length > bestLength) {
-                    bestLength = length;
-                    bestOffset = i - j;
+            };
+            uint32_t repeats[REPEAT_CODES] = {1, 4, 8};
+            std::string literals;
+            std::string block;
+            std::vector<Sequence> sequences;
+
+            for (size_t blockStart = 0; blockStart < input.size(); blockStart += MAX_BLOCK_SIZE) {
+                size_t blockEnd = std::min(blockStart + MAX_BLOCK_SIZE, input.size());
+                size_t pos = blockStart;
+                size_t anchor = blockStart;
+                size_t deferred = 0;
+                literals.clear();
+                sequences.clear();
+
+                // The last few positions of a block are left out of the chain.
+                indexed = std::max(indexed, blockStart);
+
+                while (pos + MIN_MATCH < blockEnd) {
+                    size_t limit = blockEnd - pos;
+                    size_t repeatLength = 0;
+                    if (repeats[0] <= pos) {
+                        repeatLength = countMatch(data + pos - repeats[0], data + pos, limit);
+                    }
+
+                    size_t distance = 0;
+                    size_t matchLength = chain.findLongestMatch(input, pos, limit, distance);
+
+                    uint32_t offsetValue;
+                    if (repeatLength >= MIN_MATCH && repeatLength + 2 >= matchLength) {
+                        matchLength = repeatLength;
+                        offsetValue = 1;
+                    } else if (matchLength > 0) {
+                        // Lazy parsing: emit a literal instead when the next position matches longer.
+                        if (deferred < maxDeferred && matchLength < limit) {
+                            indexUpTo(pos + 1);
+                            size_t nextDistance = 0;
+                            if (chain.findLongestMatch(input, pos + 1, limit - 1, nextDistance) > matchLength + 1) {
+                                ++pos;
+                                ++deferred;
+                                continue;
+                            }
+                        }
+                        offsetValue = (uint32_t)distance + REPEAT_CODES;
+                        if (distance == repeats[1]) offsetValue = 2;
+                        else if (distance == repeats[2]) offsetValue = 3;
+                    } else {
+                        indexUpTo(++pos);
+                        deferred = 0;
+                        continue;
+                    }
+
+                    literals.append(data + anchor, pos - anchor);
+                    sequences.push_back({(uint32_t)(pos - anchor), (uint32_t)matchLength, offsetValue});
+                    updateRepeats(repeats, offsetValue);
+
+                    pos += matchLength;
+                    indexUpTo(pos);
+                    anchor = pos;
+                    deferred = 0;
                 }
+
+                literals.append(data + anchor, blockEnd - anchor);
+                block.clear();
+                writeBlock(block, literals, sequences);
+
+                // Incompressible blocks are stored verbatim so the frame never grows past compressBound.
+                size_t blockSize = blockEnd - blockStart;
+                bool fitted = block.size() >= blockSize
+                    ? out.varint((blockSize << 1) | 1) && out.bytes(data + blockStart, blockSize)
+                    : out.varint(blockSize << 1) && out.bytes(block.data(), block.size());
+                if (!fitted) return false;
             }
 
-            char nextChar = (i + bestLength < input.size()) ? input[i + bestLength] : '\0';
-            tokens.push_back({bestOffset, bestLength, nextChar});
-            i += (bestLength > 0) ? bestLength + 1 : 1;
+            return true;
+        }
+
+        LZ77::HashChain defaultChain(size_t windowSize) {
+            windowSize = std::clamp<size_t>(windowSize, 1024, size_t(1) << 30);
+            return LZ77::HashChain(windowSize, 16, 4, 16);
+        }
+
+        LZ77::HashChain paramsChain(std::string_view input, const Params& params) {
+            // A window past the input only costs chain memory.
+            size_t windowSize = std::min(clampedLog(params.windowLog, 10, 30), std::max<size_t>(input.size(), 1024));
+            return LZ77::HashChain(windowSize, std::max<uint32_t>(params.searchDepth, 1), params.minMatch, params.hashLog, std::max<uint32_t>(params.niceLength, 1));
         }
 
-        return tokens;
-    }
+        // Decodes the blocks that follow the content size into dst, which holds capacity >=
+        // contentSize bytes. Matches wild-copy only while WILDCOPY_SLACK bytes of room remain.
+        void decodeBlocks(ByteReader& reader, size_t contentSize, uint8_t* dst, size_t capacity) {
+            FixedOutput output{dst, capacity};
+            char* op = (char*)dst;
+            size_t produced = 0;
+            uint32_t repeats[REPEAT_CODES] = {1, 4, 8};
+
+            while (produced < contentSize) {
+                uint64_t blockHeader = reader.varint();
+                size_t blockSize = (size_t)(blockHeader >> 1);
+                if (blockSize == 0 || blockSize > MAX_BLOCK_SIZE || blockSize > contentSize - produced) {
+                    throw std::runtime_error("Invalid Zstandard input");
+                }
+                if (blockHeader & 1) {
+                    std::memcpy(op + produced, reader.take(blockSize), blockSize);
+                    produced += blockSize;
+                    continue;
+                }
+                size_t blockEnd = produced + blockSize;
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
-        std::string output;
+                std::string literals = readLiterals(reader);
+                size_t sequenceCount = reader.varint();
+                if (sequenceCount > blockSize / MIN_MATCH) {
+                    throw std::runtime_error("Invalid Zstandard input");
+                }
 
-        for (const auto& token : tokens) {
-            if (token.offset > 0 && token.length > 0) {
-                size_t start = output.size() - token.offset;
+                const char* lp = literals.data();
+                const char* lend = lp + literals.size();
+
+                if (sequenceCount > 0) {
+                    std::string literalCodes = readCodes(reader, sequenceCount, 35);
+                    std::string matchCodes = readCodes(reader, sequenceCount, 52);
+                    std::string offsetCodes = readCodes(reader, sequenceCount, MAX_OF_CODE);
+
+                    size_t bitLength = reader.varint();
+                    if (bitLength > sequenceCount * 64) throw std::runtime_error("Invalid Zstandard input");
+                    const unsigned char* bytes = reader.take((bitLength + 7) / 8);
+                    BitIO::BitReader extraBits(bytes, (bitLength + 7) / 8);
+
+                    for (size_t i = 0; i < sequenceCount; ++i) {
+                        uint8_t literalCode = (uint8_t)literalCodes[i];
+                        uint8_t matchCode = (uint8_t)matchCodes[i];
+                        uint8_t offsetCode = (uint8_t)offsetCodes[i];
+                        if (literalCode > 35 || matchCode > 52 || offsetCode > MAX_OF_CODE) {
+                            throw std::runtime_error("Invalid Zstandard input");
+                        }
+
+                        size_t literalLength = LL_BASE[literalCode] + extraBits.read(LL_BITS[literalCode]);
+                        size_t matchLength = ML_BASE[matchCode] + extraBits.read(ML_BITS[matchCode]);
+                        uint32_t offsetValue = (uint32_t)((uint64_t(1) << offsetCode) | extraBits.read(offsetCode));
+
+                        if (literalLength > (size_t)(lend - lp) || literalLength + matchLength > blockEnd - produced) {
+                            throw std::runtime_error("Invalid Zstandard input");
+                        }
+                        std::memcpy(op + produced, lp, literalLength);
+                        lp += literalLength;
+                        produced += literalLength;
+
+                        size_t offset = updateRepeats(repeats, offsetValue);
+                        if (offset == 0 || offset > produced) {
+                            throw std::runtime_error("Invalid Zstandard input");
+                        }
+                        writeMatch(output, produced, offset, matchLength);
+                        produced += matchLength;
+                    }
+
+                    if (extraBits.consumedBits() > bitLength) {
+                        throw std::runtime_error("Invalid Zstandard input");
+                    }
+                }
 
-                for (size_t i = 0; i < token.length; ++i) {
-                    output += output[start + i];
+                size_t lastLiterals = (size_t)(lend - lp);
+                if (produced + lastLiterals != blockEnd) {
+                    throw std::runtime_error("Invalid Zstandard input");
                 }
+                std::memcpy(op + produced, lp, lastLiterals);
+                produced += lastLiterals;
             }
 
-            if (token.next != '\0') {
-                output += token.next;
+            if (reader.ip != reader.iend) {
+                throw std::runtime_error("Invalid Zstandard input");
             }
         }
 
-        return output;
+        // Reads the content size, which every block costs a few header bytes to regenerate at
+        // most MAX_BLOCK_SIZE of.
+        size_t readContentSize(ByteReader& reader) {
+            size_t contentSize = reader.varint();
+            if (contentSize / MAX_BLOCK_SIZE > reader.remaining()) {
+                throw std::runtime_error("Invalid Zstandard input");
+            }
+            return contentSize;
+        }
     }
 
-    namespace Utils {
-        LIBCOMPRA_API std::string serializeToken(const Token& token) {
-            return std::to_string(token.offset) + "," + std::to_string(token.length) + "," + (token.next == '\0' ? "\\0" : std::string(1, token.next));
-        }
+    LIBCOMPRA_API std::string compress(std::string_view input, size_t windowSize) {
+        std::string output;
+        StringWriter out{output};
+        compressFrame(input, defaultChain(windowSize), Strategy::Greedy, out);
+        return output;
+    }
 
-        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
-            std::string result;
-            for (const auto& token : tokens) {
-                result += serializeToken(token) + ";";
-            }
-            if (!result.empty()) {
-                result.pop_back();
-            }
-            return result;
-        }
+    LIBCOMPRA_API std::string compress(std::string_view input, const Params& params) {
+        std::string output;
+        StringWriter out{output};
+        compressFrame(input, paramsChain(input, params), params.strategy, out);
+        return output;
+    }
 
-        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
-            size_t firstComma = str.find(',');
-            size_t secondComma = str.find(',', firstComma + 1);
-            size_t thirdComma = str.find(',', secondComma + 1);
+    LIBCOMPRA_API Params preset(int level) {
+        return presetParams(PRESETS, level);
+    }
 
-            size_t offset = std::stoull(str.substr(0, firstComma));
-            size_t length = std::stoull(str.substr(firstComma + 1, secondComma - firstComma - 1));
+    LIBCOMPRA_API std::string decompress(std::string_view input) {
+        ByteReader reader((const unsigned char*)input.data(), input.size(), "Invalid Zstandard input");
+        size_t contentSize = readContentSize(reader);
+        std::string output(contentSize + WILDCOPY_SLACK, '\0');
+        decodeBlocks(reader, contentSize, (uint8_t*)&output[0], output.size());
+        output.resize(contentSize);
+        return output;
+    }
 
-            std::string nextStr = str.substr(thirdComma + 1);
-            char next = (nextStr == "\\0") ? '\0' : nextStr[0];
+    LIBCOMPRA_API size_t compressBound(size_t inputSize) {
+        // Every block falls back to raw storage, so only the frame and block headers are added.
+        return inputSize + 3 * (inputSize / MAX_BLOCK_SIZE + 1) + 10;
+    }
 
-            return {offset, length, next};
-        }
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InputTooLarge, [&] {
+            ByteWriter out(output);
+            // The window compress(std::string_view) defaults to.
+            return out.finish(compressFrame(asView(input), defaultChain(32 * 1024), Strategy::Greedy, out));
+        });
+    }
 
-        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
-            std::vector<Token> tokens;
-            size_t start = 0;
-            size_t end;
+    LIBCOMPRA_API Result compress(ByteSpan input, MutableByteSpan output, const Params& params) {
+        return guarded(Error::InputTooLarge, [&] {
+            ByteWriter out(output);
+            return out.finish(compressFrame(asView(input), paramsChain(asView(input), params), params.strategy, out));
+        });
+    }
 
-            while ((end = str.find(';', start)) != std::string::npos) {
-                tokens.push_back(deserializeToken(str.substr(start, end - start)));
-                start = end + 1;
+    LIBCOMPRA_API Result decompress(ByteSpan input, MutableByteSpan output) {
+        return guarded(Error::InvalidInput, [&]() -> Result {
+            ByteReader reader(input.data, input.size, "Invalid Zstandard input");
+            size_t contentSize = readContentSize(reader);
+            if (contentSize > output.size) {
+                return {contentSize, Error::OutputTooSmall};
             }
+            decodeBlocks(reader, contentSize, output.data, output.size);
+            return {contentSize, Error::None};
+        });
+    }
+}
 
-            if (start < str.size()) {
-                tokens.push_back(deserializeToken(str.substr(start)));
+namespace Codecs {
+    namespace {
+        constexpr uint8_t FIRST_CUSTOM_ID = 128;
+        constexpr size_t SAMPLE_SLICES = 4;
+        constexpr double MIN_TIMING_SECONDS = 0.002;
+        constexpr int MAX_TIMING_RUNS = 16;
+
+        std::vector<Codec>& registry() {
+            static std::vector<Codec> codecs = {
+                {Id::LZ77, "lz77", LZ77::preset, LZ77::compressBound, LZ77::compress, LZ77::decompress},
+                {Id::LZ78, "lz78", LZ78::preset, LZ78::compressBound, LZ78::compress, LZ78::decompress},
+                {Id::LZMA, "lzma", LZMA::preset, LZMA::compressBound, LZMA::compress, LZMA::decompress},
+                {Id::Huffman, "huffman", Huffman::preset, Huffman::compressBound, Huffman::compress, Huffman::decompress},
+                {Id::Deflate, "deflate", Deflate::preset, Deflate::compressBound,
+                 [](ByteSpan input, MutableByteSpan output, const Params& params) { return Deflate::compress(input, output, params); },
+                 [](ByteSpan input, MutableByteSpan output) { return Deflate::decompress(input, output); },
+                 [](ByteSpan dictionary, ByteSpan input, MutableByteSpan output, const Params& params) {
+                     return guarded(Error::InputTooLarge, [&] {
+                         return writeOutput(Deflate::compress(asView(input), params, asView(dictionary)), output);
+                     });
+                 },
+                 [](ByteSpan dictionary, ByteSpan input, MutableByteSpan output) {
+                     return guarded(Error::InvalidInput, [&] {
+                         return writeOutput(Deflate::decompress(asView(input), asView(dictionary)), output);
+                     });
+                 }},
+                {Id::LZ4, "lz4", LZ4::preset, LZ4::compressBound, LZ4::compress, LZ4::decompress},
+                {Id::LZ5, "lz5", LZ5::preset, LZ5::compressBound, LZ5::compress, LZ5::decompress},
+                {Id::LZW, "lzw", LZW::preset, LZW::compressBound, LZW::compress, LZW::decompress},
+                {Id::LZO, "lzo", LZO::preset, LZO::compressBound, LZO::compress, LZO::decompress},
+                {Id::LZSS, "lzss", LZSS::preset, LZSS::compressBound, LZSS::compress, LZSS::decompress},
+                {Id::FSE, "fse", FSE::preset, FSE::compressBound, FSE::compress, FSE::decompress},
+                {Id::Zstandard, "zstd", Zstandard::preset, Zstandard::compressBound, Zstandard::compress, Zstandard::decompress}};
+            return codecs;
+        }
+
+        // Evenly spread slices so a sample sees the whole input, not just its header.
+        std::string takeSample(ByteSpan input, size_t sampleSize) {
+            if (input.size <= sampleSize) {
+                return std::string((const char*)input.data, input.size);
             }
 
-            return tokens;
+            std::string sample;
+            sample.reserve(sampleSize);
+            size_t sliceSize = sampleSize / SAMPLE_SLICES;
+            for (size_t slice = 0; slice < SAMPLE_SLICES; ++slice) {
+                size_t start = (input.size - sliceSize) / (SAMPLE_SLICES - 1) * slice;
+                sample.append((const char*)input.data + start, sliceSize);
+            }
+            return sample;
         }
-    }
-}
 
-namespace LZSS {
-    LIBCOMPRA_API size_t findBestMatch(const std::string& input, size_t windowStart, size_t currentPos, size_t windowSize, size_t& bestOffset) {
-        size_t bestLength = 0;
-        bestOffset = 0;
+        // MB/s over bytes, repeating fn until the clock has something meaningful to report.
+        template <typename Fn>
+        double measureSpeed(size_t bytes, Fn&& fn) {
+            using Clock = std::chrono::steady_clock;
+            auto start = Clock::now();
+            double seconds = 0;
+            int runs = 0;
+            do {
+                fn();
+                ++runs;
+                seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            } while (seconds < MIN_TIMING_SECONDS && runs < MAX_TIMING_RUNS);
+
+            return seconds > 0 ? bytes * runs / seconds / 1e6 : std::numeric_limits<double>::infinity();
+        }
 
-        for (size_t j = windowStart; j < currentPos; ++j) {
-            size_t length = 0;
-            while (j + length < currentPos && currentPos + length < input.size() && input[j + length] == input[currentPos + length]) {
-                ++length;
-                if (length >= windowSize) break;
+        // Relative distance from the target's minimums; 0 when the selection qualifies.
+        double shortfall(const Selection& selection, const Target& target) {
+            double miss = 0;
+            if (target.minCompressSpeed > 0) {
+                miss += std::max(0.0, 1 - selection.compressSpeed / target.minCompressSpeed);
             }
-
-            if (length > bestLength) {
-                bestLength = length;
-                bestOffset = currentPos - j;
+            if (target.minRatio > 0) {
+                miss += std::max(0.0, 1 - selection.ratio / target.minRatio);
             }
+            return miss;
         }
 
-        return bestLength;
+        bool better(const Selection& a, const Selection& b, Objective objective) {
+            if (objective == Objective::Speed) {
+                return a.compressSpeed > b.compressSpeed;
+            }
+            return a.ratio > b.ratio || (a.ratio == b.ratio && a.compressSpeed > b.compressSpeed);
+        }
     }
 
-    LIBCOMPRA_API void addToken(std::vector<Token>& tokens, bool isLiteral, char literal, size_t offset, size_t length) {
-        tokens.push_back({isLiteral, literal, offset, length});
+    LIBCOMPRA_API std::vector<Codec> all() {
+        return registry();
     }
 
-    LIBCOMPRA_API std::vector<Token> compress(const std::string& input, size_t windowSize, size_t lookaheadSize) {
-        std::vector<Token> tokens;
-        size_t inputSize = input.size();
-        size_t i = 0;
-
-        while (i < inputSize) {
-            size_t bestOffset = 0;
-            size_t bestLength = findBestMatch(input, std::max(i - windowSize, size_t(0)), i, windowSize, bestOffset);
-
-            if (bestLength >= 3) {
-                addToken(tokens, false, '\0', bestOffset, bestLength);
-                i += bestLength;
-            } else {
-                addToken(tokens, true, input[i], 0, 0);
-                ++i;
-            }
+    LIBCOMPRA_API Codec find(Id id) {
+        for (const Codec& codec : registry()) {
+            if (codec.id == id) return codec;
         }
-
-        return tokens;
+        throw std::runtime_error("Unknown codec id " + std::to_string((int)id));
     }
 
-    LIBCOMPRA_API std::string decompress(const std::vector<Token>& tokens) {
-        std::string output;
+    LIBCOMPRA_API Codec find(std::string_view name) {
+        for (const Codec& codec : registry()) {
+            if (name == codec.name) return codec;
+        }
+        throw std::runtime_error("Unknown codec " + std::string(name));
+    }
 
-        for (const auto& token : tokens) {
-            if (token.isLiteral) {
-                output += token.literal;
-            } else {
-                size_t start = output.size() - token.offset;
-                for (size_t i = 0; i < token.length; ++i) {
-                    output += output[start + i];
-                }
+    LIBCOMPRA_API void add(const Codec& codec) {
+        if (!codec.name || !codec.preset || !codec.compressBound || !codec.compress || !codec.decompress) {
+            throw std::runtime_error("Codec registration is incomplete");
+        }
+        if ((uint8_t)codec.id < FIRST_CUSTOM_ID) {
+            throw std::runtime_error("Custom codec ids start at " + std::to_string(FIRST_CUSTOM_ID));
+        }
+        for (const Codec& existing : registry()) {
+            if (existing.id == codec.id || std::string_view(existing.name) == codec.name) {
+                throw std::runtime_error("Codec " + std::string(codec.name) + " is already registered");
             }
         }
+        registry().push_back(codec);
+    }
 
-        return output;
+    LIBCOMPRA_API void remove(Id id) {
+        if ((uint8_t)id < FIRST_CUSTOM_ID) {
+            throw std::runtime_error("Built-in codecs cannot be removed");
+        }
+        std::vector<Codec>& codecs = registry();
+        auto it = std::find_if(codecs.begin(), codecs.end(), [id](const Codec& codec) { return codec.id == id; });
+        if (it == codecs.end()) {
+            throw std::runtime_error("Unknown codec id " + std::to_string((int)id));
+        }
+        codecs.erase(it);
     }
 
-    namespace Utils {
-        LIBCOMPRA_API std::string serializeToken(const Token& token) {
-            if (token.isLiteral) {
-                return std::to_string(token.isLiteral) + "," + std::string(1, token.literal) + ",0,0";
-            } else {
-                return std::to_string(token.isLiteral) + ",\0," + std::to_string(token.offset) + "," + std::to_string(token.length);
+    LIBCOMPRA_API std::vector<Candidate> defaultCandidates() {
+        std::vector<Candidate> candidates;
+        for (const Codec& codec : registry()) {
+            for (int level : {MIN_LEVEL, DEFAULT_LEVEL, MAX_LEVEL}) {
+                candidates.push_back({codec.id, codec.preset(level)});
             }
         }
+        return candidates;
+    }
 
-        LIBCOMPRA_API std::string vectorToString(const std::vector<Token>& tokens) {
-            std::string result;
-            for (const auto& token : tokens) {
-                result += serializeToken(token) + ";";
-            }
-            if (!result.empty()) {
-                result.pop_back();
-            }
-            return result;
+    LIBCOMPRA_API Selection autoSelect(ByteSpan input, const Target& target, const std::vector<Candidate>& candidates, size_t sampleSize) {
+        if (candidates.empty()) {
+            throw std::runtime_error("autoSelect needs at least one candidate");
         }
 
-        LIBCOMPRA_API Token deserializeToken(const std::string& str) {
-            size_t firstComma = str.find(',');
-            size_t secondComma = str.find(',', firstComma + 1);
-            size_t thirdComma = str.find(',', secondComma + 1);
-            size_t fourthComma = str.find(',', thirdComma + 1);
+        std::string sample = takeSample(input, sampleSize);
+        ByteSpan source{(const uint8_t*)sample.data(), sample.size()};
+        std::vector<uint8_t> restored(sample.size());
+        std::vector<uint8_t> compressed;
 
-            bool isLiteral = std::stoi(str.substr(0, firstComma));
-            char literal = str[secondComma + 1];
-            size_t offset = std::stoull(str.substr(thirdComma + 1, fourthComma - thirdComma - 1));
-            size_t length = std::stoull(str.substr(fourthComma + 1));
+        bool found = false;
+        Selection best{};
+        double bestMiss = 0;
 
-            return {isLiteral, literal, offset, length};
-        }
+        for (const Candidate& candidate : candidates) {
+            Codec codec = find(candidate.codec);
+            compressed.resize(codec.compressBound(sample.size()));
 
-        LIBCOMPRA_API std::vector<Token> stringToVector(const std::string& str) {
-            std::vector<Token> tokens;
-            size_t start = 0;
-            size_t end;
+            Result packed{0, Error::None};
+            double compressSpeed = measureSpeed(sample.size(), [&] {
+                packed = codec.compress(source, {compressed.data(), compressed.size()}, candidate.params);
+            });
+            if (!packed.ok()) continue;
 
-            while ((end = str.find(';', start)) != std::string::npos) {
-                tokens.push_back(deserializeToken(str.substr(start, end - start)));
-                start = end + 1;
+            Result unpacked{0, Error::None};
+            double decompressSpeed = measureSpeed(sample.size(), [&] {
+                unpacked = codec.decompress({compressed.data(), packed.size}, {restored.data(), restored.size()});
+            });
+            // A candidate that cannot reproduce the sample is never worth choosing.
+            if (!unpacked.ok() || unpacked.size != sample.size() || !std::equal(sample.begin(), sample.end(), restored.begin(), [](char a, uint8_t b) { return (uint8_t)a == b; })) {
+                continue;
             }
 
-            if (start < str.size()) {
-                tokens.push_back(deserializeToken(str.substr(start)));
+            double ratio = (sample.empty() || packed.size == 0) ? 1.0 : (double)sample.size() / packed.size;
+            Selection selection{candidate.codec, candidate.params, ratio, compressSpeed, decompressSpeed, false};
+            double miss = shortfall(selection, target);
+            selection.meetsTarget = miss == 0;
+
+            if (!found || miss < bestMiss || (miss == bestMiss && better(selection, best, target.objective))) {
+                best = selection;
+                bestMiss = miss;
+                found = true;
             }
+        }
 
-            return tokens;
+        if (!found) {
+            throw std::runtime_error("No autoSelect candidate round-tripped the sample");
         }
+        return best;
     }
 }
 
-namespace FSE {
-    namespace Methods {
-        LIBCOMPRA_API EncodingTable buildEncodingTable(const std::string& input) {
-            FrequencyTable frequencyTable;
-            for (char c : input) {
-                ++frequencyTable[c];
+namespace {
+    // Runs task(0) .. task(count - 1) on up to threads workers, the calling thread included.
+    // Each worker starts with a contiguous run of indices in its own deque, takes from the
+    // front of it, and once it runs dry steals from the back of the others'. The first
+    // exception stops further tasks and is rethrown once every worker has finished.
+    void runParallel(size_t count, unsigned threads, const std::function<void(size_t)>& task) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = (unsigned)std::min<size_t>(threads, count);
+        if (threads <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                task(i);
             }
+            return;
+        }
 
-            std::vector<Symbol> symbols;
-            for (const auto& [character, frequency] : frequencyTable) {
-                symbols.push_back({character, frequency});
+        struct Queue {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+        std::vector<Queue> queues(threads);
+        for (unsigned worker = 0; worker < threads; ++worker) {
+            for (size_t i = count * worker / threads; i < count * (worker + 1) / threads; ++i) {
+                queues[worker].tasks.push_back(i);
             }
+        }
 
-            std::sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) {
-                return a.frequency > b.frequency;
-            });
-
-            std::map<char, EncodedSymbol> encodingTable;
-            for (size_t i = 0; i < symbols.size(); ++i) {
-                std::string binaryCode;
-                for (size_t bit = 0; bit < std::ceil(std::log2(symbols.size())); ++bit) {
-                    binaryCode += ((i >> bit) & 1) ? '1' : '0';
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto next = [&](unsigned worker, size_t& index) {
+            for (unsigned k = 0; k < threads; ++k) {
+                Queue& queue = queues[(worker + k) % threads];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tasks.empty()) continue;
+                if (k == 0) {
+                    index = queue.tasks.front();
+                    queue.tasks.pop_front();
+                } else {
+                    index = queue.tasks.back();
+                    queue.tasks.pop_back();
                 }
-                encodingTable[symbols[i].character] = {symbols[i].character, binaryCode};
+                return true;
             }
-
-            return encodingTable;
-        }
-
-        LIBCOMPRA_API ByteVector PackBitsToBytes(const std::string& bitString) {
-            ByteVector byteVec;
-            uint8_t currentByte = 0;
-            size_t bitCount = 0;
-
-            for (char bit : bitString) {
-                currentByte = (currentByte << 1) | (bit == '1' ? 1 : 0);
-                ++bitCount;
-
-                if (bitCount == 8) {
-                    byteVec.push_back(currentByte);
-                    currentByte = 0;
-                    bitCount = 0;
+            return false;
+        };
+
+        auto work = [&](unsigned worker) {
+            size_t index;
+            while (!failed && next(worker, index)) {
+                try {
+                    task(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    failed = true;
                 }
             }
+        };
 
-            if (bitCount > 0) {
-                currentByte <<= (8 - bitCount);
-                byteVec.push_back(currentByte);
+        std::vector<std::thread> workers;
+        try {
+            for (unsigned worker = 1; worker < threads; ++worker) {
+                workers.emplace_back(work, worker);
             }
-
-            return byteVec;
+        } catch (...) {
+            // Could not start every thread; the ones running plus this one still drain the queues.
+        }
+        work(0);
+        for (auto& thread : workers) {
+            thread.join();
         }
 
-        LIBCOMPRA_API std::string UnpackBytesToBits(const ByteVector& byteVec) {
-            std::string bitString;
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
 
-            for (uint8_t byte : byteVec) {
-                for (int i = 7; i >= 0; --i) {
-                    bitString += (byte & (1 << i)) ? '1' : '0';
-                }
+    // Compresses every blockSize slice of input with codec, on up to threads workers. A nonzero
+    // dictionarySize lets each block match into the tail of the input before it.
+    std::vector<std::string> compressBlocks(std::string_view input, size_t blockSize, const Codecs::Codec& codec, const Params& params, size_t dictionarySize, unsigned threads) {
+        size_t blocks = input.empty() ? 0 : (input.size() - 1) / blockSize + 1;
+        std::vector<std::string> packed(blocks);
+
+        // The dictionary comes from the input, so linked blocks still compress in parallel.
+        runParallel(blocks, threads, [&](size_t block) {
+            size_t start = block * blockSize;
+            std::string_view source = input.substr(start, blockSize);
+            std::string& out = packed[block];
+            out.resize(codec.compressBound(source.size()));
+
+            ByteSpan span{(const uint8_t*)source.data(), source.size()};
+            MutableByteSpan target{(uint8_t*)&out[0], out.size()};
+            Result result;
+            if (dictionarySize > 0) {
+                size_t reach = std::min(dictionarySize, start);
+                result = codec.compressWithDictionary({(const uint8_t*)source.data() - reach, reach}, span, target, params);
+            } else {
+                result = codec.compress(span, target, params);
+            }
+            if (!result.ok()) {
+                throw std::runtime_error(std::string("Block failed to compress with ") + codec.name);
             }
+            out.resize(result.size);
+            out.shrink_to_fit();
+        });
+        return packed;
+    }
 
-            return bitString;
+    // Largest block a Parallel stream or frame a Seekable stream may declare.
+    constexpr uint64_t MAX_CONTAINER_BLOCK = uint64_t(1) << 30;
+
+    // Deflate's 1032:1 is the highest expansion among the codecs that cannot tell their output
+    // size before decoding.
+    constexpr size_t MAX_BLIND_EXPANSION = 1032;
+
+    // Whether a compressed block can plausibly decode to length bytes, asked before allocating
+    // room for them. Past MAX_BLIND_EXPANSION the codec has to confirm the size by reporting it
+    // for an empty output, which costs a header or token pass but no output.
+    bool plausibleLength(const Codecs::Codec& codec, ByteSpan input, uint64_t length) {
+        if (length / MAX_BLIND_EXPANSION <= input.size) {
+            return true;
         }
+        uint8_t none;
+        Result probe = codec.decompress(input, {&none, 0});
+        return probe.error == Error::OutputTooSmall && probe.size == length;
+    }
+}
 
-        LIBCOMPRA_API ByteVector PackBitsToBytes(const std::string& bitString, size_t& bitLength) {
-            ByteVector byteVec;
-            uint8_t currentByte = 0;
-            size_t bitCount = 0;
+namespace Parallel {
+    namespace {
+        constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+        struct Frame {
+            Codecs::Codec codec;
+            size_t blockSize;
+            size_t dictionarySize;
+            size_t contentSize;
+            std::vector<size_t> offsets; // compressed block i spans offsets[i] .. offsets[i + 1]
+            std::vector<bool> stored;
+            const char* payload;
+        };
+
+        inline size_t blockLength(const Frame& frame, size_t block) {
+            return std::min(frame.blockSize, frame.contentSize - block * frame.blockSize);
+        }
 
-            bitLength = bitString.size();
+        Frame readFrame(std::string_view input) {
+            ByteReader reader((const unsigned char*)input.data(), input.size(), "Invalid parallel input");
+            Frame frame;
+            frame.codec = Codecs::find((Codecs::Id)reader.byte());
+            frame.blockSize = reader.varint();
+            frame.dictionarySize = reader.varint();
+            frame.contentSize = reader.varint();
+            if (frame.blockSize == 0 || frame.blockSize > MAX_CONTAINER_BLOCK) {
+                throw std::runtime_error("Invalid parallel input");
+            }
 
-            for (char bit : bitString) {
-                currentByte = (currentByte << 1) | (bit == '1' ? 1 : 0);
-                ++bitCount;
+            // Every block costs at least one byte of the size table.
+            size_t blocks = frame.contentSize == 0 ? 0 : (frame.contentSize - 1) / frame.blockSize + 1;
+            if (blocks > reader.remaining()) {
+                throw std::runtime_error("Invalid parallel input");
+            }
+            if (frame.dictionarySize > 0 && !frame.codec.decompressWithDictionary) {
+                throw std::runtime_error("Parallel input needs a dictionary the codec cannot take");
+            }
 
-                if (bitCount == 8) {
-                    byteVec.push_back(currentByte);
-                    currentByte = 0;
-                    bitCount = 0;
+            frame.offsets.assign(1, 0);
+            for (size_t block = 0; block < blocks; ++block) {
+                uint64_t header = reader.varint();
+                size_t size = (size_t)(header >> 1);
+                if (size > reader.remaining() || ((header & 1) && size != blockLength(frame, block))) {
+                    throw std::runtime_error("Invalid parallel input");
                 }
+                frame.offsets.push_back(frame.offsets.back() + size);
+                frame.stored.push_back(header & 1);
             }
-
-            if (bitCount > 0) {
-                currentByte <<= (8 - bitCount);
-                byteVec.push_back(currentByte);
+            if (frame.offsets.back() != reader.remaining()) {
+                throw std::runtime_error("Invalid parallel input");
             }
+            frame.payload = (const char*)reader.ip;
 
-            return byteVec;
+            // The output is allocated from contentSize, so every block must back its share first.
+            for (size_t block = 0; block < blocks; ++block) {
+                ByteSpan packed{(const uint8_t*)frame.payload + frame.offsets[block], frame.offsets[block + 1] - frame.offsets[block]};
+                if (!frame.stored[block] && !plausibleLength(frame.codec, packed, blockLength(frame, block))) {
+                    throw std::runtime_error("Invalid parallel input");
+                }
+            }
+            return frame;
         }
 
-        LIBCOMPRA_API std::string UnpackBytesToBits(const ByteVector& byteVec, size_t bitLength) {
-            std::string bitString;
+        void decodeBlock(const Frame& frame, size_t block, char* output, size_t start) {
+            const char* source = frame.payload + frame.offsets[block];
+            size_t size = frame.offsets[block + 1] - frame.offsets[block];
+            size_t length = blockLength(frame, block);
+            char* target = output + start;
 
-            for (uint8_t byte : byteVec) {
-                for (int i = 7; i >= 0; --i) {
-                    bitString += (byte & (1 << i)) ? '1' : '0';
-                }
+            if (frame.stored[block]) {
+                std::memcpy(target, source, length);
+                return;
             }
 
-            return bitString.substr(0, bitLength);
+            ByteSpan input{(const uint8_t*)source, size};
+            MutableByteSpan out{(uint8_t*)target, length};
+            Result result;
+            if (frame.dictionarySize > 0) {
+                size_t reach = std::min(frame.dictionarySize, start);
+                result = frame.codec.decompressWithDictionary({(const uint8_t*)target - reach, reach}, input, out);
+            } else {
+                result = frame.codec.decompress(input, out);
+            }
+            if (!result.ok() || result.size != length) {
+                throw std::runtime_error("Invalid parallel input");
+            }
         }
     }
 
-    LIBCOMPRA_API Compressed compress(const std::string& input) {
-        auto encodingTable = Methods::buildEncodingTable(input);
-        std::string encodedString;
+    LIBCOMPRA_API Options defaults(Codecs::Id codec, int level) {
+        return {codec, Codecs::find(codec).preset(level), DEFAULT_BLOCK_SIZE, 0, 0};
+    }
 
-        for (char c : input) {
-            encodedString += encodingTable[c].code;
+    LIBCOMPRA_API std::string compress(std::string_view input, const Options& options) {
+        Codecs::Codec codec = Codecs::find(options.codec);
+        if (options.blockSize == 0 || options.blockSize > MAX_CONTAINER_BLOCK) {
+            throw std::runtime_error("Parallel block size must be between 1 byte and 1 GiB");
+        }
+        if (options.dictionarySize > 0 && !codec.compressWithDictionary) {
+            throw std::runtime_error(std::string("Codec ") + codec.name + " does not support dictionaries");
         }
 
-        size_t bitLength = 0;
-        ByteVector packedBits = Methods::PackBitsToBytes(encodedString, bitLength);
-
-        return {packedBits, encodingTable, bitLength};
-    }
+        std::vector<std::string> packed = compressBlocks(input, options.blockSize, codec, options.params, options.dictionarySize, options.threads);
+        size_t blocks = packed.size();
 
-    LIBCOMPRA_API std::string decompress(const Compressed& compressed) {
-        std::map<std::string, char> reverseTable;
-        for (const auto& [character, symbol] : compressed.encodingTable) {
-            reverseTable[symbol.code] = character;
+        std::string output;
+        output += (char)codec.id;
+        writeVarint(output, options.blockSize);
+        writeVarint(output, options.dictionarySize);
+        writeVarint(output, input.size());
+
+        // Blocks that do not shrink are stored, flagged in the low bit of their size.
+        size_t total = 0;
+        std::vector<bool> stored(blocks);
+        for (size_t block = 0; block < blocks; ++block) {
+            size_t length = std::min(options.blockSize, input.size() - block * options.blockSize);
+            stored[block] = packed[block].size() >= length;
+            size_t size = stored[block] ? length : packed[block].size();
+            writeVarint(output, (size << 1) | (stored[block] ? 1 : 0));
+            total += size;
         }
 
-        std::string unpackedBytes = Methods::UnpackBytesToBits(compressed.byteVec, compressed.bitLength);
-        std::string decodedString;
-        std::string currentCode;
-        for (char bit : unpackedBytes) {
-            currentCode += bit;
-            if (reverseTable.find(currentCode) != reverseTable.end()) {
-                decodedString += reverseTable[currentCode];
-                currentCode.clear();
+        output.reserve(output.size() + total);
+        for (size_t block = 0; block < blocks; ++block) {
+            if (stored[block]) {
+                output.append(input.substr(block * options.blockSize, options.blockSize));
+            } else {
+                output += packed[block];
             }
+            std::string().swap(packed[block]);
         }
+        return output;
+    }
+
+    LIBCOMPRA_API std::string decompress(std::string_view input, unsigned threads) {
+        Frame frame = readFrame(input);
+        std::string output(frame.contentSize, '\0');
+        size_t blocks = frame.stored.size();
 
-        return decodedString;
+        if (frame.dictionarySize > 0) {
+            for (size_t block = 0; block < blocks; ++block) {
+                decodeBlock(frame, block, &output[0], block * frame.blockSize);
+            }
+        } else {
+            runParallel(blocks, threads, [&](size_t block) {
+                decodeBlock(frame, block, &output[0], block * frame.blockSize);
+            });
+        }
+        return output;
     }
+}
 
-    LIBCOMPRA_API std::string decompress(const ByteVector& encoded, const std::map<char, EncodedSymbol>& encodingTable, size_t bitLength) {
-        std::map<std::string, char> reverseTable;
-        for (const auto& [character, symbol] : encodingTable) {
-            reverseTable[symbol.code] = character;
+namespace Seekable {
+    namespace {
+        constexpr size_t DEFAULT_FRAME_SIZE = 64 * 1024;
+        constexpr uint64_t MAX_FRAME_SIZE = MAX_CONTAINER_BLOCK;
+        constexpr uint32_t MAGIC = 0x4B535043; // "CPSK"
+        constexpr size_t ENTRY_SIZE = 16;      // compressed end, then uncompressed end
+        constexpr size_t FOOTER_SIZE = 13;     // frame count, codec id, magic
+
+        // Index fields are fixed-width little-endian so any entry can be read in place.
+        void writeLE(std::string& out, uint64_t value, size_t bytes) {
+            for (size_t i = 0; i < bytes; ++i) {
+                out += (char)(value >> (8 * i));
+            }
         }
 
-        std::string unpackedBytes = Methods::UnpackBytesToBits(encoded, bitLength);
-        std::string decodedString;
-        std::string currentCode;
-        for (char bit : unpackedBytes) {
-            currentCode += bit;
-            if (reverseTable.find(currentCode) != reverseTable.end()) {
-                decodedString += reverseTable[currentCode];
-                currentCode.clear();
+        uint64_t readLE(const char* p, size_t bytes) {
+            uint64_t value = 0;
+            for (size_t i = bytes; i-- > 0;) {
+                value = (value << 8) | (unsigned char)p[i];
             }
+            return value;
         }
 
-        return decodedString;
-    }
+        struct Index {
+            Codecs::Codec codec;
+            const char* data;
+            const char* entries;
+            size_t frames;
 
-    namespace Stringize {
-        LIBCOMPRA_API std::string StringizeEncodingTable(const FSE::EncodingTable& freqMap) {
-            std::stringstream ss;
+            uint64_t compressedStart(size_t frame) const {
+                return frame == 0 ? 0 : readLE(entries + (frame - 1) * ENTRY_SIZE, 8);
+            }
 
-            for (const auto& pair : freqMap) {
-                ss << "'" << pair.first << "'" << ":" << "'" << pair.second.character << "'" << " "; 
+            uint64_t contentStart(size_t frame) const {
+                return frame == 0 ? 0 : readLE(entries + (frame - 1) * ENTRY_SIZE + 8, 8);
             }
 
-            return ss.str();
-        }
+            // The frame holding content byte pos; pos must be below the content size.
+            size_t frameAt(uint64_t pos) const {
+                size_t low = 0;
+                size_t high = frames - 1;
+                while (low < high) {
+                    size_t mid = low + (high - low) / 2;
+                    if (contentStart(mid + 1) <= pos) {
+                        low = mid + 1;
+                    } else {
+                        high = mid;
+                    }
+                }
+                return low;
+            }
+        };
 
-        LIBCOMPRA_API std::string StringizeByteVec(const FSE::ByteVector& byteVec) {
-            std::stringstream ss;
+        Index readIndex(std::string_view input) {
+            const char* end = input.data() + input.size();
+            if (input.size() < FOOTER_SIZE || readLE(end - 4, 4) != MAGIC) {
+                throw std::runtime_error("Invalid seekable input");
+            }
 
-            for (size_t i = 0; i < byteVec.size(); ++i) {
-                ss << byteVec[i];
+            Index index;
+            index.codec = Codecs::find((Codecs::Id)(unsigned char)end[-5]);
+            index.data = input.data();
+            uint64_t frames = readLE(end - FOOTER_SIZE, 8);
+            if (frames > (input.size() - FOOTER_SIZE) / ENTRY_SIZE) {
+                throw std::runtime_error("Invalid seekable input");
             }
+            index.frames = (size_t)frames;
+            index.entries = end - FOOTER_SIZE - index.frames * ENTRY_SIZE;
 
-            return ss.str();
+            // Entries are checked as frames get used, so opening a large index stays cheap.
+            if (index.compressedStart(index.frames) != (uint64_t)(index.entries - input.data())) {
+                throw std::runtime_error("Invalid seekable input");
+            }
+            return index;
         }
-    }
-}
 
-namespace Zstandard {
-    LIBCOMPRA_API FSE::Compressed compress(const std::string& input, size_t windowSize) {
-        std::vector<LZ77::Token> lz77Tokens = LZ77::compress(input, windowSize);
+        // A frame is non-empty, compresses to at most its content size, lies in the data, and
+        // its compressed bytes can plausibly produce its content.
+        void checkFrame(const Index& index, size_t frame) {
+            uint64_t start = index.compressedStart(frame);
+            uint64_t end = index.compressedStart(frame + 1);
+            uint64_t contentStart = index.contentStart(frame);
+            uint64_t contentEnd = index.contentStart(frame + 1);
+            if (end <= start || end > (uint64_t)(index.entries - index.data) || contentEnd <= contentStart ||
+                contentEnd - contentStart > MAX_FRAME_SIZE || end - start > contentEnd - contentStart) {
+                throw std::runtime_error("Invalid seekable input");
+            }
+            ByteSpan packed{(const uint8_t*)index.data + start, (size_t)(end - start)};
+            if (end - start < contentEnd - contentStart && !plausibleLength(index.codec, packed, contentEnd - contentStart)) {
+                throw std::runtime_error("Invalid seekable input");
+            }
+        }
 
-        std::string lz77Compressed = LZ77::Utils::vectorToString(lz77Tokens);
+        // A frame whose compressed size equals its content size is stored verbatim.
+        void decodeFrame(const Index& index, size_t frame, char* output) {
+            uint64_t start = index.compressedStart(frame);
+            size_t size = (size_t)(index.compressedStart(frame + 1) - start);
+            size_t length = (size_t)(index.contentStart(frame + 1) - index.contentStart(frame));
 
-        auto [byteVec, encodingTable, bitLength] = FSE::compress(lz77Compressed);
+            if (size == length) {
+                std::memcpy(output, index.data + start, length);
+                return;
+            }
+            Result result = index.codec.decompress({(const uint8_t*)index.data + start, size}, {(uint8_t*)output, length});
+            if (!result.ok() || result.size != length) {
+                throw std::runtime_error("Invalid seekable input");
+            }
+        }
+    }
 
-        return {byteVec, encodingTable, bitLength};
+    LIBCOMPRA_API Options defaults(Codecs::Id codec, int level) {
+        return {codec, Codecs::find(codec).preset(level), DEFAULT_FRAME_SIZE, 0};
     }
 
-    LIBCOMPRA_API std::string decompress(const FSE::ByteVector& byteVec, const FSE::EncodingTable& encodingTable, const size_t bitLength) {
-        std::string decodedData = FSE::decompress(byteVec, encodingTable, bitLength);
+    LIBCOMPRA_API std::string compress(std::string_view input, const Options& options) {
+        Codecs::Codec codec = Codecs::find(options.codec);
+        if (options.frameSize == 0 || options.frameSize > MAX_FRAME_SIZE) {
+            throw std::runtime_error("Seekable frame size must be between 1 byte and 1 GiB");
+        }
+
+        std::vector<std::string> packed = compressBlocks(input, options.frameSize, codec, options.params, 0, options.threads);
+        size_t frames = packed.size();
+
+        std::string output;
+        std::string index;
+        index.reserve(frames * ENTRY_SIZE + FOOTER_SIZE);
+        for (size_t frame = 0; frame < frames; ++frame) {
+            std::string_view source = input.substr(frame * options.frameSize, options.frameSize);
+            // Frames that do not shrink are stored, which their equal sizes in the index tell.
+            if (packed[frame].size() >= source.size()) {
+                output.append(source);
+            } else {
+                output += packed[frame];
+            }
+            std::string().swap(packed[frame]);
+
+            writeLE(index, output.size(), 8);
+            writeLE(index, frame * options.frameSize + source.size(), 8);
+        }
 
-        std::vector<LZ77::Token> lz77Tokens = LZ77::Utils::stringToVector(decodedData);
+        writeLE(index, frames, 8);
+        index += (char)codec.id;
+        writeLE(index, MAGIC, 4);
+        output += index;
+        return output;
+    }
 
-        return LZ77::decompress(lz77Tokens);
+    LIBCOMPRA_API uint64_t contentSize(std::string_view input) {
+        Index index = readIndex(input);
+        return index.contentStart(index.frames);
     }
 
-    LIBCOMPRA_API std::string decompress(const FSE::Compressed& compressed) {
-        std::string decodedData = FSE::decompress(compressed.byteVec, compressed.encodingTable, compressed.bitLength);
+    LIBCOMPRA_API std::string decompressRange(std::string_view input, uint64_t offset, size_t length, unsigned threads) {
+        Index index = readIndex(input);
+        uint64_t total = index.contentStart(index.frames);
+        if (offset > total) {
+            throw std::runtime_error("Seekable range starts past the end of the content");
+        }
+
+        length = (size_t)std::min<uint64_t>(length, total - offset);
+        if (length == 0) {
+            return std::string();
+        }
+
+        // The index is untrusted: every frame in range is checked before the output is sized from it.
+        size_t first = index.frameAt(offset);
+        size_t last = index.frameAt(offset + length - 1);
+        for (size_t frame = first; frame <= last; ++frame) {
+            checkFrame(index, frame);
+        }
+        if (last < first || index.contentStart(first) > offset || index.contentStart(last + 1) < offset + length) {
+            throw std::runtime_error("Invalid seekable input");
+        }
+
+        std::string output(length, '\0');
+
+        runParallel(last - first + 1, threads, [&](size_t i) {
+            size_t frame = first + i;
+            uint64_t start = index.contentStart(frame);
+            uint64_t end = index.contentStart(frame + 1);
+            uint64_t from = std::max(start, offset);
+            uint64_t to = std::min<uint64_t>(end, offset + length);
 
-        std::vector<LZ77::Token> lz77Tokens = LZ77::Utils::stringToVector(decodedData);
+            // Whole frames decode in place; the partial ones at either edge go through scratch.
+            if (from == start && to == end) {
+                decodeFrame(index, frame, &output[start - offset]);
+            } else {
+                std::string scratch(end - start, '\0');
+                decodeFrame(index, frame, &scratch[0]);
+                std::memcpy(&output[from - offset], scratch.data() + (from - start), to - from);
+            }
+        });
+        return output;
+    }
 
-        return LZ77::decompress(lz77Tokens);
+    LIBCOMPRA_API std::string decompress(std::string_view input, unsigned threads) {
+        return decompressRange(input, 0, std::numeric_limits<size_t>::max(), threads);
     }
 }
 } // Compra
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <functional>
 #include <cassert>
+#include <exception>
 
 class TestCase {
 public:
@@ -48,6 +49,17 @@ public:
 #define ASSERT_TRUE(cond) \
     assert(!(cond))
 
+#define ASSERT_THROWS(...) \
+    do { \
+        bool threw = false; \
+        try { \
+            __VA_ARGS__; \
+        } catch (const std::exception&) { \
+            threw = true; \
+        } \
+        assert(threw); \
+    } while (0)
+
 #define RUN_ALL_TESTS() \
     int main() { \
         TestRegistry::instance().runAll(); \
@@ -9,76 +9,853 @@ std::string input = "HELLO WORLD "
                     "FOO BAR "
                     "1337";
 
+// Lines of input tagged with a scrambled number and "ok"; every nulEvery-th line (none for 0)
+// ends in a NUL and a 0xff byte instead.
+std::string makeText(int lines, int nulEvery = 5) {
+    std::string text;
+    for (int i = 0; i < lines; ++i) {
+        bool binary = nulEvery > 0 && i % nulEvery == 0;
+        text += input + " #" + std::to_string(i * i % 1009) + (binary ? std::string(" \0\xff\n", 4) : " ok\n");
+    }
+    return text;
+}
+
+// Incompressible bytes from a linear congruential generator.
+std::string makeNoise(size_t size, uint32_t seed) {
+    std::string noise;
+    for (size_t i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        noise += (char)(seed >> 16);
+    }
+    return noise;
+}
+
+TEST_CASE(bitio, Bit Writer And Reader) {
+    BitIO::BitWriter writer;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        writer.write(i * 2654435761u, i % 41);
+    }
+    size_t bitLength = writer.bitLength;
+    auto bytes = writer.finish();
+    ASSERT_EQ(bytes.size(), (bitLength + 7) / 8);
+
+    BitIO::BitReader reader(bytes.data(), bytes.size());
+    for (uint64_t i = 0; i < 1000; ++i) {
+        size_t bits = i % 41;
+        uint64_t expected = (i * 2654435761u) & ((uint64_t(1) << bits) - 1);
+        ASSERT_EQ(reader.read(bits), expected);
+    }
+    ASSERT_EQ(reader.consumedBits(), bitLength);
+
+    size_t packedLength = 0;
+    auto packed = Huffman::Methods::PackBitsToBytes("1011001110001", packedLength);
+    ASSERT_EQ(packedLength, size_t(13));
+    ASSERT_EQ(Huffman::Methods::UnpackBytesToBits(packed, packedLength), std::string("1011001110001"));
+}
+
 TEST_CASE(lz77, LZ77 Compression) {
     auto compressed = LZ77::compress(input);
     auto decompressed = LZ77::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lz77_hash_chain, LZ77 Hash Chain) {
+    std::string repeated;
+    for (int i = 0; i < 2000; ++i) {
+        repeated += input + std::to_string(i % 37);
+    }
+    auto compressed = LZ77::compress(repeated, 32 * 1024, 16);
+    auto decompressed = LZ77::decompress(compressed);
+    ASSERT_EQ(repeated, decompressed);
+    ASSERT_EQ((compressed.size() < repeated.size() / 8), true);
+}
+
+TEST_CASE(lz77_streaming, LZ77 Streaming) {
+    std::string text;
+    for (int i = 0; i < 6000; ++i) {
+        text += "line " + std::to_string(i % 97) + (i % 5 ? ": ok " : std::string(": \0\xff ", 5)) + input + "\n";
+    }
+
+    LZ77::Compressor compressor(4096);
+    std::string compressed;
+    size_t chunk = 1;
+    for (size_t pos = 0; pos < text.size(); pos += chunk, chunk = chunk * 3 % 7919 + 1) {
+        compressor.update(text.substr(pos, chunk), compressed);
+        if (pos % 11 == 0) {
+            compressor.flush(compressed);
+        }
+        ASSERT_EQ((compressor.buffer.size() < 3 * 4096 + LZ77::MAX_STREAM_MATCH + 8000), true);
+    }
+    compressor.finish(compressed);
+    ASSERT_EQ((compressed.size() < text.size() / 4), true);
+
+    LZ77::Decompressor decompressor(4096);
+    std::string output;
+    for (size_t pos = 0; pos < compressed.size(); pos += 5) {
+        ASSERT_EQ(decompressor.update(compressed.substr(pos, 5), output), (pos + 5 >= compressed.size()));
+        ASSERT_EQ((decompressor.history.size() <= 2 * 4096 + 5 * (LZ77::MAX_STREAM_MATCH + 1)), true);
+    }
+    ASSERT_EQ(text, output);
+
+    // One chunk holding the whole stream still keeps only a window of history.
+    LZ77::Decompressor whole(4096);
+    output.clear();
+    ASSERT_EQ(whole.update(compressed, output), true);
+    ASSERT_EQ(text, output);
+    ASSERT_EQ((whole.history.size() <= 2 * 4096 + LZ77::MAX_STREAM_MATCH + 1), true);
+
+    LZ77::Compressor empty;
+    std::string stream;
+    empty.finish(stream);
+    LZ77::Decompressor emptyDecoder;
+    output.clear();
+    ASSERT_EQ(emptyDecoder.update(stream, output), true);
+    ASSERT_EQ(output, std::string());
+
+    LZ77::Decompressor narrow(16);
+    ASSERT_THROWS(narrow.update(compressed, output));
+}
+
+TEST_CASE(token_codecs, Binary Token Codecs) {
+    std::string text;
+    for (int i = 0; i < 500; ++i) {
+        text += "a,b;c" + std::to_string(i % 17) + std::string(1, '\0') + ";;,," + input;
+    }
+
+    auto lz77Tokens = LZ77::compress(text);
+    auto lz77Encoded = LZ77::Utils::encodeTokens(lz77Tokens);
+    ASSERT_EQ(text, LZ77::decompress(LZ77::Utils::decodeTokens(lz77Encoded)));
+    ASSERT_EQ((lz77Encoded.size() < LZ77::Utils::vectorToString(lz77Tokens).size() / 2), true);
+
+    auto lz78Tokens = LZ78::compress(text);
+    ASSERT_EQ(text, LZ78::decompress(LZ78::Utils::decodeTokens(LZ78::Utils::encodeTokens(lz78Tokens))));
+
+    auto lzmaTokens = LZMA::compress(text);
+    ASSERT_EQ(text, LZMA::decompress(LZMA::Utils::decodeTokens(LZMA::Utils::encodeTokens(lzmaTokens))));
+
+    auto lz5Tokens = LZ5::compress(text);
+    ASSERT_EQ(text, LZ5::decompress(LZ5::Utils::decodeTokens(LZ5::Utils::encodeTokens(lz5Tokens))));
+
+    auto lzoTokens = LZO::compress(text);
+    ASSERT_EQ(text, LZO::decompress(LZO::Utils::decodeTokens(LZO::Utils::encodeTokens(lzoTokens))));
+
+    auto lzssTokens = LZSS::compress(text);
+    auto lzssDecoded = LZSS::Utils::decodeTokens(LZSS::Utils::encodeTokens(lzssTokens));
+    ASSERT_EQ(text, LZSS::decompress(lzssDecoded));
+
+    ASSERT_THROWS(LZ77::Utils::decodeTokens(lz77Encoded.substr(0, lz77Encoded.size() - 1)));
+}
+
+TEST_CASE(lz_overlapping_copies, LZ Overlapping Copies) {
+    std::vector<LZ77::Token> tokens = {{0, 0, 'a'}, {0, 0, 'b'}, {0, 0, '\0'}};
+    std::string expected = std::string("ab") + '\0';
+    for (size_t offset : {1, 2, 3, 7, 8, 15, 16, 33}) {
+        for (size_t length : {1, 5, 8, 9, 17, 40, 300}) {
+            size_t start = expected.size() - std::min(offset, expected.size());
+            size_t distance = expected.size() - start;
+            for (size_t i = 0; i < length; ++i) {
+                expected += expected[start + i];
+            }
+            expected += (char)('c' + length % 7);
+            tokens.push_back({distance, length, (char)('c' + length % 7)});
+        }
+    }
+    ASSERT_EQ(expected, LZ77::decompress(tokens));
+
+    std::vector<LZ5::Token> lz5Tokens;
+    std::vector<LZO::Token> lzoTokens;
+    std::vector<LZMA::Token> lzmaTokens;
+    std::vector<LZSS::Token> lzssTokens;
+    for (const auto& token : tokens) {
+        lz5Tokens.push_back({token.offset, token.length, token.next});
+        lzoTokens.push_back({token.offset, token.length, token.next});
+        lzmaTokens.push_back({token.offset, token.length, token.next});
+        if (token.length > 0) {
+            lzssTokens.push_back({false, '\0', token.offset, token.length});
+        }
+        lzssTokens.push_back({true, token.next, 0, 0});
+    }
+    ASSERT_EQ(expected, LZ5::decompress(lz5Tokens));
+    ASSERT_EQ(expected, LZO::decompress(lzoTokens));
+    ASSERT_EQ(expected, LZMA::decompress(lzmaTokens));
+    ASSERT_EQ(expected, LZSS::decompress(lzssTokens));
+
+    ASSERT_THROWS(LZ77::decompress({{0, 0, 'a'}, {2, 4, 'b'}}));
+}
+
 TEST_CASE(lz78, LZ78 Compression) {
     auto compressed = LZ78::compress(input);
     auto decompressed = LZ78::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lz78_trie, LZ78 Bounded Trie) {
+    std::string text = makeText(5000);
+
+    for (size_t maxDictionarySize : {1, 2, 256, 4096, 65536}) {
+        auto tokens = LZ78::compress(text, maxDictionarySize);
+        ASSERT_EQ(text, LZ78::decompress(tokens, maxDictionarySize));
+        for (const auto& token : tokens) {
+            ASSERT_EQ((token.index < maxDictionarySize), true);
+        }
+    }
+    ASSERT_EQ((LZ78::compress(text).size() < LZ78::compress(text, 256).size()), true);
+
+    std::string run(200000, 'a');
+    auto runTokens = LZ78::compress(run);
+    ASSERT_EQ(run, LZ78::decompress(runTokens));
+    ASSERT_EQ((runTokens.size() < 700), true);
+
+    for (size_t size = 0; size < 12; ++size) {
+        std::string small = run.substr(0, size);
+        ASSERT_EQ(small, LZ78::decompress(LZ78::compress(small)));
+    }
+
+    ASSERT_THROWS(LZ78::decompress({{0, 'a'}, {5, 'b'}}));
+}
+
 TEST_CASE(lzma, LZMA Compression) {
     auto compressed = LZMA::compress(input);
     auto decompressed = LZMA::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lzma_binary_tree, LZMA Binary Tree) {
+    std::string block;
+    for (int i = 0; i < 4096; ++i) {
+        block += (char)(1 + ((i * 7919) >> 3) % 255);
+    }
+    std::string repeated = block + input + block + input + block;
+    auto compressed = LZMA::compress(repeated, 1 << 20);
+    auto decompressed = LZMA::decompress(compressed);
+    ASSERT_EQ(repeated, decompressed);
+    ASSERT_EQ((compressed.size() < repeated.size() / 2), true);
+
+    LZMA::BinaryTree tree(1 << 16);
+    std::vector<LZMA::Match> matches;
+    for (size_t pos = 0; pos < block.size() + 64; ++pos) {
+        tree.getMatches(repeated, pos, matches);
+        for (size_t i = 1; i < matches.size(); ++i) {
+            ASSERT_EQ((matches[i - 1].length < matches[i].length), true);
+        }
+    }
+}
+
 TEST_CASE(huffman, Huffman Compression) {
     auto [compressed, freqmap, bitlen] = Huffman::compress(input);
     auto decompressed = Huffman::decompress(compressed, freqmap, bitlen);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(huffman_long_codes, Huffman Long Codes) {
+    std::string skewed;
+    size_t a = 1, b = 1;
+    for (char symbol = 'a'; symbol <= 'v'; ++symbol) {
+        skewed += std::string(a, symbol);
+        size_t next = a + b;
+        a = b;
+        b = next;
+    }
+    auto compressed = Huffman::compress(skewed);
+    ASSERT_EQ(skewed, Huffman::decompress(compressed));
+
+    for (size_t maxCodeLength : {6, 11, 15, 32}) {
+        auto limited = Huffman::compress(skewed, maxCodeLength);
+        for (uint8_t length : limited.codeLengths) {
+            ASSERT_EQ((length <= maxCodeLength), true);
+        }
+        ASSERT_EQ(skewed, Huffman::decompress(limited));
+    }
+
+    Huffman::FreqMap freqMap;
+    size_t bitLength = 0;
+    auto legacy = Huffman::compress(skewed, freqMap, bitLength);
+    ASSERT_EQ(skewed, Huffman::decompress(legacy, freqMap, bitLength));
+
+    std::string single(100, 'x');
+    ASSERT_EQ(single, Huffman::decompress(Huffman::compress(single)));
+    ASSERT_EQ(std::string(), Huffman::decompress(Huffman::compress(std::string())));
+}
+
 TEST_CASE(deflate, Deflate Compression) {
-    auto [compressed, freqmap, bitlen] = Deflate::compress(input);
-    auto decompressed = Deflate::decompress(compressed, freqmap, bitlen);
+    auto compressed = Deflate::compress(input);
+    auto decompressed = Deflate::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(deflate_wrappers, Deflate Wrappers And Streaming) {
+    std::string text = makeText(5000, 3);
+    for (auto wrapper : {Deflate::Wrapper::Raw, Deflate::Wrapper::Zlib, Deflate::Wrapper::Gzip}) {
+        for (int level : {0, 1, 6, 9}) {
+            auto compressed = Deflate::compress(text, wrapper, level);
+            ASSERT_EQ(text, Deflate::decompress(compressed, wrapper));
+        }
+
+        auto compressed = Deflate::compress(text, wrapper);
+        ASSERT_EQ((compressed.size() < text.size() / 4), true);
+
+        Deflate::Inflater inflater(wrapper);
+        std::string streamed;
+        for (size_t pos = 0; pos < compressed.size(); pos += 7) {
+            inflater.update(compressed.substr(pos, 7), streamed);
+        }
+        ASSERT_EQ(inflater.finished(), true);
+        ASSERT_EQ(text, streamed);
+    }
+
+    // Produced by zlib.compress(..., 9).
+    std::string zlibStream("\x78\xda\xf3\x70\xf5\xf1\xf1\x57\x08\xf7\x0f\xf2\x71\x51\x70\xf3\xf7\x57\x70\x72"
+                           "\x0c\x52\x30\x34\x36\x36\x57\xf0\x40\x48\x00\x00\xac\x14\x09\x40", 36);
+    ASSERT_EQ(Deflate::decompress(zlibStream, Deflate::Wrapper::Zlib), std::string("HELLO WORLD FOO BAR 1337 HELLO WORLD"));
+
+    ASSERT_EQ(Deflate::Methods::Crc32("123456789", 9), 0xCBF43926u);
+    ASSERT_EQ(Deflate::Methods::Adler32("Wikipedia", 9), 0x11E60398u);
+}
+
+TEST_CASE(deflate_dictionary, Deflate Preset Dictionary) {
+    std::string dictionary;
+    for (int i = 0; i < 400; ++i) {
+        dictionary += input + " #" + std::to_string(i) + "\n";
+    }
+    std::string text = dictionary.substr(5000, 6000) + "tail";
+    Params params = Deflate::preset(DEFAULT_LEVEL);
+
+    auto primed = Deflate::compress(text, params, dictionary);
+    ASSERT_EQ(text, Deflate::decompress(primed, dictionary));
+    ASSERT_EQ((primed.size() * 4 < Deflate::compress(text, params).size()), true);
+    ASSERT_EQ(Deflate::compress(text, params), Deflate::compress(text, params, std::string_view()));
+
+    Deflate::Inflater inflater;
+    std::string output;
+    inflater.update(primed.substr(0, 4), output);
+    ASSERT_THROWS(inflater.setDictionary(dictionary));
+}
+
 TEST_CASE(lz4, LZ4 Compression) {
     auto compressed = LZ4::compress(input);
     auto decompressed = LZ4::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lz4_binary, LZ4 Binary Data) {
+    std::string binary;
+    for (int i = 0; i < 70000; ++i) {
+        binary += (char)(i % 251);
+        if (i % 1000 == 0) {
+            binary += std::string(300, (char)(i % 7));
+        }
+    }
+    auto compressed = LZ4::compress(binary);
+    auto decompressed = LZ4::decompress(compressed);
+    ASSERT_EQ(binary, decompressed);
+    ASSERT_EQ((compressed.size() < binary.size() / 4), true);
+
+    for (size_t size = 0; size < 40; ++size) {
+        std::string small(size, '\0');
+        ASSERT_EQ(small, LZ4::decompress(LZ4::compress(small)));
+    }
+}
+
+TEST_CASE(lz4_hc, LZ4 HC Compression) {
+    std::string text = makeText(3000, 0);
+    auto fast = LZ4::compress(text);
+    for (int level : {3, 6, 9, 12}) {
+        auto compressed = LZ4::compressHC(text, level);
+        ASSERT_EQ(text, LZ4::decompress(compressed));
+        ASSERT_EQ((compressed.size() <= fast.size()), true);
+    }
+}
+
 TEST_CASE(lz5, LZ5 Compression) {
     auto compressed = LZ5::compress(input);
     auto decompressed = LZ5::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lz5_lazy, LZ5 Lazy Parsing) {
+    // At the final "abcd..." greedy settles for the 4-byte match; one byte later a 20-byte match waits.
+    std::string text = "abcdX" "bcdefghijklmnopqrstu" "Q" "abcdefghijklmnopqrstu!";
+    auto longest = [](const std::vector<LZ5::Token>& tokens) {
+        size_t length = 0;
+        for (const auto& token : tokens) {
+            length = std::max(length, token.length);
+        }
+        return length;
+    };
+    ASSERT_EQ((longest(LZ5::compress(text, 1024, LZ5::Strategy::Greedy)) < 19), true);
+    ASSERT_EQ((longest(LZ5::compress(text, 1024, LZ5::Strategy::Lazy)) >= 19), true);
+
+    std::string log;
+    for (int i = 0; i < 5000; ++i) {
+        log += "GET /item/" + std::to_string(i * 37 % 501) + (i % 3 ? " 200 " : " 404 ") + std::to_string(i % 97) + "ms\n";
+    }
+    size_t greedySize = 0;
+    for (auto strategy : {LZ5::Strategy::Greedy, LZ5::Strategy::Lazy, LZ5::Strategy::Lazy2}) {
+        for (size_t maxOffset : {64, 32 * 1024}) {
+            ASSERT_EQ(text, LZ5::decompress(LZ5::compress(text, maxOffset, strategy)));
+            ASSERT_EQ(input, LZ5::decompress(LZ5::compress(input, maxOffset, strategy)));
+
+            auto tokens = LZ5::compress(log, maxOffset, strategy);
+            ASSERT_EQ(log, LZ5::decompress(tokens));
+            for (const auto& token : tokens) {
+                ASSERT_EQ((token.offset <= maxOffset), true);
+            }
+        }
+        size_t size = LZ5::Utils::encodeTokens(LZ5::compress(log, 32 * 1024, strategy)).size();
+        if (strategy == LZ5::Strategy::Greedy) {
+            greedySize = size;
+        }
+        ASSERT_EQ((size <= greedySize), true);
+    }
+}
+
 TEST_CASE(lzw, LZW Compression) {
     auto compressed = LZW::compress(input);
     auto decompressed = LZW::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lzw_dictionary, LZW Bounded Dictionary) {
+    std::string text = makeText(7000);
+
+    for (uint32_t width : {9, 12, 16}) {
+        for (auto policy : {LZW::FullPolicy::Freeze, LZW::FullPolicy::Reset}) {
+            auto codes = LZW::compress(text, width, policy);
+            ASSERT_EQ(text, LZW::decompress(codes, width, policy));
+            ASSERT_EQ((*std::max_element(codes.begin(), codes.end()) < (1 << width)), true);
+        }
+    }
+    ASSERT_EQ((LZW::compress(text, 16).size() < LZW::compress(text, 9).size()), true);
+    ASSERT_EQ(LZW::compress(text), LZW::compressOptimized(text));
+
+    std::string run(100000, 'a');
+    ASSERT_EQ(run, LZW::decompress(LZW::compress(run, 9), 9));
+    ASSERT_EQ(std::string(), LZW::decompress(LZW::compress("")));
+
+    ASSERT_THROWS(LZW::decompress({65, 300}));
+}
+
+TEST_CASE(lzw_packed, LZW Packed Codes) {
+    std::string text = makeText(7000);
+
+    for (uint32_t width : {9, 12, 16}) {
+        auto packed = LZW::compressPacked(text, width);
+        ASSERT_EQ(text, LZW::decompressPacked(packed));
+        ASSERT_EQ((packed.size() < text.size() * 3 / 4), true);
+    }
+    auto packed = LZW::compressPacked(text);
+    ASSERT_EQ((packed.size() < text.size() / 2), true);
+
+    for (size_t size = 0; size < 600; size += 37) {
+        std::string small = text.substr(0, size);
+        ASSERT_EQ(small, LZW::decompressPacked(LZW::compressPacked(small, 9)));
+    }
+    std::string run(200000, 'a');
+    ASSERT_EQ(run, LZW::decompressPacked(LZW::compressPacked(run, 9)));
+
+    ASSERT_THROWS(LZW::decompressPacked(packed.substr(0, packed.size() - 1)));
+}
+
 TEST_CASE(lzo, LZO Compression) {
     auto compressed = LZO::compress(input);
     auto decompressed = LZO::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lzo1x, LZO1X Block Format) {
+    ASSERT_EQ(LZO::compress1X(""), std::string("\x11\0\0", 3));
+    ASSERT_EQ(LZO::compress1X("abc"), std::string("\x14" "abc" "\x11\0\0", 7));
+
+    // Leading literals, a short match after them, a literal run, and a long near match.
+    std::string handmade("\x13" "ab" "\x04\x00" "\x01" "cdef" "\x20\x01\x01\x00" "g" "\x11\0\0", 18);
+    ASSERT_EQ(LZO::decompress1X(handmade), "ababcdef" + std::string(34, 'f') + "g");
+
+    std::string noise = makeNoise(40000, 12345);
+    // A 16400-byte literal run, a 3-byte match 2053 back (only legal after literals), then a far match.
+    std::string literals = noise.substr(0, 16400);
+    std::string far = std::string(65, '\0') + "\x3e" + literals + std::string("\x00\x01" "\x17\x40\x00" "\x11\0\0", 8);
+    std::string expected = literals + literals.substr(16400 - 2053, 3);
+    expected += expected.substr(3, 9);
+    ASSERT_EQ(LZO::decompress1X(far), expected);
+
+    std::string records;
+    for (int i = 0; i < 4000; ++i) {
+        records += "id=" + std::to_string(i * 7919 % 10007) + std::string(";flags=\0\x01;", 10);
+    }
+    for (const std::string& data : {records, noise, noise + noise, std::string(100000, 'z'), input}) {
+        auto compressed = LZO::compress1X(data);
+        ASSERT_EQ(data, LZO::decompress1X(compressed));
+        ASSERT_EQ((compressed.size() <= LZO::compressBound(data.size())), true);
+    }
+    ASSERT_EQ((LZO::compress1X(records).size() < records.size() / 3), true);
+    ASSERT_EQ((LZO::compress1X(noise).size() <= noise.size() + noise.size() / 255 + 6), true);
+
+    auto compressed = LZO::compress1X(records);
+    std::string small(100, '\0');
+    Result result = LZO::decompress({(const uint8_t*)compressed.data(), compressed.size()}, {(uint8_t*)&small[0], small.size()});
+    ASSERT_EQ((result.error == Error::OutputTooSmall), true);
+
+    for (const std::string& bad : {compressed.substr(0, compressed.size() - 1), std::string("\x40\x00\x11\0\0", 5), std::string("\x14" "abc", 4)}) {
+        ASSERT_THROWS(LZO::decompress1X(bad));
+    }
+}
+
 TEST_CASE(lzss, LZSS Compression) {
     auto compressed = LZSS::compress(input);
     auto decompressed = LZSS::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(lzss_packed, LZSS Packed Format) {
+    std::string frame;
+    for (int i = 0; i < 3000; ++i) {
+        frame += "t=" + std::to_string(1000 + i) + ";temp=" + std::to_string(20 + i % 7) + std::string(";\0\x01", 3);
+    }
+
+    auto packed = LZSS::compressPacked(frame);
+    ASSERT_EQ(frame, LZSS::decompressPacked(packed));
+    ASSERT_EQ((packed.size() < frame.size() / 3), true);
+
+    for (auto [windowSize, lookaheadSize] : {std::pair<size_t, size_t>{256, 18}, {4096, 3}, {65536, 258}, {1, 34}}) {
+        auto tokens = LZSS::compress(frame, windowSize, lookaheadSize);
+        ASSERT_EQ(frame, LZSS::decompress(tokens));
+        for (const auto& token : tokens) {
+            ASSERT_EQ((token.isLiteral || (token.offset <= windowSize && token.length <= lookaheadSize)), true);
+        }
+        ASSERT_EQ(frame, LZSS::decompressPacked(LZSS::compressPacked(frame, windowSize, lookaheadSize)));
+    }
+
+    for (size_t size = 0; size < 40; ++size) {
+        std::string small(size, '\0');
+        ASSERT_EQ(small, LZSS::decompressPacked(LZSS::compressPacked(small)));
+    }
+
+    ASSERT_THROWS(LZSS::decompressPacked(std::string("\x0c\x04\x01\x00\x05", 5)));
+}
+
 TEST_CASE(fse, FSE Compression) {
-    auto [compressed, encodingTable, bitLength] = FSE::compress(input);
-    auto decompressed = FSE::decompress(compressed, encodingTable, bitLength);
+    auto [compressed, table, bitLength] = FSE::compress(input);
+    auto decompressed = FSE::decompress(compressed, table, bitLength);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(fse_states, FSE Interleaved States) {
+    std::string skewed;
+    for (int i = 0; i < 20000; ++i) {
+        skewed += (char)("aaaaaaabbbccd\xff"[(i * 7 + i / 13) % 14]);
+    }
+    for (uint32_t stateCount : {1, 2, 4}) {
+        for (uint32_t tableLog : {5, 11, 15}) {
+            auto compressed = FSE::compress(skewed, tableLog, stateCount);
+            ASSERT_EQ(skewed, FSE::decompress(compressed));
+            ASSERT_EQ((compressed.byteVec.size() < skewed.size() / 3), true);
+        }
+        for (size_t size = 0; size < 8; ++size) {
+            std::string small = skewed.substr(0, size);
+            ASSERT_EQ(small, FSE::decompress(FSE::compress(small, 11, stateCount)));
+        }
+    }
+    std::string single(1000, 'z');
+    ASSERT_EQ(single, FSE::decompress(FSE::compress(single)));
+}
+
 TEST_CASE(zstd, Zstandard Compression) {
-    auto [compressed, encodingTable, bitLength] = Zstandard::compress(input);
-    auto decompressed = Zstandard::decompress(compressed, encodingTable, bitLength);
+    auto compressed = Zstandard::compress(input);
+    auto decompressed = Zstandard::decompress(compressed);
     ASSERT_EQ(input, decompressed);
 }
 
+TEST_CASE(zstd_sequences, Zstandard Sequences) {
+    std::string text = makeText(12000, 3);
+    auto compressed = Zstandard::compress(text);
+    ASSERT_EQ(text, Zstandard::decompress(compressed));
+    ASSERT_EQ((compressed.size() < LZ4::compress(text).size()), true);
+
+    for (size_t size = 0; size < 40; ++size) {
+        std::string small = text.substr(0, size);
+        ASSERT_EQ(small, Zstandard::decompress(Zstandard::compress(small)));
+    }
+    std::string run(300000, 'r');
+    ASSERT_EQ(run, Zstandard::decompress(Zstandard::compress(run)));
+}
+
+TEST_CASE(span_api, Span API) {
+    std::string data;
+    std::string jitter = makeNoise(300, 1);
+    for (char byte : jitter) {
+        data += input + std::string("\0\0\x01\xff", 4) + byte;
+    }
+
+    for (const auto& codec : Codecs::all()) {
+        Params params = codec.preset(DEFAULT_LEVEL);
+        for (size_t size : {size_t(0), size_t(1), size_t(7), data.size()}) {
+            ByteSpan source{(const uint8_t*)data.data(), size};
+            std::vector<uint8_t> compressed(codec.compressBound(size));
+            Result packed = codec.compress(source, {compressed.data(), compressed.size()}, params);
+            ASSERT_EQ(packed.ok(), true);
+
+            std::vector<uint8_t> restored(size + 1);
+            Result unpacked = codec.decompress({compressed.data(), packed.size}, {restored.data(), size});
+            ASSERT_EQ(unpacked.ok(), true);
+            ASSERT_EQ(data.substr(0, size), std::string((const char*)restored.data(), unpacked.size));
+
+            std::vector<uint8_t> exact(packed.size);
+            Result snug = codec.compress(source, {exact.data(), exact.size()}, params);
+            ASSERT_EQ((snug.ok() && snug.size == packed.size), true);
+            ASSERT_EQ((std::equal(exact.begin(), exact.end(), compressed.begin())), true);
+            ASSERT_EQ((codec.compress(source, {exact.data(), packed.size - 1}, params).error == Error::OutputTooSmall), true);
+
+            if (size > 0) {
+                Result cramped = codec.decompress({compressed.data(), packed.size}, {restored.data(), size - 1});
+                ASSERT_EQ((cramped.error == Error::OutputTooSmall), true);
+                ASSERT_EQ((cramped.size == 0 || cramped.size == size), true);
+                uint8_t byte;
+                ASSERT_EQ((codec.compress(source, {&byte, 0}, params).error == Error::OutputTooSmall), true);
+            }
+        }
+
+        std::vector<uint8_t> compressed(codec.compressBound(data.size()));
+        Result packed = codec.compress({(const uint8_t*)data.data(), data.size()}, {compressed.data(), compressed.size()}, params);
+        std::vector<uint8_t> restored(data.size());
+        Result truncated = codec.decompress({compressed.data(), packed.size / 2}, {restored.data(), restored.size()});
+        ASSERT_EQ((!truncated.ok() || truncated.size != data.size()), true);
+    }
+
+    std::string noise = makeNoise(70000, 2);
+    for (auto id : {Codecs::Id::LZ4, Codecs::Id::Zstandard}) {
+        Codecs::Codec codec = Codecs::find(id);
+        std::vector<uint8_t> compressed(codec.compressBound(noise.size()));
+        ASSERT_EQ(codec.compress({(const uint8_t*)noise.data(), noise.size()}, {compressed.data(), compressed.size()}, codec.preset(DEFAULT_LEVEL)).ok(), true);
+    }
+}
+
+TEST_CASE(params_presets, Shared Parameter Presets) {
+    std::string text = makeText(3000, 3);
+
+    auto roundTrip = [&](const Codecs::Codec& codec, const Params& params) {
+        std::vector<uint8_t> compressed(codec.compressBound(text.size()));
+        Result packed = codec.compress({(const uint8_t*)text.data(), text.size()}, {compressed.data(), compressed.size()}, params);
+        ASSERT_EQ(packed.ok(), true);
+        std::vector<uint8_t> restored(text.size());
+        Result unpacked = codec.decompress({compressed.data(), packed.size}, {restored.data(), restored.size()});
+        ASSERT_EQ(unpacked.ok(), true);
+        ASSERT_EQ(text, std::string((const char*)restored.data(), unpacked.size));
+        return packed.size;
+    };
+
+    for (const auto& codec : Codecs::all()) {
+        ASSERT_EQ(codec.preset(-5).level, MIN_LEVEL);
+        ASSERT_EQ(codec.preset(100).level, MAX_LEVEL);
+
+        size_t fastest = roundTrip(codec, codec.preset(MIN_LEVEL));
+        size_t standard = roundTrip(codec, codec.preset(DEFAULT_LEVEL));
+        size_t smallest = roundTrip(codec, codec.preset(MAX_LEVEL));
+        // Presets are tuned on larger inputs, so allow a little noise on this sample.
+        ASSERT_EQ((smallest <= standard + standard / 50 && standard <= fastest + fastest / 50), true);
+    }
+
+    // Individual fields override the level they came from.
+    Params narrow = LZ77::preset(DEFAULT_LEVEL);
+    narrow.windowLog = 8;
+    Codecs::Codec lz77 = Codecs::find(Codecs::Id::LZ77);
+    ASSERT_EQ((roundTrip(lz77, narrow) > roundTrip(lz77, LZ77::preset(DEFAULT_LEVEL))), true);
+
+    Params stored = Deflate::preset(DEFAULT_LEVEL);
+    stored.searchDepth = 0;
+    ASSERT_EQ((roundTrip(Codecs::find(Codecs::Id::Deflate), stored) > text.size()), true);
+    ASSERT_EQ(Deflate::compress(text, Deflate::preset(3)), Deflate::compress(text, Deflate::Wrapper::Raw, 3));
+
+    Params lazy = Zstandard::preset(DEFAULT_LEVEL);
+    lazy.strategy = Strategy::Greedy;
+    ASSERT_EQ((Zstandard::compress(text, Zstandard::preset(DEFAULT_LEVEL)).size() <= Zstandard::compress(text, lazy).size()), true);
+}
+
+TEST_CASE(codec_registry, Codec Registry And Selection) {
+    std::string text = makeText(3000, 0);
+    ByteSpan source{(const uint8_t*)text.data(), text.size()};
+
+    auto codecs = Codecs::all();
+    ASSERT_EQ(codecs.size(), (size_t)12);
+    for (const auto& codec : codecs) {
+        ASSERT_EQ((Codecs::find(codec.id).compress == codec.compress), true);
+        ASSERT_EQ(Codecs::find(codec.name).id, codec.id);
+
+        std::vector<uint8_t> compressed(codec.compressBound(text.size()));
+        Result packed = codec.compress(source, {compressed.data(), compressed.size()}, codec.preset(DEFAULT_LEVEL));
+        std::vector<uint8_t> restored(text.size());
+        Result unpacked = codec.decompress({compressed.data(), packed.size}, {restored.data(), restored.size()});
+        ASSERT_EQ(text, std::string((const char*)restored.data(), unpacked.size));
+    }
+    ASSERT_EQ(std::string(Codecs::find(Codecs::Id::Zstandard).name), std::string("zstd"));
+
+    auto renamed = [](Codecs::Id id, const char* name) {
+        Codecs::Codec codec = Codecs::find(Codecs::Id::LZ4);
+        codec.id = id;
+        codec.name = name;
+        Codecs::add(codec);
+    };
+    ASSERT_THROWS(Codecs::find("brotli"));
+    ASSERT_THROWS(Codecs::find((Codecs::Id)200));
+    ASSERT_THROWS(renamed((Codecs::Id)13, "next"));
+    ASSERT_THROWS(renamed((Codecs::Id)201, "lz4"));
+    ASSERT_THROWS(Codecs::remove(Codecs::Id::LZ4));
+    ASSERT_THROWS(Codecs::remove((Codecs::Id)200));
+
+    // A codec that never round-trips is registered but never selected.
+    Codecs::Codec broken = Codecs::find(Codecs::Id::LZ4);
+    broken.id = (Codecs::Id)200;
+    broken.name = "broken";
+    broken.decompress = [](ByteSpan, MutableByteSpan) { return Result{0, Error::InvalidInput}; };
+    Codecs::add(broken);
+    ASSERT_EQ(Codecs::find("broken").id, (Codecs::Id)200);
+
+    std::vector<Codecs::Candidate> candidates = {
+        {(Codecs::Id)200, broken.preset(MAX_LEVEL)},
+        {Codecs::Id::LZ4, LZ4::preset(MIN_LEVEL)},
+        {Codecs::Id::Huffman, Huffman::preset(DEFAULT_LEVEL)},
+        {Codecs::Id::Deflate, Deflate::preset(MAX_LEVEL)},
+    };
+
+    Codecs::Target target;
+    Codecs::Selection smallest = Codecs::autoSelect(source, target, candidates, 16 * 1024);
+    ASSERT_EQ(smallest.codec, Codecs::Id::Deflate);
+    ASSERT_EQ(smallest.params.level, MAX_LEVEL);
+    ASSERT_EQ(smallest.meetsTarget, true);
+    ASSERT_EQ((smallest.ratio > 2 && smallest.compressSpeed > 0 && smallest.decompressSpeed > 0), true);
+
+    target.objective = Codecs::Objective::Speed;
+    target.minRatio = 1.5;
+    Codecs::Selection fast = Codecs::autoSelect(source, target, candidates, 16 * 1024);
+    ASSERT_EQ(fast.meetsTarget, true);
+    ASSERT_EQ((fast.ratio >= 1.5), true);
+
+    // Out of reach: the closest candidate comes back, flagged.
+    target.minRatio = 1000;
+    Codecs::Selection closest = Codecs::autoSelect(source, target, candidates, 16 * 1024);
+    ASSERT_EQ(closest.meetsTarget, false);
+    ASSERT_EQ(closest.codec, Codecs::Id::Deflate);
+
+    // The registry is process-wide; leave it as the other tests expect it.
+    Codecs::remove((Codecs::Id)200);
+    ASSERT_EQ(Codecs::all().size(), codecs.size());
+
+    Codecs::Selection tiny = Codecs::autoSelect({source.data, 5}, Codecs::Target(), Codecs::defaultCandidates());
+    ASSERT_EQ(tiny.meetsTarget, true);
+
+    ASSERT_THROWS(Codecs::autoSelect(source, target, {}));
+}
+
+TEST_CASE(parallel_blocks, Parallel Block Compression) {
+    std::string text = makeText(6000);
+
+    for (auto id : {Codecs::Id::LZ4, Codecs::Id::Zstandard, Codecs::Id::Deflate, Codecs::Id::Huffman}) {
+        Parallel::Options options = Parallel::defaults(id, MIN_LEVEL);
+        options.blockSize = 16 * 1024;
+        options.threads = 1;
+        std::string serial = Parallel::compress(text, options);
+        ASSERT_EQ(text, Parallel::decompress(serial, 1));
+
+        // Block boundaries, not scheduling, decide the output.
+        options.threads = 4;
+        ASSERT_EQ(serial, Parallel::compress(text, options));
+        ASSERT_EQ(text, Parallel::decompress(serial, 4));
+        ASSERT_EQ((serial.size() < text.size() * 2 / 3), true);
+    }
+
+    ASSERT_EQ(std::string(), Parallel::decompress(Parallel::compress("")));
+    std::string odd = text.substr(0, 12345);
+    Parallel::Options tiny = Parallel::defaults(Codecs::Id::LZ5);
+    tiny.blockSize = 1000;
+    ASSERT_EQ(odd, Parallel::decompress(Parallel::compress(odd, tiny), 3));
+
+    // Incompressible blocks are stored rather than expanded.
+    std::string noise = makeNoise(50000, 7);
+    std::string framed = Parallel::compress(noise, tiny);
+    ASSERT_EQ((framed.size() <= noise.size() + 2 * 50 + 16), true);
+    ASSERT_EQ(noise, Parallel::decompress(framed));
+
+    Parallel::Options linked = Parallel::defaults(Codecs::Id::Deflate);
+    linked.blockSize = 8 * 1024;
+    std::string independent = Parallel::compress(text, linked);
+    linked.dictionarySize = 32 * 1024;
+    linked.threads = 4;
+    std::string chained = Parallel::compress(text, linked);
+    ASSERT_EQ(text, Parallel::decompress(chained, 4));
+    ASSERT_EQ((chained.size() < independent.size()), true);
+
+    std::string packed = Parallel::compress(text, Parallel::defaults(Codecs::Id::LZ4));
+    ASSERT_THROWS(Parallel::decompress(packed.substr(0, packed.size() - 1)));
+    ASSERT_THROWS(Parallel::decompress(packed + "x"));
+    linked.codec = Codecs::Id::LZ4;
+    ASSERT_THROWS(Parallel::compress(text, linked));
+
+    // Headers claiming 4 GiB and 1 GiB of content for a single 1-byte LZ4 block are turned down
+    // before anything that size is allocated.
+    std::string lz4Id(1, (char)Codecs::Id::LZ4);
+    ASSERT_THROWS(Parallel::decompress(lz4Id + std::string("\x80\x80\x80\x80\x10\x00\x80\x80\x80\x80\x10\x02\x00", 13)));
+    ASSERT_THROWS(Parallel::decompress(lz4Id + std::string("\x80\x80\x80\x80\x04\x00\x80\x80\x80\x80\x04\x02\x00", 13)));
+
+    // A damaged block fails inside a worker; the error must still reach the caller. The last
+    // block's LZ4 stream is overwritten with 0xff tokens, whose literal run never ends.
+    Parallel::Options split = Parallel::defaults(Codecs::Id::LZ4, MIN_LEVEL);
+    split.blockSize = 16 * 1024;
+    std::string corrupt = Parallel::compress(text, split);
+    std::string lastBlock = text.substr((text.size() - 1) / split.blockSize * split.blockSize);
+    std::vector<uint8_t> lastPacked(LZ4::compressBound(lastBlock.size()));
+    size_t lastSize = LZ4::compress({(const uint8_t*)lastBlock.data(), lastBlock.size()}, {lastPacked.data(), lastPacked.size()}, split.params).size;
+    std::fill(corrupt.end() - lastSize, corrupt.end(), '\xff');
+    ASSERT_THROWS(Parallel::decompress(corrupt, 4));
+}
+
+TEST_CASE(seekable_frames, Seekable Frames) {
+    std::string text = makeText(8000);
+
+    Seekable::Options options = Seekable::defaults(Codecs::Id::LZ4, MIN_LEVEL);
+    options.frameSize = 4096;
+    std::string packed = Seekable::compress(text, options);
+    ASSERT_EQ(Seekable::contentSize(packed), (uint64_t)text.size());
+    ASSERT_EQ(text, Seekable::decompress(packed));
+    ASSERT_EQ(text, Seekable::decompress(packed, 1));
+
+    uint32_t seed = 3;
+    for (int i = 0; i < 200; ++i) {
+        seed = seed * 1103515245 + 12345;
+        size_t offset = (seed >> 8) % (text.size() + 1);
+        size_t length = (seed >> 4) % 20000;
+        ASSERT_EQ(text.substr(offset, length), Seekable::decompressRange(packed, offset, length, i % 4));
+    }
+    for (size_t offset : {size_t(0), size_t(4095), size_t(4096), text.size() - 1, text.size()}) {
+        ASSERT_EQ(text.substr(offset, 4097), Seekable::decompressRange(packed, offset, 4097));
+    }
+
+    // Only the frames a range overlaps are read: damage elsewhere goes unnoticed.
+    std::string damaged = packed;
+    for (size_t i = 0; i < 4096; ++i) {
+        damaged[i] = '\xff';
+    }
+    ASSERT_EQ(text.substr(100000, 5000), Seekable::decompressRange(damaged, 100000, 5000));
+
+    std::string noise = makeNoise(10000, seed);
+    Seekable::Options zstd = Seekable::defaults(Codecs::Id::Zstandard);
+    std::string mixed = Seekable::compress(noise + text, zstd);
+    ASSERT_EQ(noise + text, Seekable::decompress(mixed, 4));
+    ASSERT_EQ(text.substr(0, 100), Seekable::decompressRange(mixed, noise.size(), 100));
+    ASSERT_EQ(Seekable::contentSize(Seekable::compress("")), (uint64_t)0);
+    ASSERT_EQ(std::string(), Seekable::decompress(Seekable::compress("")));
+
+    ASSERT_THROWS(Seekable::decompressRange(packed, text.size() + 1, 1));
+    ASSERT_THROWS(Seekable::decompress(packed.substr(1)));
+    ASSERT_THROWS(Seekable::decompress(packed.substr(0, packed.size() - 1)));
+    ASSERT_THROWS(Seekable::contentSize("abc"));
+    ASSERT_THROWS(Seekable::decompress(damaged));
+
+    // One 5-byte frame whose index entry claims 4 GiB, then 1 GiB, of content.
+    for (const char* claim : {"\x00\x00\x00\x00\x01", "\x00\x00\x00\x40\x00"}) {
+        std::string bomb = std::string(5, '\0') + std::string("\x05\0\0\0\0\0\0\0", 8) + std::string(claim, 5) +
+                           std::string(3, '\0') + std::string("\x01\0\0\0\0\0\0\0", 8) + (char)Codecs::Id::LZ4 + "CPSK";
+        ASSERT_EQ(bomb.size(), (size_t)34);
+        ASSERT_THROWS(Seekable::decompress(bomb));
+    }
+}
+
 RUN_ALL_TESTS();
\ No newline at end of file